@@ -0,0 +1,13 @@
+#!/bin/sh
+# Builds the standalone entity_manager benchmark for Linux, see ecs/entity_components_benchmark_main.cpp
+#   ./build_ecs_benchmark.sh && cd build && ./ecs_benchmark 1000000 ecs_benchmark.json
+
+OutputFileName=ecs_benchmark
+SrcMainFile=../ecs/entity_components_benchmark_main.cpp
+
+IncludeDirectories="-I../jwin -I.."
+CommonCompilerFlags="$IncludeDirectories -std=c++17 -O2 -g -mpopcnt -DNDEBUG"
+
+mkdir -p build
+cd build
+g++ $CommonCompilerFlags $SrcMainFile -o $OutputFileName -lpthread
@@ -0,0 +1,187 @@
+#pragma once
+#include "commons/types.h"
+#include <emmintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+namespace ecs{
+
+#define ECS_MAX_COMPONENT_TYPES 128
+
+// The set of component types an entity, archetype or query refers to. Bit N is component type N.
+// Flags of the first 32 types convert implicitly from bitmask32 so enums like flag::POSITION | flag::RENDER
+// can be passed as they are. Types 32 and up are made with ComponentFlagFromIndex.
+//
+// Words are loaded unaligned into SSE registers so a signature can live anywhere, for example in the
+// archetypes of the entity_manager's Archetypes chunk_list, in queries or in a snapshot read from a file.
+struct component_signature
+{
+  u64 Words[ECS_MAX_COMPONENT_TYPES / 64];
+
+  component_signature() = default;
+  component_signature(bitmask32 Flags)
+  {
+    Words[0] = Flags;
+    Words[1] = 0;
+  }
+};
+
+internal inline __m128i
+LoadSignature(const component_signature& Signature)
+{
+  return _mm_loadu_si128((const __m128i*) Signature.Words);
+}
+
+internal inline component_signature
+StoreSignature(__m128i Wide)
+{
+  component_signature Result;
+  _mm_storeu_si128((__m128i*) Result.Words, Wide);
+  return Result;
+}
+
+internal inline component_signature
+operator|(const component_signature& A, const component_signature& B)
+{
+  return StoreSignature(_mm_or_si128(LoadSignature(A), LoadSignature(B)));
+}
+
+internal inline component_signature
+operator&(const component_signature& A, const component_signature& B)
+{
+  return StoreSignature(_mm_and_si128(LoadSignature(A), LoadSignature(B)));
+}
+
+internal inline component_signature
+operator~(const component_signature& A)
+{
+  return StoreSignature(_mm_xor_si128(LoadSignature(A), _mm_set1_epi32(-1)));
+}
+
+// A & ~B
+internal inline component_signature
+AndNot(const component_signature& A, const component_signature& B)
+{
+  return StoreSignature(_mm_andnot_si128(LoadSignature(B), LoadSignature(A)));
+}
+
+internal inline b32
+IsEmpty(const component_signature& A)
+{
+  __m128i Wide = LoadSignature(A);
+  b32 Result = _mm_movemask_epi8(_mm_cmpeq_epi8(Wide, _mm_setzero_si128())) == 0xFFFF;
+  return Result;
+}
+
+internal inline b32
+operator==(const component_signature& A, const component_signature& B)
+{
+  b32 Result = _mm_movemask_epi8(_mm_cmpeq_epi8(LoadSignature(A), LoadSignature(B))) == 0xFFFF;
+  return Result;
+}
+
+internal inline b32
+operator!=(const component_signature& A, const component_signature& B)
+{
+  return !(A == B);
+}
+
+// True if Signature holds every component in Required: (Signature & Required) == Required
+internal inline b32
+HasAll(const component_signature& Signature, const component_signature& Required)
+{
+  __m128i Missing = _mm_andnot_si128(LoadSignature(Signature), LoadSignature(Required));
+  b32 Result = _mm_movemask_epi8(_mm_cmpeq_epi8(Missing, _mm_setzero_si128())) == 0xFFFF;
+  return Result;
+}
+
+internal inline b32
+HasAny(const component_signature& Signature, const component_signature& Flags)
+{
+  b32 Result = !IsEmpty(Signature & Flags);
+  return Result;
+}
+
+internal inline u32
+PopCount64(u64 Value)
+{
+#if defined(_MSC_VER)
+  u32 Result = (u32) __popcnt64(Value);
+#else
+  u32 Result = (u32) __builtin_popcountll(Value);
+#endif
+  return Result;
+}
+
+internal inline u32
+GetSetBitCount(const component_signature& Signature)
+{
+  u32 Result = PopCount64(Signature.Words[0]) + PopCount64(Signature.Words[1]);
+  return Result;
+}
+
+// Number of set bits in Signature below bit Index
+internal inline u32
+GetSetBitCountBelow(const component_signature& Signature, u32 Index)
+{
+  Assert(Index < ECS_MAX_COMPONENT_TYPES);
+  u32 Word = Index >> 6;
+  u64 Mask = (((u64) 1) << (Index & 63)) - 1;
+  u32 Result = PopCount64(Signature.Words[Word] & Mask);
+  if(Word)
+  {
+    Result += PopCount64(Signature.Words[0]);
+  }
+  return Result;
+}
+
+internal inline b32
+IndexOfLeastSignificantSetBit(const component_signature& Signature, u32* Index)
+{
+  for(u32 Word = 0; Word < ArrayCount(Signature.Words); ++Word)
+  {
+    u64 Bits = Signature.Words[Word];
+    if(Bits)
+    {
+#if defined(_MSC_VER)
+      unsigned long BitIndex;
+      _BitScanForward64(&BitIndex, Bits);
+#else
+      u32 BitIndex = (u32) __builtin_ctzll(Bits);
+#endif
+      *Index = Word * 64 + (u32) BitIndex;
+      return true;
+    }
+  }
+  return false;
+}
+
+internal inline b32
+IsBitSet(const component_signature& Signature, u32 Index)
+{
+  Assert(Index < ECS_MAX_COMPONENT_TYPES);
+  b32 Result = (Signature.Words[Index >> 6] >> (Index & 63)) & 1;
+  return Result;
+}
+
+internal inline component_signature
+ComponentFlagFromIndex(u32 Index)
+{
+  Assert(Index < ECS_MAX_COMPONENT_TYPES);
+  component_signature Result = {};
+  Result.Words[Index >> 6] = ((u64) 1) << (Index & 63);
+  return Result;
+}
+
+// Index of the single component in ComponentFlag
+internal inline u32
+GetComponentIndex(const component_signature& ComponentFlag)
+{
+  Assert(GetSetBitCount(ComponentFlag) == 1);
+  u32 Result = 0;
+  IndexOfLeastSignificantSetBit(ComponentFlag, &Result);
+  return Result;
+}
+
+}
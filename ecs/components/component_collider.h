@@ -5,6 +5,8 @@
 namespace ecs{ 
 namespace collider {
 
+// Collider is a tag component, it has no data and takes no memory per entity.
+// Test for it with HasComponents or put flag::COLLIDER in a query.
 struct component
 {
 
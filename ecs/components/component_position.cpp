@@ -5,8 +5,8 @@ namespace ecs::position {
 void InsertPositionNode(component* PositionComponent, position_node* Parent, position_node* Child)
 {
   PositionComponent->NodeCount++;
-  Assert(Parent->PositionComponent);
-  Child->PositionComponent = PositionComponent;
+  Assert(IsValid(&Parent->Entity));
+  Child->Entity = GetEntityIDFromComponent((bptr) PositionComponent);
   if(Parent->FirstChild)
   {
     position_node* Tmp = Parent->FirstChild;
@@ -23,7 +23,7 @@ void InsertPositionNode(component* PositionComponent, position_node* Parent, pos
 
 position_node* CreatePositionNode(world_coordinate Position, r32 Rotation)
 {
-  position_node* Result = (position_node*) GetNewBlock(GlobalPersistentArena, &GlobalState->World.PositionNodes);
+  position_node* Result = (position_node*) GetNewBlock(GlobalPersistentArena, &GlobalState->PositionNodes);
   Result->RelativePosition = Position;
   Result->RelativeRotation = Rotation;
   return Result;
@@ -35,14 +35,39 @@ void InitiatePositionComponent(component* PositionComponent, world_coordinate Po
 
   PositionComponent->NodeCount = 1;
   PositionComponent->FirstChild = CreatePositionNode(Position, Rotation);
-  PositionComponent->FirstChild->PositionComponent = PositionComponent;
+  PositionComponent->FirstChild->Entity = GetEntityIDFromComponent((bptr) PositionComponent);
   PositionComponent->Dirty = true;
 }
 
+// The components are looked up in one batch and the nodes pushed one after another, the ids are known
+// so the nodes don't have to find their entity from the component
+void InitiatePositionComponents(entity_manager* EM, u32 Count, entity_id* EntityIDs, world_coordinate Position, r32 Rotation)
+{
+  temporary_memory TempMem = BeginTemporaryMemory(GlobalTransientArena);
+  bptr* Positions = PushArray(GlobalTransientArena, Count, bptr);
+  TryGetComponents(EM, Count, EntityIDs, flag::POSITION, Positions);
+  for(u32 Index = 0; Index < Count; ++Index)
+  {
+    component* PositionComponent = (component*) Positions[Index];
+    if(!PositionComponent)
+    {
+      continue;
+    }
+    Assert(!PositionComponent->FirstChild);
+    PositionComponent->NodeCount = 1;
+    PositionComponent->FirstChild = CreatePositionNode(Position, Rotation);
+    PositionComponent->FirstChild->Entity = EntityIDs[Index];
+    PositionComponent->Dirty = true;
+  }
+  EndTemporaryMemory(TempMem);
+}
+
 component* GetPositionComponentFromNode(position_node const * Node)
 {
-  Assert(Node->PositionComponent);
-  return Node->PositionComponent;
+  entity_id EntityID = Node->Entity;
+  component* Result = GetPositionComponent(&EntityID);
+  Assert(Result);
+  return Result;
 }
 
 world_coordinate GetPositionRelativeTo(position_node const * Node, world_coordinate Position)
@@ -119,7 +144,26 @@ void SetRelativePosition(position_node* Node, world_coordinate Position, r32 Rot
     Node->RelativeRotation += Tau32; 
   }
 
-  Node->PositionComponent->Dirty = true;
+  GetPositionComponentFromNode(Node)->Dirty = true;
+}
+
+// All nodes in the tree of a component belong to it, points them to the new id of the entity
+// after it moved to another entity_manager
+void SetPositionNodeEntity(component* PositionComponent, entity_id EntityID)
+{
+  temporary_memory TempMem = BeginTemporaryMemory(GlobalTransientArena);
+
+  node_queue NodeQueue = {};
+  NodeQueue.Nodes = PushArray(GlobalTransientArena, PositionComponent->NodeCount, position_node*);
+  Push(&NodeQueue, PositionComponent->FirstChild);
+  while(NodeQueue.Count > 0)
+  {
+    position_node* Node = Pop(&NodeQueue);
+    Node->Entity = EntityID;
+    Push(&NodeQueue, Node->NextSibling);
+    Push(&NodeQueue, Node->FirstChild);
+  }
+  EndTemporaryMemory(TempMem);
 }
 
 // Note untested with several siblings
@@ -127,7 +171,7 @@ void ClearPositionComponent(component* PositionComponent)
 {
   temporary_memory TempMem = BeginTemporaryMemory(GlobalTransientArena);
 
-  chunk_list* PositionNodeList = &GlobalState->World.PositionNodes;
+  chunk_list* PositionNodeList = &GlobalState->PositionNodes;
 
   node_queue NodeQueue = {};
   NodeQueue.Nodes = PushArray(GlobalTransientArena, PositionComponent->NodeCount, position_node*);
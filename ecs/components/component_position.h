@@ -1,6 +1,9 @@
 #pragma once
 
 #include "platform/coordinate_systems.h"
+#include "ecs/entity_components.h"
+#include "ecs/entity_components_backend.h"
+#include "ecs/entity_components_typed_query.h"
 
 // Wanna make a difference to how position_node vs position works.
 // Today position is the root node of a position_tree.
@@ -25,7 +28,9 @@ struct position_node
   world_coordinate AbsolutePosition;
   r32 AbsoluteRotation;
 
-  component* PositionComponent;
+  // The entity owning the position component of the tree. Components move in memory when
+  // their entity changes archetype so we can't point to the component directly.
+  entity_id Entity;
   position_node* FirstChild;
   position_node* NextSibling;
   position_node* Parent;
@@ -42,6 +47,9 @@ struct component
 
 // Creates a new position node, initializes and if parent exists, insert it into the tree
 void InitiatePositionComponent(component* PositionComponent, world_coordinate Position, r32 Rotation);
+// Gives the zeroed position components of Count entities, for example fresh prefab instances, a node each.
+// Entities without a position component are skipped.
+void InitiatePositionComponents(entity_manager* EM, u32 Count, entity_id* EntityIDs, world_coordinate Position, r32 Rotation);
 void InsertPositionNode(component* PositionComponent, position_node* Parent, position_node* Child);
 component* GetPositionComponentFromNode(position_node const * Node);
 position_node* CreatePositionNode(world_coordinate Position, r32 Rotation);
@@ -53,6 +61,9 @@ r32 GetAbsoluteRotation(position_node const * PositionComponent);
 r32 GetAbsoluteRotation(component const * PositionComponent);
 void SetRelativePosition(position_node* Node, world_coordinate Position, r32 Rotation);
 void ClearPositionComponent(component* PositionComponent);
+void SetPositionNodeEntity(component* PositionComponent, entity_id EntityID);
 
 }
-}
\ No newline at end of file
+}
+
+ECS_TYPED_COMPONENT(ecs::position::component, ecs::flag::POSITION);
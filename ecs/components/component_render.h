@@ -1,5 +1,9 @@
 #pragma once
 
+#include "ecs/entity_components.h"
+#include "ecs/entity_components_backend.h"
+#include "ecs/entity_components_typed_query.h"
+
 namespace ecs{ 
 namespace render {
 namespace data {
@@ -81,11 +85,33 @@ data::material GetMaterial(u32 MaterialIndex) {
     return Materials[MaterialIndex%data::MATERIAL_COUNT];
 }
 
+// The material is a shared component (flag::MATERIAL), entities only hold the index of the value.
+void SetMaterial(entity_manager* EM, entity_id* EntityID, u32 MaterialIndex)
+{
+  data::material Material = GetMaterial(MaterialIndex);
+  u32 ValueIndex = AddSharedComponentValue(EM, flag::MATERIAL, &Material);
+  // MATERIAL has room for every material, see CreateEntityManager. Should that change the entity keeps its material.
+  if(ValueIndex != U32Max)
+  {
+    SetSharedComponent(EM, EntityID, flag::MATERIAL, ValueIndex);
+  }
+}
+
+// Material of the entities instantiated from Prefab
+void SetMaterial(entity_manager* EM, prefab* Prefab, u32 MaterialIndex)
+{
+  data::material Material = GetMaterial(MaterialIndex);
+  u32 ValueIndex = AddSharedComponentValue(EM, flag::MATERIAL, &Material);
+  if(ValueIndex != U32Max)
+  {
+    SetPrefabSharedComponent(EM, Prefab, flag::MATERIAL, ValueIndex);
+  }
+}
+
 struct component {
   u32 MeshHandle;
   u32 TextureHandle;
   v3 Scale;
-  data::material Material;
 
 //  b32 ModifyRenderState;
 //  b32 UseZBuffer;
@@ -95,4 +121,6 @@ struct component {
 };
 
 } // namespace render
-} // namespace ecs
\ No newline at end of file
+} // namespace ecs
+
+ECS_TYPED_COMPONENT(ecs::render::component, ecs::flag::RENDER);
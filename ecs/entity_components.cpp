@@ -14,13 +14,16 @@ entity_manager* CreateEntityManager() {
   entity_manager_definition Definitions[] = 
   {
     {flag::POSITION, flag::NONE,     EntityChunkCount,  sizeof(position::component)},
-    {flag::COLLIDER, flag::POSITION, EntityChunkCount,  sizeof(collider::component)},
-    {flag::RENDER,   flag::POSITION, EntityChunkCount,  sizeof(render::component)}
+    {flag::COLLIDER, flag::POSITION, EntityChunkCount,  0}, // Tag, see collider::component
+    {flag::RENDER,   flag::POSITION | flag::MATERIAL, EntityChunkCount,  sizeof(render::component)},
+    // Shared, one value per material used. Entities with the same material are grouped in chunks.
+    // Value 0 is the zeroed material, every material can be added on top of it.
+    {flag::MATERIAL, flag::NONE,     0,                 sizeof(render::data::material), 0, 0, 0, render::data::MATERIAL_COUNT + 1}
  //   {COMPONENT_FLAG_DYNAMICS,         COMPONENT_FLAG_COLLIDER,                           EntityChunkCount,     sizeof(component_dynamics)},
  //   {COMPONENT_FLAG_RENDER,           COMPONENT_FLAG_POSITION,                           EntityChunkCount,     sizeof(component_render)}
   };
 
-  entity_manager* Result = CreateEntityManager(EntityChunkCount, EntityChunkCount, ArrayCount(Definitions), Definitions);
+  entity_manager* Result = CreateEntityManager(EntityChunkCount, ArrayCount(Definitions), Definitions);
   return Result;
 }
 
@@ -5,6 +5,8 @@
 namespace ecs {
 
 struct entity_manager;
+struct query;
+struct worker_pool;
 
 namespace component {
   struct position;
@@ -19,7 +21,8 @@ namespace flag{
     POSITION  = 1<<0,
     COLLIDER  = 1<<1,
     RENDER    = 1<<2,
-    END       = 1<<3
+    MATERIAL  = 1<<3,
+    END       = 1<<4
   };
 }
 
@@ -28,6 +31,6 @@ namespace flag{
 }
 
 
-#define GetPositionComponent(EntityID) ((ecs::position::component*) ecs::GetComponent(GlobalState->World.EntityManager, EntityID, ecs::flag::POSITION))
-#define GetHitboxComponent(EntityID) ((ecs::collider::component*) ecs::GetComponent(GlobalState->World.EntityManager, EntityID, ecs::flag::COLLIDER))
-#define GetRenderComponent(EntityID) ((ecs::render::component*) ecs::GetComponent(GlobalState->World.EntityManager, EntityID, ecs::flag::RENDER))
+#define GetPositionComponent(EntityID) ecs::GetComponent<ecs::position::component>(GlobalState->World->EntityManager, EntityID)
+#define HasCollider(EntityID) ecs::HasComponents(GlobalState->World->EntityManager, EntityID, ecs::flag::COLLIDER)
+#define GetRenderComponent(EntityID) ecs::GetComponent<ecs::render::component>(GlobalState->World->EntityManager, EntityID)
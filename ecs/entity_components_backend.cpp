@@ -1,44 +1,136 @@
 #include "entity_components_backend.h"
 #include "commons/macros.h"
+#include <string.h>
 
 
 namespace ecs{
-  
-// entity_component_link: A struct holding references between entities and components
-// Types is a bitmask where each set references a specific component
-// NOTE: Extract the variable sized bitfield in chunk_list to its own type and use here
-//       because at the moment we can only support 32 different types of components.
-struct entity_component_link
-{
-  component_head* Component;
-  entity_component_link* Next; // Next of different type
-
-  // TODO: Enable to have many of the same component type
-  //       How to associate with required components?
-//  entity_component_link* NextOfSameType;
-};
 
+// The components of an entity are the ComponentFlags of the archetype of its chunk, see GetEntityComponentFlags.
 struct entity
 {
-  entity_id ID; // ID starts at 1. Index is ID-1
-  u32 ChunkListIndex;
-  bitmask32 ComponentFlags;
-  entity_component_link* FirstComponentLink; // Points us to the associated components in the component list.
+  entity_id ID; // ID.SlotIndex is the slot this entity is stored in
+  archetype_chunk* Chunk; // The chunk holding the components of the entity. 0 if the entity has no components.
+  u32 Row;                // Index of the entity within Chunk.
+  u32 NextFreeSlot;       // Only used while the slot is in the free list
 };
 
-struct component_head
+struct component_list
 {
-  entity* Entity;
-  bitmask32 Type;
+  component_signature Type;
+  component_signature Requirements;
+  // Closures computed in CreateEntityManager, both include Type itself
+  component_signature TotalRequirements; // Everything Type requires, directly or through other components
+  component_signature RequiredBy;        // Every component type requiring Type, directly or through other components
+  u32 ComponentByteSize;
+  u32 ComponentChunkCount;
+  u32 FieldCount;      // 1 for components stored as one struct per entity
+  u32* FieldByteSizes; // [FieldCount], each field gets its own array in a chunk
+  // Components with several instances per entity store a component_instances header and
+  // InstanceCapacity instances in each row. ComponentByteSize is the size of the whole row then.
+  u32 InstanceCapacity;
+  u32 InstanceByteSize;
+  // Shared components store their values here instead of in the chunks, see archetype::SharedFlags
+  u32 SharedValueCapacity;
+  u32 SharedValueCount;
+  bptr SharedValues; // [SharedValueCapacity] of ComponentByteSize
 };
 
-struct component_list
+// Components that are neither split into fields nor hold several instances
+internal inline b32 IsStoredAsStruct(component_list* ComponentList)
+{
+  b32 Result = ComponentList->FieldCount == 1 && !ComponentList->InstanceCapacity && ComponentList->ComponentByteSize &&
+               !ComponentList->SharedValueCapacity;
+  return Result;
+}
+
+// Tag components are only a bit in the archetype signature, they have no array in the chunks
+internal inline b32 IsTag(component_list* ComponentList)
+{
+  b32 Result = ComponentList->ComponentByteSize == 0;
+  return Result;
+}
+
+// Where one array lives in an archetype_chunk. A component has one array per field.
+struct archetype_column
+{
+  u32 ByteOffset; // From the start of the chunk to the first element in the array
+  u32 ByteSize;   // Size of one element
+};
+
+// archetype: All entities holding exactly the components in ComponentFlags.
+// The component arrays of a chunk are ordered by the set bits in StoredFlags, lowest bit first.
+// StoredFlags is ComponentFlags without the tag and shared components, which take no space per entity.
+// Instead of an array each shared component has one value index per chunk, after the change versions.
+// All entities of a chunk use the same values, see GetChunkSharedValueIndices.
+// Column N holds the first field of component array N, so components stored as one struct are
+// found with a single lookup. Fields 1 and up of components with several fields follow after
+// ComponentCount columns. Columns are laid out in the chunk in column order.
+struct archetype
+{
+  component_signature ComponentFlags;
+  component_signature StoredFlags;
+  component_signature SharedFlags;
+  u32 ComponentCount; // Number of component arrays in each chunk, the set bits of StoredFlags
+  u32 SharedCount;    // Number of shared value indices in each chunk, the set bits of SharedFlags
+  u32 ColumnCount;    // Number of arrays in each chunk, one per field of each component
+  u32 ChunkCapacity;  // Number of entities each chunk can hold
+  u32 EntityCount;
+  u32 ChunkCount;
+  u32 EntitiesByteOffset; // From the start of a chunk to its entity* array, after the change versions
+  archetype_column* Columns; // [ColumnCount]
+  u32* FieldColumns;         // [ComponentCount], column of field 1 of each component array
+
+  // All chunks in the order they were allocated
+  archetype_chunk* FirstChunk;
+  archetype_chunk* LastChunk;
+  // Chunks with free rows. New entities go into the first of these.
+  archetype_chunk* FirstChunkWithSpace;
+};
+
+// The header is followed by one change version per component array, see GetChunkChangeVersions,
+// and one value index per shared component, see GetChunkSharedValueIndices
+struct archetype_chunk
+{
+  archetype* Archetype;
+  archetype_chunk* Next;
+  archetype_chunk* Previous;
+  archetype_chunk* NextWithSpace;
+  archetype_chunk* PreviousWithSpace;
+  u32 EntityCount; // Rows [0, EntityCount) are in use
+  u32 DeletedCount; // Rows marked for deletion during DeleteEntities, 0 otherwise
+};
+
+#define ECS_COMPONENT_ALIGNMENT 16
+
+// Start of each row of a component with several instances, the instances follow
+// ECS_COMPONENT_INSTANCES_HEADER_SIZE bytes after it.
+struct component_instances
 {
-  bitmask32 Type;
-  u32 Requirements;
-  chunk_list Components;
+  u32 Count;
 };
+#define ECS_COMPONENT_INSTANCES_HEADER_SIZE ECS_COMPONENT_ALIGNMENT
+
+internal inline component_signature
+GetEntityComponentFlags(entity* Entity)
+{
+  component_signature Result = Entity->Chunk ? Entity->Chunk->Archetype->ComponentFlags : component_signature{};
+  return Result;
+}
+
+internal inline midx
+GetAlignedOffset(midx Offset, midx Alignment)
+{
+  midx Result = (Offset + Alignment - 1) & ~(Alignment - 1);
+  return Result;
+}
 
+// The archetype_chunk struct, the change versions of its ComponentCount arrays and its SharedCount value indices
+internal inline midx
+GetArchetypeChunkHeaderSize(u32 ComponentCount, u32 SharedCount)
+{
+  midx Result = GetAlignedOffset(sizeof(archetype_chunk) + (ComponentCount + SharedCount) * sizeof(u32), ECS_COMPONENT_ALIGNMENT);
+  return Result;
+}
 
 internal inline b32
 IndexOfLeastSignificantSetBit( bitmask32 EntityFlags, u32* Index )
@@ -55,542 +147,2161 @@ internal inline u32 IndexOfLeastSignificantSetBit( bitmask32 EntityFlags )
   return BitScan.Index;
 }
 
-internal inline entity* GetEntityFromID(entity_manager* EM, entity_id* EntityID) 
-{ 
-  entity* Entity = (entity*)  GetBlockIfItExists(&EM->EntityList, EntityID->ChunkListIndex);
-  Assert(Entity->ID.EntityID == EntityID->EntityID);
-  return Entity;
+internal inline entity* GetEntitySlot(entity_manager* EM, u32 SlotIndex)
+{
+  Assert(SlotIndex < EM->EntitySlotCount);
+  u32 PageIndex = SlotIndex >> EM->EntitySlotPageSizeLog2;
+  u32 PageMask = (1 << EM->EntitySlotPageSizeLog2) - 1;
+  entity* Result = EM->EntitySlotPages[PageIndex] + (SlotIndex & PageMask);
+  return Result;
 }
 
-internal entity_component_link*
-AllocateNewComponents(entity_manager* EM, entity* Entity, bitmask32 NewComponentFlags)
+// Returns 0 if EntityID refers to an entity that has been deleted
+internal inline entity* TryGetEntityFromID(entity_manager* EM, entity_id* EntityID)
 {
-  u32 SetBitCount = GetSetBitCount(NewComponentFlags);
-  Assert(SetBitCount > 0); // Don't try and allocate 0 links
-  entity_component_link* LinkHead = 0;
-  entity_component_link* Tail = 0;
-  u32 ComponentIndex = 0;
-  while(IndexOfLeastSignificantSetBit(NewComponentFlags, &ComponentIndex))
+  if(EntityID->SlotIndex >= EM->EntitySlotCount)
   {
-    Assert(ComponentIndex < EM->ComponentTypeCount); // Make sure the component bit exist
-    // Allocate new components
-    component_list* ComponentList = EM->ComponentTypeVector + ComponentIndex;
-    Assert(ComponentList->Type & (1<<ComponentIndex)); // Make sure we have the right component list
+    return 0;
+  }
+  entity* Entity = GetEntitySlot(EM, EntityID->SlotIndex);
+  if(Entity->ID.Generation != EntityID->Generation)
+  {
+    return 0;
+  }
+  return Entity;
+}
 
-    component_head* ComponentHead = (component_head*) GetNewBlock(&EM->Arena, &ComponentList->Components);
-    ComponentHead->Entity = Entity;
-    ComponentHead->Type = ComponentList->Type;
+internal inline entity* GetEntityFromID(entity_manager* EM, entity_id* EntityID)
+{
+  entity* Entity = GetEntitySlot(EM, EntityID->SlotIndex);
+  Assert(Entity->ID.Generation == EntityID->Generation); // Stale handle, the entity has been deleted
+  return Entity;
+}
 
-    // Link the component to the entity.
-    if(!Tail)
+internal void AddEntitySlotPage(entity_manager* EM)
+{
+  if(EM->EntitySlotPageCount == EM->EntitySlotPageCapacity)
+  {
+    // Grow the page directory, the pages themselves stay where they are
+    u32 NewCapacity = EM->EntitySlotPageCapacity ? 2 * EM->EntitySlotPageCapacity : 16;
+    entity** NewPages = PushArray(&EM->Arena, NewCapacity, entity*);
+    if(EM->EntitySlotPageCount)
     {
-      LinkHead = (entity_component_link*) GetNewBlock(&EM->Arena, &(EM->EntityComponentLinks));
-      Tail = LinkHead;
-    }else{
-      Tail->Next = (entity_component_link*) GetNewBlock(&EM->Arena, &EM->EntityComponentLinks);
-      Tail = Tail->Next;
+      utils::Copy(EM->EntitySlotPageCount * sizeof(entity*), EM->EntitySlotPages, NewPages);
     }
-
-    Tail->Component = ComponentHead;
-
-    NewComponentFlags -= ComponentList->Type;
+    EM->EntitySlotPages = NewPages;
+    EM->EntitySlotPageCapacity = NewCapacity;
   }
-  return LinkHead;
+  EM->EntitySlotPages[EM->EntitySlotPageCount++] = PushArray(&EM->Arena, 1 << EM->EntitySlotPageSizeLog2, entity);
 }
 
-internal entity_component_link*
-MergeMaps(entity_component_link* OldComponentMapBase, entity_component_link* NewComponentMapBase)
+internal entity* AllocateEntitySlot(entity_manager* EM)
 {
-  Assert(NewComponentMapBase);
-  entity_component_link* ResultMapBase = NewComponentMapBase;
-  if(OldComponentMapBase)
+  entity* Result = 0;
+  if(EM->FirstFreeEntitySlot != U32Max)
   {
-    entity_component_link* OldComponentMap = OldComponentMapBase;
-    entity_component_link* NewComponentMap = NewComponentMapBase;
-
-    u32 OldComponentIndex = 0;
-    u32 NewComponentIndex = 0;
-    b32 FoundOld = IndexOfLeastSignificantSetBit(OldComponentMap->Component->Type, &OldComponentIndex);
-    Assert(FoundOld);
-    b32 FoundNew = IndexOfLeastSignificantSetBit(NewComponentMap->Component->Type, &NewComponentIndex);
-    
-    if(OldComponentIndex < NewComponentIndex)
-    {
-      ResultMapBase = OldComponentMap;
-      OldComponentMap = OldComponentMap->Next;
-    }else{
-      Assert(OldComponentIndex != NewComponentIndex);
-      ResultMapBase = NewComponentMap;
-      NewComponentMap = NewComponentMap->Next;
-    }
-
-    entity_component_link* ResultMap = ResultMapBase;
-    // Insert it into the Existing entity.
-    while(NewComponentMap && OldComponentMap)
-    {
-      IndexOfLeastSignificantSetBit(OldComponentMap->Component->Type, &OldComponentIndex);
-      IndexOfLeastSignificantSetBit(NewComponentMap->Component->Type, &NewComponentIndex);
-      if(OldComponentIndex < NewComponentIndex)
-      {
-        ResultMap->Next = OldComponentMap;
-        ResultMap = ResultMap->Next;
-        OldComponentMap = OldComponentMap->Next;
-      }else{
-        Assert(OldComponentIndex != NewComponentIndex);
-        ResultMap->Next = NewComponentMap;
-        ResultMap = ResultMap->Next;
-        NewComponentMap = NewComponentMap->Next;
-      }
-    }
-
-    if(NewComponentMap)
-    {
-      Assert(!OldComponentMap);
-      ResultMap->Next = NewComponentMap;
-    }else if(OldComponentMap)
+    Result = GetEntitySlot(EM, EM->FirstFreeEntitySlot);
+    EM->FirstFreeEntitySlot = Result->NextFreeSlot;
+    Result->NextFreeSlot = 0;
+  }else{
+    u32 SlotIndex = EM->EntitySlotCount;
+    u32 PageIndex = SlotIndex >> EM->EntitySlotPageSizeLog2;
+    if(PageIndex == EM->EntitySlotPageCount)
     {
-      ResultMap->Next = OldComponentMap;
+      AddEntitySlotPage(EM);
     }
+    EM->EntitySlotCount++;
+    Result = GetEntitySlot(EM, SlotIndex);
+    Result->ID.SlotIndex = SlotIndex;
+    Result->ID.Generation = 1;
   }
-  
-  return ResultMapBase;
+  EM->EntityCount++;
+  return Result;
 }
 
-internal void CreateAndInsertNewComponents(entity_manager* EM, entity* Entity, bitmask32 NewComponentFlags)
+internal void FreeEntitySlot(entity_manager* EM, entity* Entity)
 {
-  // Make sure NewComponentFlags is _not_ in the entity already
-  Assert((Entity->ComponentFlags & NewComponentFlags) == 0 );
-  // Create new list of entity_component_mapping_entry;
-  entity_component_link* NewComponentMapBase = AllocateNewComponents(EM, Entity, NewComponentFlags);
-  entity_component_link* OldComponentMapBase = Entity->FirstComponentLink;
-  entity_component_link* MergedMap = MergeMaps(OldComponentMapBase, NewComponentMapBase);
-  Entity->FirstComponentLink = MergedMap;
-  Entity->ComponentFlags = Entity->ComponentFlags | NewComponentFlags;
+  Assert(EM->EntityCount > 0);
+  // Invalidates all handles to the entity
+  Entity->ID.Generation++;
+  if(Entity->ID.Generation == 0 || Entity->ID.Generation == ECS_PENDING_ENTITY_GENERATION)
+  {
+    Entity->ID.Generation = 1;
+  }
+  Entity->Chunk = 0;
+  Entity->Row = 0;
+  Entity->NextFreeSlot = EM->FirstFreeEntitySlot;
+  EM->FirstFreeEntitySlot = Entity->ID.SlotIndex;
+  EM->EntityCount--;
 }
 
-internal bitmask32 GetTotalRequirements(entity_manager* EM, bitmask32 ComponentFlags)
+internal component_signature GetTotalRequirements(entity_manager* EM, component_signature ComponentFlags)
 {
-  bitmask32 SummedFlags = ComponentFlags;
+  component_signature SummedFlags = ComponentFlags;
   u32 ComponentIndex = 0;
   while(IndexOfLeastSignificantSetBit(ComponentFlags, &ComponentIndex))
   {
     Assert(ComponentIndex < EM->ComponentTypeCount );
     component_list* ComponentList = EM->ComponentTypeVector + ComponentIndex;
-    // Sum all required components
-    u32 Requirements = ComponentList->Requirements;
-    Requirements = Requirements | GetTotalRequirements(EM, Requirements);
-    SummedFlags = SummedFlags | Requirements;
-    ComponentFlags -= ComponentList->Type;
+    SummedFlags = SummedFlags | ComponentList->TotalRequirements;
+    ComponentFlags = AndNot(ComponentFlags, ComponentList->Type);
   }
   return SummedFlags;
 }
 
-// Enumerates each set bit in Bit and finds what index BitSet holds
-// Example:
-// BitMaskOfMap:   | 0 1 1 0 1 1 0 |
-// BitToEnumerate: | 0 0 0 0 1 0 0 |
-// Enumeration:    |   0 1   2 3   | < Order of components in entity_component_link::Components
-// Result: (2)               ^     
-u32 GetIndexOfBitInComponentMap(bitmask32 BitToEnumerate, bitmask32 BitMaskOfMap)
-{
-  Assert(BitMaskOfMap & BitToEnumerate);
-  u32 Index=0;
-  u32 IndexOfBitToEnumerate = 0;
-  IndexOfLeastSignificantSetBit(BitToEnumerate, &IndexOfBitToEnumerate);
-
-  u32 IndexOfBitInMap = 0;
-  while(IndexOfLeastSignificantSetBit(BitMaskOfMap, &IndexOfBitInMap))
-  {
-    if(IndexOfBitToEnumerate == IndexOfBitInMap)
-    {
-      return Index;
-    }
-    BitMaskOfMap -= (1<<IndexOfBitInMap);
-    ++Index;
-  }
-  INVALID_CODE_PATH;
-  return 0;
-}
-
-internal inline entity_component_link*
-GetEntityComponentLink( entity* Entity, bitmask32 ComponentFlag )
+// Fills in TotalRequirements and RequiredBy of all component types.
+// Iterates until nothing changes so requirement chains of any depth (and cycles) are followed.
+internal void ComputeRequirementClosures(entity_manager* EM)
 {
-  u32 ComponentIndex = GetIndexOfBitInComponentMap(ComponentFlag, Entity->ComponentFlags);
-  Assert(GetSetBitCount(ComponentFlag) == 1);
-  entity_component_link* EntityComponentMap = Entity->FirstComponentLink;
-  while(ComponentIndex > 0)
+  for(u32 ComponentIndex = 0; ComponentIndex < EM->ComponentTypeCount; ++ComponentIndex)
   {
-    Assert(EntityComponentMap->Next);
-    EntityComponentMap = EntityComponentMap->Next;
-    ComponentIndex--;
+    component_list* ComponentList = EM->ComponentTypeVector + ComponentIndex;
+    ComponentList->TotalRequirements = ComponentList->Type | ComponentList->Requirements;
   }
-  return EntityComponentMap;
-}
 
-internal bptr GetComponent(entity_manager* EM, entity* Entity, u32 ComponentFlag)
-{
-  if( !(Entity->ComponentFlags & ComponentFlag) )
+  b32 FoundNewRequirement = true;
+  while(FoundNewRequirement)
   {
-    return 0;
+    FoundNewRequirement = false;
+    for(u32 ComponentIndex = 0; ComponentIndex < EM->ComponentTypeCount; ++ComponentIndex)
+    {
+      component_list* ComponentList = EM->ComponentTypeVector + ComponentIndex;
+      component_signature Total = ComponentList->TotalRequirements;
+      component_signature ToVisit = Total;
+      u32 RequiredIndex = 0;
+      while(IndexOfLeastSignificantSetBit(ToVisit, &RequiredIndex))
+      {
+        Assert(RequiredIndex < EM->ComponentTypeCount);
+        Total = Total | EM->ComponentTypeVector[RequiredIndex].TotalRequirements;
+        ToVisit = AndNot(ToVisit, ComponentFlagFromIndex(RequiredIndex));
+      }
+      if(Total != ComponentList->TotalRequirements)
+      {
+        ComponentList->TotalRequirements = Total;
+        FoundNewRequirement = true;
+      }
+    }
   }
 
-  entity_component_link* ComponentMap = GetEntityComponentLink(Entity, ComponentFlag);
-  component_head* Head = ComponentMap->Component;
-  Assert(Head->Type == ComponentFlag);
-
-  bptr Result =  AdvanceByType(Head, component_head);
-  return Result;
-}
-
-internal component_list*
-GetListWithLowestCount(entity_manager* EM, bitmask32 ComponentFlags)
-{
-  component_list* ListWithLowestCount = 0;
-  u32 Index = 0;
-  u32 SmallestSize = U32Max;
-  bitmask32 FlagsToScan = ComponentFlags;
-  while(IndexOfLeastSignificantSetBit(FlagsToScan, &Index))
+  for(u32 ComponentIndex = 0; ComponentIndex < EM->ComponentTypeCount; ++ComponentIndex)
   {
-    component_list* List = EM->ComponentTypeVector + Index;
-    u32 ListSize = GetBlockCount(&List->Components);
-    if(ListSize < SmallestSize)
+    component_list* ComponentList = EM->ComponentTypeVector + ComponentIndex;
+    component_signature Required = ComponentList->TotalRequirements;
+    u32 RequiredIndex = 0;
+    while(IndexOfLeastSignificantSetBit(Required, &RequiredIndex))
     {
-      SmallestSize = ListSize;
-      ListWithLowestCount = List;
+      component_list* RequiredList = EM->ComponentTypeVector + RequiredIndex;
+      RequiredList->RequiredBy = RequiredList->RequiredBy | ComponentList->Type;
+      Required = AndNot(Required, RequiredList->Type);
     }
-    FlagsToScan -= List->Type;
   }
-  return ListWithLowestCount;
 }
 
-internal inline b32
-DoesEntityHoldAllComponents(entity* Entity, bitmask32 Flags)
+// Finds the index of the component array of component type ComponentIndex in an archetype_chunk
+// by counting the components stored before it.
+// Example:
+// ArchetypeFlags: | 0 1 1 0 1 1 0 |
+// ComponentIndex: 2
+// Mask:           | 0 0 0 0 0 1 1 | (Bits below ComponentIndex)
+// Result: PopCount(ArchetypeFlags & Mask) = 2
+internal inline u32
+GetComponentArrayIndex(u32 ComponentIndex, const component_signature& ArchetypeFlags)
 {
-  b32 Result = (Entity->ComponentFlags & Flags) == Flags;
+  Assert(IsBitSet(ArchetypeFlags, ComponentIndex));
+  u32 Result = GetSetBitCountBelow(ArchetypeFlags, ComponentIndex);
   return Result;
 }
 
-
-component_list CreateComponentList(memory_arena* Arena, bitmask32 TypeFlag, bitmask32 RequirmetFlags, u32 ComponentSize, u32 ComponentCountPerChunk)
+// Id of the entity in each row. Ids rather than entity pointers so iterating entities reads
+// the chunk only, the slot table is touched when an entity moves.
+internal inline entity_id*
+GetChunkEntityIDs(archetype_chunk* Chunk)
 {
-  component_list Result = {};
-  Result.Type = TypeFlag;
-  Result.Requirements = RequirmetFlags;
-  u32 TotalSizePerBlock = sizeof(component_head) + ComponentSize;
-  Result.Components = NewChunkList(Arena, TotalSizePerBlock, ComponentCountPerChunk);
+  entity_id* Result = (entity_id*) (((bptr) Chunk) + Chunk->Archetype->EntitiesByteOffset);
   return Result;
 }
 
-
-// Functions in header
-
-entity_id NewEntity( entity_manager* EM )
+// Version of the last write to each component array of the chunk, in archetype array order
+internal inline u32*
+GetChunkChangeVersions(archetype_chunk* Chunk)
 {
-  u32 ListIndex = 0;
-  entity* NewEntity = (entity*) GetNewBlock(&EM->Arena, &EM->EntityList, &ListIndex);
-  NewEntity->ID.EntityID = EM->EntityIdCounter++;
-  NewEntity->ID.ChunkListIndex = ListIndex;
-
-  return NewEntity->ID;
+  u32* Result = (u32*) (((bptr) Chunk) + sizeof(archetype_chunk));
+  return Result;
 }
 
-entity_id NewEntity( entity_manager* EM, bitmask32 ComponentFlags)
+// Index of the value of each shared component the entities of the chunk use, ordered by the set bits in SharedFlags
+internal inline u32*
+GetChunkSharedValueIndices(archetype_chunk* Chunk)
 {
-  entity_id Result = NewEntity(EM);
-  NewComponents(EM, &Result, ComponentFlags);
+  u32* Result = GetChunkChangeVersions(Chunk) + Chunk->Archetype->ComponentCount;
   return Result;
 }
 
-void NewComponents(entity_manager* EM, entity_id* EntityID, u32 ComponentFlags)
+// SharedValueIndices 0 stands for value 0 of every shared component
+internal inline b32
+HasSharedValues(archetype_chunk* Chunk, u32 const* SharedValueIndices)
 {
-  entity* Entity = GetEntityFromID(EM, EntityID);
-
-  // Always allocate memory for requirements not yet fullfilled
-  bitmask32 TotalRequirements = GetTotalRequirements(EM, ComponentFlags);
-  bitmask32 NewComponentFlags = (~Entity->ComponentFlags) & TotalRequirements;
+  u32* ChunkIndices = GetChunkSharedValueIndices(Chunk);
+  for(u32 SharedIndex = 0; SharedIndex < Chunk->Archetype->SharedCount; ++SharedIndex)
+  {
+    u32 ValueIndex = SharedValueIndices ? SharedValueIndices[SharedIndex] : 0;
+    if(ChunkIndices[SharedIndex] != ValueIndex)
+    {
+      return false;
+    }
+  }
+  return true;
+}
 
-  CreateAndInsertNewComponents(EM, Entity, NewComponentFlags);
+internal inline void
+MarkChunkChanged(entity_manager* EM, archetype_chunk* Chunk)
+{
+  u32* ChangeVersions = GetChunkChangeVersions(Chunk);
+  for(u32 ArrayIndex = 0; ArrayIndex < Chunk->Archetype->ComponentCount; ++ArrayIndex)
+  {
+    ChangeVersions[ArrayIndex] = EM->ChangeVersion;
+  }
 }
 
-// Get a single component from an entity
-// Returns 0 if no component exists
-bptr GetComponent(entity_manager* EM, entity_id* EntityID, u32 ComponentFlag)
+internal inline bptr
+GetChunkColumn(archetype_chunk* Chunk, u32 ColumnIndex)
 {
-  Assert( GetSetBitCount(ComponentFlag) == 1);
-  Assert( ComponentFlag != 0 );
-  entity* Entity = GetEntityFromID(EM, EntityID);
-  Assert(Entity); // If this is 0 it probably means that the Entity has been removed from the entity_manager at some point
-  bptr Result = GetComponent(EM, Entity, ComponentFlag);
+  archetype* Archetype = Chunk->Archetype;
+  Assert(ColumnIndex < Archetype->ColumnCount);
+  bptr Result = ((bptr) Chunk) + Archetype->Columns[ColumnIndex].ByteOffset;
   return Result;
 }
 
-b32 HasComponents(entity_manager* EM, entity_id* EntityID, u32 ComponentFlags)
+// The array of FieldIndex of the component at ArrayIndex in the archetype
+internal inline u32
+GetColumnIndex(archetype* Archetype, u32 ArrayIndex, u32 FieldIndex)
 {
-  Assert( ComponentFlags != 0 );
-  entity* Entity = GetEntityFromID(EM, EntityID);
-  Assert(Entity);
-  b32 Result = (Entity->ComponentFlags & ComponentFlags) == ComponentFlags;
+  Assert(ArrayIndex < Archetype->ComponentCount);
+  u32 Result = FieldIndex ? Archetype->FieldColumns[ArrayIndex] + FieldIndex - 1 : ArrayIndex;
+  Assert(Result < Archetype->ColumnCount);
   return Result;
 }
 
-b32 HasOneOfComponents(entity_manager* EM, entity_id* EntityID, u32 ComponentFlags)
+internal inline bptr
+GetChunkComponentArray(archetype_chunk* Chunk, u32 ArrayIndex, u32 FieldIndex = 0)
 {
-  Assert( ComponentFlags != 0 );
-  entity* Entity = GetEntityFromID(EM, EntityID);
-  Assert(Entity);
-  b32 Result = (Entity->ComponentFlags & ComponentFlags) != 0;
+  bptr Result = GetChunkColumn(Chunk, GetColumnIndex(Chunk->Archetype, ArrayIndex, FieldIndex));
   return Result;
 }
 
-filtered_entity_iterator GetComponentsOfType(entity_manager* EM, bitmask32 ComponentFlagsToFilterOn)
+internal u32 GetArchetypeChunkCapacity(entity_manager* EM, component_signature ComponentFlags)
 {
-  component_list* SmallestList = GetListWithLowestCount(EM, ComponentFlagsToFilterOn);
+  u32 SharedCount = GetSetBitCount(ComponentFlags & EM->SharedFlags);
+  ComponentFlags = AndNot(ComponentFlags, EM->TagFlags | EM->SharedFlags);
+  u32 RowByteSize = sizeof(entity_id);
+  u32 ComponentCount = 0;
+  u32 ColumnCount = 0;
+  u32 MaxCapacity = U32Max;
+  u32 ComponentIndex = 0;
+  while(IndexOfLeastSignificantSetBit(ComponentFlags, &ComponentIndex))
+  {
+    Assert(ComponentIndex < EM->ComponentTypeCount);
+    component_list* ComponentList = EM->ComponentTypeVector + ComponentIndex;
+    RowByteSize += ComponentList->ComponentByteSize;
+    if(ComponentList->ComponentChunkCount && ComponentList->ComponentChunkCount < MaxCapacity)
+    {
+      MaxCapacity = ComponentList->ComponentChunkCount;
+    }
+    ComponentFlags = AndNot(ComponentFlags, ComponentList->Type);
+    ComponentCount++;
+    ColumnCount += ComponentList->FieldCount;
+  }
 
-  filtered_entity_iterator Result = {};
-  if(SmallestList)
+  // Each array in the chunk may need up to ECS_COMPONENT_ALIGNMENT bytes of padding
+  midx PaddingByteSize = (ColumnCount + 1) * ECS_COMPONENT_ALIGNMENT;
+  midx AvailableByteSize = ECS_ARCHETYPE_CHUNK_BYTE_SIZE - GetArchetypeChunkHeaderSize(ComponentCount, SharedCount) - PaddingByteSize;
+  u32 Result = (u32) (AvailableByteSize / RowByteSize);
+  Assert(Result > 0); // The components of the archetype don't fit in a chunk
+  if(Result > MaxCapacity)
   {
-    Result.EM = EM;
-    Result.ComponentFilter = ComponentFlagsToFilterOn;
-    Result.ComponentIterator = BeginIterator(&SmallestList->Components);
+    Result = MaxCapacity;
   }
   return Result;
-};
+}
 
-bptr GetComponent(entity_manager* EM, filtered_entity_iterator* EntityIterator, bitmask32 ComponentFlag)
+internal void AddArchetypeIfMatching(entity_manager* EM, query* Query, archetype* Archetype)
 {
-  Assert(GetSetBitCount(ComponentFlag) == 1);
-  if(!EntityIterator->CurrentEntity)
+  if(!HasAll(Archetype->ComponentFlags, Query->ComponentFlags))
   {
-    return 0;
+    return;
   }
-  bptr Result = GetComponent(EM, &EntityIterator->CurrentEntity->ID, ComponentFlag);
-  return Result;
-}
 
-b32 Next(filtered_entity_iterator* EntityIterator)
-{  
-  entity* Entity = 0;
-  while(component_head* ComponentHead = (component_head*) Next(&EntityIterator->ComponentIterator))
+  if(Query->ArchetypeCount == Query->ArchetypeCapacity)
   {
-    if(DoesEntityHoldAllComponents(ComponentHead->Entity, EntityIterator->ComponentFilter))
+    // Archetypes are few and created rarely, the old array is left in the arena
+    u32 NewCapacity = Query->ArchetypeCapacity ? 2 * Query->ArchetypeCapacity : 8;
+    archetype** NewArchetypes = PushArray(&EM->Arena, NewCapacity, archetype*);
+    if(Query->ArchetypeCount)
     {
-      Entity = ComponentHead->Entity;
-      break;
+      utils::Copy(Query->ArchetypeCount * sizeof(archetype*), Query->Archetypes, NewArchetypes);
     }
+    Query->Archetypes = NewArchetypes;
+    Query->ArchetypeCapacity = NewCapacity;
   }
-  EntityIterator->CurrentEntity = Entity;
-
-  return EntityIterator->CurrentEntity != 0;
+  Query->Archetypes[Query->ArchetypeCount++] = Archetype;
 }
 
-entity_manager* CreateEntityManager(u32 EntityChunkCount, u32 EntityMapChunkCount, u32 ComponentCount, entity_manager_definition* DefinitionVector)
+internal archetype* CreateArchetype(entity_manager* EM, component_signature ComponentFlags)
 {
-  entity_manager* Result = BootstrapPushStruct(entity_manager, Arena);
-
-  Result->ComponentTypeCount = ComponentCount;
-  Result->ComponentTypeVector = PushArray(&Result->Arena, ComponentCount, component_list);
-  for(u32 idx = 0; idx < ComponentCount; idx++)
+  Assert(!IsEmpty(ComponentFlags));
+  archetype* Result = (archetype*) GetNewBlock(&EM->Arena, &EM->Archetypes);
+  Result->ComponentFlags = ComponentFlags;
+  Result->StoredFlags = AndNot(ComponentFlags, EM->TagFlags | EM->SharedFlags);
+  Result->SharedFlags = ComponentFlags & EM->SharedFlags;
+  Result->ComponentCount = GetSetBitCount(Result->StoredFlags);
+  Result->SharedCount = GetSetBitCount(Result->SharedFlags);
+  Result->ChunkCapacity = GetArchetypeChunkCapacity(EM, ComponentFlags);
+  Result->FieldColumns = PushArray(&EM->Arena, Result->ComponentCount, u32);
+  Result->ColumnCount = Result->ComponentCount;
+  u32 ArrayIndex = 0;
+  u32 ComponentIndex = 0;
+  component_signature ComponentsToAdd = Result->StoredFlags;
+  while(IndexOfLeastSignificantSetBit(ComponentsToAdd, &ComponentIndex))
   {
-    entity_manager_definition* Definition = DefinitionVector + idx;
-    Result->ComponentTypeVector[IndexOfLeastSignificantSetBit(Definition->ComponentFlag)] =
-    CreateComponentList(&Result->Arena, Definition->ComponentFlag, Definition->RequirementsFlag, Definition->ComponentByteSize, Definition->ComponentChunkCount);  
+    component_list* ComponentList = EM->ComponentTypeVector + ComponentIndex;
+    Result->FieldColumns[ArrayIndex] = Result->ColumnCount;
+    Result->ColumnCount += ComponentList->FieldCount - 1;
+    ComponentsToAdd = AndNot(ComponentsToAdd, ComponentList->Type);
+    ArrayIndex++;
   }
+  Result->Columns = PushArray(&EM->Arena, Result->ColumnCount, archetype_column);
 
-  Result->EntityIdCounter = 1;
-  Result->EntityList = NewChunkList(&Result->Arena, sizeof(entity), EntityChunkCount);
-  Result->EntityComponentLinks = NewChunkList(&Result->Arena, sizeof(entity_component_link), EntityMapChunkCount);
+  ArrayIndex = 0;
+  ComponentsToAdd = Result->StoredFlags;
+  while(IndexOfLeastSignificantSetBit(ComponentsToAdd, &ComponentIndex))
+  {
+    component_list* ComponentList = EM->ComponentTypeVector + ComponentIndex;
+    for(u32 FieldIndex = 0; FieldIndex < ComponentList->FieldCount; ++FieldIndex)
+    {
+      Result->Columns[GetColumnIndex(Result, ArrayIndex, FieldIndex)].ByteSize = ComponentList->FieldByteSizes[FieldIndex];
+    }
+    ComponentsToAdd = AndNot(ComponentsToAdd, ComponentList->Type);
+    ArrayIndex++;
+  }
 
-#if HANDMADE_SLOW
-  for(s32 i = 0; i<ComponentCount; i++)
+  Result->EntitiesByteOffset = (u32) GetArchetypeChunkHeaderSize(Result->ComponentCount, Result->SharedCount);
+  midx Offset = Result->EntitiesByteOffset + Result->ChunkCapacity * sizeof(entity_id);
+  for(u32 ColumnIndex = 0; ColumnIndex < Result->ColumnCount; ++ColumnIndex)
   {
-    Assert(Result->ComponentTypeVector[i].Type);
+    Offset = GetAlignedOffset(Offset, ECS_COMPONENT_ALIGNMENT);
+    Result->Columns[ColumnIndex].ByteOffset = (u32) Offset;
+    Offset += Result->ChunkCapacity * Result->Columns[ColumnIndex].ByteSize;
   }
-#endif
+  Assert(Offset <= ECS_ARCHETYPE_CHUNK_BYTE_SIZE);
 
+  query* Query = EM->FirstQuery;
+  while(Query)
+  {
+    AddArchetypeIfMatching(EM, Query, Result);
+    Query = Query->Next;
+  }
   return Result;
 }
 
-u32 GetEntityCountHoldingTypes(entity_manager* EM, bitmask32 ComponentFlags)
+internal archetype* GetArchetype(entity_manager* EM, component_signature ComponentFlags)
 {
-  u32 Result = 0;
-  component_list* SmallestList = GetListWithLowestCount(EM, ComponentFlags);
-  Assert(GetSetBitCount(ComponentFlags) > 0);
-  b32 AllComponentsAreRequired = (ComponentFlags & SmallestList->Requirements & SmallestList->Type) == ComponentFlags;
-  b32 OnlyLookingForASingleComponentType = GetSetBitCount(ComponentFlags) == 1;
-  if(OnlyLookingForASingleComponentType || AllComponentsAreRequired)
+  chunk_list_iterator Iterator = BeginIterator(&EM->Archetypes);
+  while(archetype* Archetype = (archetype*) Next(&Iterator))
   {
-    Result = GetBlockCount(&SmallestList->Components);
-  }else{
-    chunk_list_iterator Iterator = BeginIterator(&SmallestList->Components);
-    while(component_head* ComponentHead = (component_head*) Next(&Iterator))
+    if(Archetype->ComponentFlags == ComponentFlags)
     {
-      if(DoesEntityHoldAllComponents(ComponentHead->Entity, ComponentFlags))
-      {
-        Result++;
-      }
+      return Archetype;
     }
   }
-  
-  return Result;
+  return 0;
 }
 
-entity_id GetEntityIDFromComponent( bptr Component )
+internal archetype* GetOrCreateArchetype(entity_manager* EM, component_signature ComponentFlags)
 {
-  component_head* Base = (component_head*) RetreatByType(Component, component_head);
-  return Base->Entity->ID;
+  archetype* Result = GetArchetype(EM, ComponentFlags);
+  if(!Result)
+  {
+    Result = CreateArchetype(EM, ComponentFlags);
+  }
+  return Result;
 }
 
-entity_id GetEntityID( filtered_entity_iterator* Iterator )
+internal void LinkChunk(archetype* Archetype, archetype_chunk* Chunk)
 {
-  Assert(Iterator->CurrentEntity);
-  entity_id Result = Iterator->CurrentEntity->ID;
-  return Result;
+  Chunk->Next = 0;
+  Chunk->Previous = Archetype->LastChunk;
+  if(Archetype->LastChunk)
+  {
+    Archetype->LastChunk->Next = Chunk;
+  }else{
+    Archetype->FirstChunk = Chunk;
+  }
+  Archetype->LastChunk = Chunk;
 }
 
-// Result must point to an array of pointers to entity_id long enough to hold pointers to all entities contianing type
-void GetEntitiesHoldingTypes(entity_manager* EM, bitmask32 ComponentFlags, entity_id* ResultVector)
+internal void UnlinkChunk(archetype* Archetype, archetype_chunk* Chunk)
 {
-  Assert(GetSetBitCount(ComponentFlags) > 0);
-  component_list* SmallestList = GetListWithLowestCount(EM, ComponentFlags);
-  chunk_list_iterator Iterator = BeginIterator(&SmallestList->Components);
-  while(component_head* ComponentHead = (component_head*) Next(&Iterator))
+  if(Chunk->Previous)
   {
-    if(DoesEntityHoldAllComponents(ComponentHead->Entity, ComponentFlags))
-    {
-      *ResultVector++ = ComponentHead->Entity->ID;
-    }
+    Chunk->Previous->Next = Chunk->Next;
+  }else{
+    Archetype->FirstChunk = Chunk->Next;
+  }
+
+  if(Chunk->Next)
+  {
+    Chunk->Next->Previous = Chunk->Previous;
+  }else{
+    Archetype->LastChunk = Chunk->Previous;
   }
+  Chunk->Next = 0;
+  Chunk->Previous = 0;
 }
 
-internal inline component_list* GetComponentList(entity_manager* EM, bitmask32 ComponentFlag)
+internal void LinkChunkWithSpace(archetype* Archetype, archetype_chunk* Chunk)
 {
-  u32 ComponentListIndex = IndexOfLeastSignificantSetBit(ComponentFlag);
-  component_list* ComponentList = EM->ComponentTypeVector + ComponentListIndex;
-  return ComponentList;
+  Chunk->PreviousWithSpace = 0;
+  Chunk->NextWithSpace = Archetype->FirstChunkWithSpace;
+  if(Archetype->FirstChunkWithSpace)
+  {
+    Archetype->FirstChunkWithSpace->PreviousWithSpace = Chunk;
+  }
+  Archetype->FirstChunkWithSpace = Chunk;
 }
 
-internal inline component_list* GetComponentList(entity_manager* EM, entity_component_link* ComponentLink)
+internal void UnlinkChunkWithSpace(archetype* Archetype, archetype_chunk* Chunk)
 {
-  component_list* ComponentList = GetComponentList(EM, ComponentLink->Component->Type);
-  return ComponentList;
+  if(Chunk->PreviousWithSpace)
+  {
+    Chunk->PreviousWithSpace->NextWithSpace = Chunk->NextWithSpace;
+  }else{
+    Assert(Archetype->FirstChunkWithSpace == Chunk);
+    Archetype->FirstChunkWithSpace = Chunk->NextWithSpace;
+  }
+
+  if(Chunk->NextWithSpace)
+  {
+    Chunk->NextWithSpace->PreviousWithSpace = Chunk->PreviousWithSpace;
+  }
+  Chunk->NextWithSpace = 0;
+  Chunk->PreviousWithSpace = 0;
 }
 
-bitmask32 GetCascadedRequirements(entity_manager* EM, entity* Entity, bitmask32 ComponentFlag)
+// SharedValueIndices holds Archetype->SharedCount indices or is 0 for value 0 of every shared component
+internal archetype_chunk* AllocateChunk(entity_manager* EM, archetype* Archetype, u32 const* SharedValueIndices)
 {
-  entity_component_link* ComponentLink = Entity->FirstComponentLink;
-  u32 ComponentsToRemainCount = 0;
-  bitmask32 TotalRequirements = ComponentFlag;
-  while(ComponentLink)
+  if(!EM->FirstFreeChunk)
   {
-    component_list* ComponentList = GetComponentList(EM, ComponentLink);
-    b32 ComponentToRemoveIsRequiredByAnother = TotalRequirements & ComponentList->Requirements;
-    if(ComponentToRemoveIsRequiredByAnother)
+    // Push several chunks at once and align them to ECS_ARCHETYPE_CHUNK_BYTE_SIZE.
+    // The alignment wastes at most one chunk per batch.
+    const u32 ChunkBatchCount = 16;
+    midx BatchBase = (midx) PushSize(&EM->Arena, (ChunkBatchCount + 1) * ECS_ARCHETYPE_CHUNK_BYTE_SIZE);
+    bptr AlignedBase = (bptr) GetAlignedOffset(BatchBase, ECS_ARCHETYPE_CHUNK_BYTE_SIZE);
+    for(u32 ChunkIndex = 0; ChunkIndex < ChunkBatchCount; ++ChunkIndex)
     {
-      bitmask32 NewTotalRequirements = ComponentList->Type | TotalRequirements;
-      if(NewTotalRequirements > TotalRequirements)
-      {
-        TotalRequirements = NewTotalRequirements;
-        // If we added a new flag to the summed flags, the newly added flag may itself have 
-        // requirements earlier in the component list, therefore we have to look through all the 
-        // links again. 
-        // NOTE: Since all component types are known at start up, the reverse-requirement chain
-        //       Can be calculated and chached at entity_manager initialization.
-        ComponentLink = Entity->FirstComponentLink;
-      }
+      archetype_chunk* Chunk = (archetype_chunk*) (AlignedBase + ChunkIndex * ECS_ARCHETYPE_CHUNK_BYTE_SIZE);
+      Chunk->Next = EM->FirstFreeChunk;
+      EM->FirstFreeChunk = Chunk;
     }
-    ComponentLink = ComponentLink->Next;
+    EM->FreeChunkCount += ChunkBatchCount;
   }
-  Assert((TotalRequirements & Entity->ComponentFlags) == TotalRequirements);
-  return TotalRequirements;
+
+  archetype_chunk* Result = EM->FirstFreeChunk;
+  EM->FirstFreeChunk = Result->Next;
+  EM->FreeChunkCount--;
+  *Result = {};
+  Result->Archetype = Archetype;
+  u32* ChunkIndices = GetChunkSharedValueIndices(Result);
+  for(u32 SharedIndex = 0; SharedIndex < Archetype->SharedCount; ++SharedIndex)
+  {
+    ChunkIndices[SharedIndex] = SharedValueIndices ? SharedValueIndices[SharedIndex] : 0;
+  }
+  LinkChunk(Archetype, Result);
+  LinkChunkWithSpace(Archetype, Result);
+  Archetype->ChunkCount++;
+  return Result;
 }
 
-void DeleteComponents(entity_manager* EM, entity_id* EntityID, bitmask32 ComponentFlag)
+internal void FreeChunk(entity_manager* EM, archetype_chunk* Chunk)
 {
-  entity* Entity = GetEntityFromID(EM, EntityID);
-  
-  bitmask32 TotalRequirements = GetCascadedRequirements(EM, Entity, ComponentFlag);
-
-  temporary_memory TempMem = BeginTemporaryMemory(&EM->Arena);
-
-  u32 ComponentCount = GetSetBitCount(Entity->ComponentFlags);
-
-  Assert(ComponentCount); // For now we cannot delete components in entities with no components. Can be handled if needed.
+  Assert(Chunk->EntityCount == 0);
+  archetype* Archetype = Chunk->Archetype;
+  UnlinkChunk(Archetype, Chunk);
+  UnlinkChunkWithSpace(Archetype, Chunk);
+  Archetype->ChunkCount--;
+  Chunk->Archetype = 0;
+  Chunk->Next = EM->FirstFreeChunk;
+  EM->FirstFreeChunk = Chunk;
+  EM->FreeChunkCount++;
+}
 
-  // We add +1 for saftey to have some 0-space after the last link. Is necessary if we remove 0 links (should not happend I don't think)
-  entity_component_link** ComponentsToRemain = PushArray(&EM->Arena, ComponentCount+1, entity_component_link*);
-  entity_component_link* ComponentLink = Entity->FirstComponentLink;
-  u32 ComponentsToRemainCount = 0;
-  while(ComponentLink)
+// First chunk of Archetype with a free row whose entities use SharedValueIndices, a new one if there is none
+internal archetype_chunk* GetChunkWithSpace(entity_manager* EM, archetype* Archetype, u32 const* SharedValueIndices)
+{
+  archetype_chunk* Result = Archetype->FirstChunkWithSpace;
+  if(Archetype->SharedCount)
   {
-    b32 ComponentShouldBeRemoved = (ComponentLink->Component->Type & TotalRequirements) == ComponentLink->Component->Type;
-    if(ComponentShouldBeRemoved)
+    while(Result && !HasSharedValues(Result, SharedValueIndices))
     {
-      entity_component_link* LinkToRemove = ComponentLink;
-      ComponentLink = ComponentLink->Next;
-
-      component_list* ComponentList = GetComponentList(EM, LinkToRemove);
-
-      FreeBlock(&ComponentList->Components, (bptr) LinkToRemove->Component);
-      FreeBlock(&EM->EntityComponentLinks, (bptr) LinkToRemove);
-    }else{
-      ComponentsToRemain[ComponentsToRemainCount++] = ComponentLink;
-      ComponentLink = ComponentLink->Next;
+      Result = Result->NextWithSpace;
     }
   }
-  
-  // Asserting we actually removed some components.
-  Assert(ComponentsToRemainCount < ComponentCount);
- 
-  // Reattach the remaining components to the entity
-  Entity->FirstComponentLink = ComponentsToRemain[0];
-  u32 LinkIndex = 1;
-  ComponentLink = Entity->FirstComponentLink;
-  while(ComponentLink)
+  if(!Result)
   {
-    // This is why it's safe to have an extra 0-space at the end of ComponentsToRemain.
-    // The final "ComponentLink->Next" has to be a 0. We don't want to stick garbage memory there.
-    ComponentLink->Next = ComponentsToRemain[LinkIndex++];
-    ComponentLink = ComponentLink->Next;
+    Result = AllocateChunk(EM, Archetype, SharedValueIndices);
   }
-  
-  Entity->ComponentFlags -= TotalRequirements;
+  return Result;
+}
+
+// Places Entity in the first row available in Archetype. The component memory of the new row is left untouched.
+internal void AllocateArchetypeRow(entity_manager* EM, archetype* Archetype, entity* Entity, u32 const* SharedValueIndices)
+{
+  archetype_chunk* Chunk = GetChunkWithSpace(EM, Archetype, SharedValueIndices);
 
-  // Makes sure that if we have 0 components left, the FirstComponentLink is also 0
-  // Or if we have components left we also have a link left
-  Assert((Entity->ComponentFlags == 0 && Entity->FirstComponentLink == 0) || 
-         (Entity->ComponentFlags != 0 && Entity->FirstComponentLink != 0))
+  u32 Row = Chunk->EntityCount++;
+  GetChunkEntityIDs(Chunk)[Row] = Entity->ID;
+  MarkChunkChanged(EM, Chunk);
+  Archetype->EntityCount++;
+  Entity->Chunk = Chunk;
+  Entity->Row = Row;
 
-  EndTemporaryMemory(TempMem);
+  if(Chunk->EntityCount == Archetype->ChunkCapacity)
+  {
+    UnlinkChunkWithSpace(Archetype, Chunk);
+  }
 }
 
-void DeleteEntities(entity_manager* EM, u32 Count, entity_id* EntityID)
+// Fills Count elements of ByteSize at Destination with Value. The filled range is doubled with every
+// copy so large fills are a handful of memcpys.
+internal void FillRepeated(bptr Destination, bptr Value, u32 ByteSize, u32 Count)
 {
-  for(u32 Index = 0; Index < Count; ++Index)
+  if(!Count)
+  {
+    return;
+  }
+  utils::Copy(ByteSize, Value, Destination);
+  midx FilledSize = ByteSize;
+  midx TotalSize = (midx) Count * ByteSize;
+  while(FilledSize < TotalSize)
   {
-    DeleteEntity(EM, EntityID+Index);
+    midx CopySize = Minimum(FilledSize, TotalSize - FilledSize);
+    utils::Copy(CopySize, Destination, Destination + FilledSize);
+    FilledSize += CopySize;
   }
 }
 
-void DeleteEntity(entity_manager* EM, entity_id* EntityID)
+// Places Count new entities in Archetype, filling one chunk at a time, into chunks using SharedValueIndices.
+// Component memory is set with one fill per array and chunk, to ColumnValues[ColumnIndex] or zero if
+// ColumnValues is 0. OutIDs may be 0.
+internal void AllocateArchetypeRows(entity_manager* EM, archetype* Archetype, u32 Count, entity_id* OutIDs,
+                                    u32 const* SharedValueIndices = 0, bptr const* ColumnValues = 0)
 {
-  entity* Entity = GetEntityFromID(EM, EntityID);
-  bitmask32 ComponentFlags = Entity->ComponentFlags;
-  entity_component_link* ComponentLink = Entity->FirstComponentLink;
-  
-  while(ComponentLink)
+  u32 DoneCount = 0;
+  while(DoneCount < Count)
+  {
+    archetype_chunk* Chunk = GetChunkWithSpace(EM, Archetype, SharedValueIndices);
+
+    u32 FirstRow = Chunk->EntityCount;
+    u32 RowCount = Minimum(Archetype->ChunkCapacity - FirstRow, Count - DoneCount);
+    entity_id* EntityIDs = GetChunkEntityIDs(Chunk);
+    for(u32 Row = FirstRow; Row < FirstRow + RowCount; ++Row)
+    {
+      entity* Entity = AllocateEntitySlot(EM);
+      Entity->Chunk = Chunk;
+      Entity->Row = Row;
+      EntityIDs[Row] = Entity->ID;
+      if(OutIDs)
+      {
+        OutIDs[DoneCount + Row - FirstRow] = Entity->ID;
+      }
+    }
+    for(u32 ColumnIndex = 0; ColumnIndex < Archetype->ColumnCount; ++ColumnIndex)
+    {
+      u32 ByteSize = Archetype->Columns[ColumnIndex].ByteSize;
+      bptr Destination = GetChunkColumn(Chunk, ColumnIndex) + FirstRow * ByteSize;
+      if(ColumnValues)
+      {
+        FillRepeated(Destination, ColumnValues[ColumnIndex], ByteSize, RowCount);
+      }else{
+        memset(Destination, 0, RowCount * ByteSize);
+      }
+    }
+
+    MarkChunkChanged(EM, Chunk);
+    Chunk->EntityCount += RowCount;
+    Archetype->EntityCount += RowCount;
+    if(Chunk->EntityCount == Archetype->ChunkCapacity)
+    {
+      UnlinkChunkWithSpace(Archetype, Chunk);
+    }
+    DoneCount += RowCount;
+  }
+}
+
+// Removes a row from Chunk by moving the last row of the chunk into its place.
+internal void RemoveArchetypeRow(entity_manager* EM, archetype_chunk* Chunk, u32 Row)
+{
+  archetype* Archetype = Chunk->Archetype;
+  Assert(Row < Chunk->EntityCount);
+  u32 LastRow = Chunk->EntityCount - 1;
+  if(Row != LastRow)
   {
-    entity_component_link* ComponentLinkToRemove = ComponentLink;
-    ComponentLink = ComponentLink->Next;
+    for(u32 ColumnIndex = 0; ColumnIndex < Archetype->ColumnCount; ++ColumnIndex)
+    {
+      u32 ByteSize = Archetype->Columns[ColumnIndex].ByteSize;
+      bptr Column = GetChunkColumn(Chunk, ColumnIndex);
+      utils::Copy(ByteSize, Column + LastRow * ByteSize, Column + Row * ByteSize);
+    }
+    entity_id* EntityIDs = GetChunkEntityIDs(Chunk);
+    EntityIDs[Row] = EntityIDs[LastRow];
+    GetEntitySlot(EM, EntityIDs[Row].SlotIndex)->Row = Row;
+    MarkChunkChanged(EM, Chunk);
+  }
 
-    u32 ComponentListIndex = IndexOfLeastSignificantSetBit(ComponentLinkToRemove->Component->Type);
-    component_list* ComponentList = EM->ComponentTypeVector + ComponentListIndex;
+  if(Chunk->EntityCount == Archetype->ChunkCapacity)
+  {
+    LinkChunkWithSpace(Archetype, Chunk);
+  }
+  Chunk->EntityCount--;
+  Archetype->EntityCount--;
 
-    FreeBlock(&ComponentList->Components, (bptr) ComponentLinkToRemove->Component);
-    FreeBlock(&EM->EntityComponentLinks, (bptr) ComponentLinkToRemove);
-    
+  if(Chunk->EntityCount == 0)
+  {
+    FreeChunk(EM, Chunk);
   }
+}
 
-  FreeBlock(&EM->EntityList, (bptr) Entity);
+// The shared value indices of an entity of OldChunk moved to NewArchetype. Shared components the entity
+// keeps keep their value, new ones get value 0. OldChunk may be 0.
+internal void GetMovedSharedValueIndices(archetype_chunk* OldChunk, archetype* NewArchetype, u32* Result)
+{
+  component_signature OldSharedFlags = OldChunk ? OldChunk->Archetype->SharedFlags : component_signature{};
+  u32* OldIndices = OldChunk ? GetChunkSharedValueIndices(OldChunk) : 0;
+  u32 SharedIndex = 0;
+  u32 ComponentIndex = 0;
+  component_signature SharedFlags = NewArchetype->SharedFlags;
+  while(IndexOfLeastSignificantSetBit(SharedFlags, &ComponentIndex))
+  {
+    b32 KeepsValue = IsBitSet(OldSharedFlags, ComponentIndex);
+    Result[SharedIndex++] = KeepsValue ? OldIndices[GetSetBitCountBelow(OldSharedFlags, ComponentIndex)] : 0;
+    SharedFlags = AndNot(SharedFlags, ComponentFlagFromIndex(ComponentIndex));
+  }
 }
 
-}
\ No newline at end of file
+// Moves Entity to NewArchetype, into a chunk using SharedValueIndices. Components the entity keeps are copied,
+// new components are zero initialized and components not in NewArchetype are dropped. NewArchetype 0 drops all components.
+internal void MoveEntityToArchetype(entity_manager* EM, entity* Entity, archetype* NewArchetype, u32 const* SharedValueIndices)
+{
+  archetype_chunk* OldChunk = Entity->Chunk;
+  u32 OldRow = Entity->Row;
+  component_signature OldStoredFlags = OldChunk ? OldChunk->Archetype->StoredFlags : component_signature{};
+
+  Entity->Chunk = 0;
+  Entity->Row = 0;
+  if(NewArchetype)
+  {
+    AllocateArchetypeRow(EM, NewArchetype, Entity, SharedValueIndices);
+
+    u32 ArrayIndex = 0;
+    u32 ComponentIndex = 0;
+    component_signature FlagsToCopy = NewArchetype->StoredFlags;
+    while(IndexOfLeastSignificantSetBit(FlagsToCopy, &ComponentIndex))
+    {
+      b32 KeepsComponent = IsBitSet(OldStoredFlags, ComponentIndex);
+      u32 OldArrayIndex = KeepsComponent ? GetComponentArrayIndex(ComponentIndex, OldStoredFlags) : 0;
+      u32 FieldCount = EM->ComponentTypeVector[ComponentIndex].FieldCount;
+      for(u32 FieldIndex = 0; FieldIndex < FieldCount; ++FieldIndex)
+      {
+        u32 ColumnIndex = GetColumnIndex(NewArchetype, ArrayIndex, FieldIndex);
+        u32 ByteSize = NewArchetype->Columns[ColumnIndex].ByteSize;
+        bptr Destination = GetChunkColumn(Entity->Chunk, ColumnIndex) + Entity->Row * ByteSize;
+        if(KeepsComponent)
+        {
+          bptr Source = GetChunkComponentArray(OldChunk, OldArrayIndex, FieldIndex) + OldRow * ByteSize;
+          utils::Copy(ByteSize, Source, Destination);
+        }else{
+          memset(Destination, 0, ByteSize);
+        }
+      }
+      FlagsToCopy = AndNot(FlagsToCopy, ComponentFlagFromIndex(ComponentIndex));
+      ArrayIndex++;
+    }
+  }
+
+  if(OldChunk)
+  {
+    RemoveArchetypeRow(EM, OldChunk, OldRow);
+  }
+}
+
+internal void MoveEntityToArchetype(entity_manager* EM, entity* Entity, archetype* NewArchetype)
+{
+  u32 SharedValueIndices[ECS_MAX_COMPONENT_TYPES];
+  if(NewArchetype)
+  {
+    GetMovedSharedValueIndices(Entity->Chunk, NewArchetype, SharedValueIndices);
+  }
+  MoveEntityToArchetype(EM, Entity, NewArchetype, SharedValueIndices);
+}
+
+internal void MoveEntityToArchetype(entity_manager* EM, entity* Entity, component_signature NewComponentFlags)
+{
+  archetype* NewArchetype = IsEmpty(NewComponentFlags) ? 0 : GetOrCreateArchetype(EM, NewComponentFlags);
+  MoveEntityToArchetype(EM, Entity, NewArchetype);
+}
+
+// Write marks the component array of the entity's chunk as changed
+internal bptr GetComponent(entity_manager* EM, entity* Entity, u32 ComponentIndex, u32 FieldIndex, b32 Write)
+{
+  archetype_chunk* Chunk = Entity->Chunk;
+  if(!Chunk)
+  {
+    return 0;
+  }
+
+  archetype* Archetype = Chunk->Archetype;
+  if(!IsBitSet(Archetype->ComponentFlags, ComponentIndex))
+  {
+    return 0;
+  }
+  Assert(IsBitSet(Archetype->StoredFlags, ComponentIndex)); // Tags and shared components have no data per entity
+
+  // One masked popcount to find the array, one load to find where the array is in the chunk
+  Assert(Entity->Row < Chunk->EntityCount);
+  u32 ArrayIndex = GetComponentArrayIndex(ComponentIndex, Archetype->StoredFlags);
+  archetype_column Column = Archetype->Columns[GetColumnIndex(Archetype, ArrayIndex, FieldIndex)];
+  bptr Result = ((bptr) Chunk) + Column.ByteOffset + Entity->Row * Column.ByteSize;
+  if(Write)
+  {
+    GetChunkChangeVersions(Chunk)[ArrayIndex] = EM->ChangeVersion;
+  }
+  return Result;
+}
+
+internal inline b32
+DoesArchetypeHoldAllComponents(archetype* Archetype, const component_signature& Flags)
+{
+  b32 Result = HasAll(Archetype->ComponentFlags, Flags);
+  return Result;
+}
+
+component_list CreateComponentList(component_signature TypeFlag, component_signature RequirmetFlags, u32 ComponentSize, u32 ComponentCountPerChunk)
+{
+  component_list Result = {};
+  Result.Type = TypeFlag;
+  Result.Requirements = RequirmetFlags;
+  Result.ComponentByteSize = ComponentSize;
+  Result.ComponentChunkCount = ComponentCountPerChunk;
+  return Result;
+}
+
+
+// Functions in header
+
+entity_id NewEntity( entity_manager* EM )
+{
+  entity* NewEntity = AllocateEntitySlot(EM);
+  return NewEntity->ID;
+}
+
+entity_id NewEntity( entity_manager* EM, component_signature ComponentFlags)
+{
+  entity_id Result = NewEntity(EM);
+  NewComponents(EM, &Result, ComponentFlags);
+  return Result;
+}
+
+void NewEntities(entity_manager* EM, u32 Count, component_signature ComponentFlags, entity_id* OutIDs)
+{
+  // Requirements and archetype are resolved once for the whole batch
+  component_signature TotalRequirements = GetTotalRequirements(EM, ComponentFlags);
+  if(IsEmpty(TotalRequirements))
+  {
+    for(u32 Index = 0; Index < Count; ++Index)
+    {
+      entity_id EntityID = NewEntity(EM);
+      if(OutIDs)
+      {
+        OutIDs[Index] = EntityID;
+      }
+    }
+    return;
+  }
+
+  archetype* Archetype = GetOrCreateArchetype(EM, TotalRequirements);
+  AllocateArchetypeRows(EM, Archetype, Count, OutIDs);
+}
+
+
+void NewComponents(entity_manager* EM, entity_id* EntityID, component_signature ComponentFlags)
+{
+  entity* Entity = GetEntityFromID(EM, EntityID);
+
+  // Always allocate memory for requirements not yet fullfilled
+  component_signature EntityFlags = GetEntityComponentFlags(Entity);
+  component_signature TotalRequirements = GetTotalRequirements(EM, ComponentFlags);
+  component_signature NewComponentFlags = AndNot(TotalRequirements, EntityFlags);
+  if(!IsEmpty(NewComponentFlags))
+  {
+    MoveEntityToArchetype(EM, Entity, EntityFlags | NewComponentFlags);
+  }
+}
+
+// Get a single component from an entity
+// Returns 0 if no component exists
+bptr GetComponent(entity_manager* EM, entity_id* EntityID, component_signature ComponentFlag)
+{
+  Assert( GetSetBitCount(ComponentFlag) == 1);
+  entity* Entity = GetEntityFromID(EM, EntityID);
+  Assert(Entity); // If this is 0 it probably means that the Entity has been removed from the entity_manager at some point
+  u32 ComponentIndex = GetComponentIndex(ComponentFlag);
+  Assert(IsStoredAsStruct(EM->ComponentTypeVector + ComponentIndex)); // See GetComponentField and GetComponentInstances
+  bptr Result = GetComponent(EM, Entity, ComponentIndex, 0, true);
+  return Result;
+}
+
+bptr GetReadOnlyComponent(entity_manager* EM, entity_id* EntityID, component_signature ComponentFlag)
+{
+  entity* Entity = GetEntityFromID(EM, EntityID);
+  u32 ComponentIndex = GetComponentIndex(ComponentFlag);
+  Assert(IsStoredAsStruct(EM->ComponentTypeVector + ComponentIndex));
+  bptr Result = GetComponent(EM, Entity, ComponentIndex, 0, false);
+  return Result;
+}
+
+bptr GetComponentField(entity_manager* EM, entity_id* EntityID, component_signature ComponentFlag, u32 FieldIndex)
+{
+  entity* Entity = GetEntityFromID(EM, EntityID);
+  bptr Result = GetComponent(EM, Entity, GetComponentIndex(ComponentFlag), FieldIndex, true);
+  return Result;
+}
+
+bptr GetReadOnlyComponentField(entity_manager* EM, entity_id* EntityID, component_signature ComponentFlag, u32 FieldIndex)
+{
+  entity* Entity = GetEntityFromID(EM, EntityID);
+  bptr Result = GetComponent(EM, Entity, GetComponentIndex(ComponentFlag), FieldIndex, false);
+  return Result;
+}
+
+b32 IsAlive(entity_manager* EM, entity_id* EntityID)
+{
+  b32 Result = TryGetEntityFromID(EM, EntityID) != 0;
+  return Result;
+}
+
+// Like GetComponent but returns 0 instead of asserting if the entity has been deleted
+bptr TryGetComponent(entity_manager* EM, entity_id* EntityID, component_signature ComponentFlag)
+{
+  entity* Entity = TryGetEntityFromID(EM, EntityID);
+  if(!Entity)
+  {
+    return 0;
+  }
+  u32 ComponentIndex = GetComponentIndex(ComponentFlag);
+  Assert(IsStoredAsStruct(EM->ComponentTypeVector + ComponentIndex));
+  bptr Result = GetComponent(EM, Entity, ComponentIndex, 0, true);
+  return Result;
+}
+
+internal component_instances* GetComponentInstances(entity_manager* EM, entity* Entity, component_signature ComponentFlag, b32 Write)
+{
+  u32 ComponentIndex = GetComponentIndex(ComponentFlag);
+  Assert(EM->ComponentTypeVector[ComponentIndex].InstanceCapacity); // Not declared with InstanceCapacity
+  component_instances* Result = (component_instances*) GetComponent(EM, Entity, ComponentIndex, 0, Write);
+  return Result;
+}
+
+internal inline bptr GetFirstInstance(component_instances* Instances)
+{
+  bptr Result = ((bptr) Instances) + ECS_COMPONENT_INSTANCES_HEADER_SIZE;
+  return Result;
+}
+
+bptr GetComponentInstances(entity_manager* EM, entity_id* EntityID, component_signature ComponentFlag, u32* InstanceCount)
+{
+  component_instances* Instances = GetComponentInstances(EM, GetEntityFromID(EM, EntityID), ComponentFlag, true);
+  *InstanceCount = Instances ? Instances->Count : 0;
+  bptr Result = Instances ? GetFirstInstance(Instances) : 0;
+  return Result;
+}
+
+bptr GetReadOnlyComponentInstances(entity_manager* EM, entity_id* EntityID, component_signature ComponentFlag, u32* InstanceCount)
+{
+  component_instances* Instances = GetComponentInstances(EM, GetEntityFromID(EM, EntityID), ComponentFlag, false);
+  *InstanceCount = Instances ? Instances->Count : 0;
+  bptr Result = Instances ? GetFirstInstance(Instances) : 0;
+  return Result;
+}
+
+bptr AddComponentInstance(entity_manager* EM, entity_id* EntityID, component_signature ComponentFlag)
+{
+  entity* Entity = GetEntityFromID(EM, EntityID);
+  if(!HasAll(GetEntityComponentFlags(Entity), ComponentFlag))
+  {
+    // A new component starts out zeroed, without instances
+    NewComponents(EM, EntityID, ComponentFlag);
+  }
+  component_list* ComponentList = EM->ComponentTypeVector + GetComponentIndex(ComponentFlag);
+  component_instances* Instances = GetComponentInstances(EM, Entity, ComponentFlag, true);
+  if(Instances->Count == ComponentList->InstanceCapacity)
+  {
+    return 0;
+  }
+  bptr Result = GetFirstInstance(Instances) + Instances->Count * ComponentList->InstanceByteSize;
+  memset(Result, 0, ComponentList->InstanceByteSize);
+  Instances->Count++;
+  return Result;
+}
+
+void RemoveComponentInstance(entity_manager* EM, entity_id* EntityID, component_signature ComponentFlag, u32 InstanceIndex)
+{
+  component_list* ComponentList = EM->ComponentTypeVector + GetComponentIndex(ComponentFlag);
+  component_instances* Instances = GetComponentInstances(EM, GetEntityFromID(EM, EntityID), ComponentFlag, true);
+  Assert(Instances && InstanceIndex < Instances->Count);
+  // Instances after the removed one move down so the order is kept
+  bptr Instance = GetFirstInstance(Instances) + InstanceIndex * ComponentList->InstanceByteSize;
+  u32 MoveCount = Instances->Count - InstanceIndex - 1;
+  memmove(Instance, Instance + ComponentList->InstanceByteSize, MoveCount * ComponentList->InstanceByteSize);
+  Instances->Count--;
+}
+
+internal inline component_list* GetSharedComponentList(entity_manager* EM, component_signature ComponentFlag)
+{
+  component_list* Result = EM->ComponentTypeVector + GetComponentIndex(ComponentFlag);
+  Assert(Result->SharedValueCapacity);
+  return Result;
+}
+
+// Index of the value of the shared component at ComponentIndex used by the entities of Chunk, U32Max if it has none
+internal inline u32 GetSharedComponentIndex(archetype_chunk* Chunk, u32 ComponentIndex)
+{
+  if(!Chunk || !IsBitSet(Chunk->Archetype->SharedFlags, ComponentIndex))
+  {
+    return U32Max;
+  }
+  u32 Result = GetChunkSharedValueIndices(Chunk)[GetSetBitCountBelow(Chunk->Archetype->SharedFlags, ComponentIndex)];
+  return Result;
+}
+
+u32 AddSharedComponentValue(entity_manager* EM, component_signature ComponentFlag, void const* Value)
+{
+  component_list* ComponentList = GetSharedComponentList(EM, ComponentFlag);
+  u32 ByteSize = ComponentList->ComponentByteSize;
+  // Few values per type, a linear search keeps the indices dense
+  for(u32 ValueIndex = 0; ValueIndex < ComponentList->SharedValueCount; ++ValueIndex)
+  {
+    if(memcmp(ComponentList->SharedValues + ValueIndex * ByteSize, Value, ByteSize) == 0)
+    {
+      return ValueIndex;
+    }
+  }
+  if(ComponentList->SharedValueCount == ComponentList->SharedValueCapacity)
+  {
+    return U32Max;
+  }
+  u32 Result = ComponentList->SharedValueCount++;
+  utils::Copy(ByteSize, (void*) Value, ComponentList->SharedValues + Result * ByteSize);
+  return Result;
+}
+
+bptr GetSharedComponentValue(entity_manager* EM, component_signature ComponentFlag, u32 ValueIndex)
+{
+  component_list* ComponentList = GetSharedComponentList(EM, ComponentFlag);
+  Assert(ValueIndex < ComponentList->SharedValueCount);
+  bptr Result = ComponentList->SharedValues + ValueIndex * ComponentList->ComponentByteSize;
+  return Result;
+}
+
+void SetSharedComponent(entity_manager* EM, entity_id* EntityID, component_signature ComponentFlag, u32 ValueIndex)
+{
+  Assert(ValueIndex < GetSharedComponentList(EM, ComponentFlag)->SharedValueCount);
+  entity* Entity = GetEntityFromID(EM, EntityID);
+  u32 ComponentIndex = GetComponentIndex(ComponentFlag);
+  Assert(GetSharedComponentIndex(Entity->Chunk, ComponentIndex) != U32Max); // The entity doesn't hold the component
+  if(GetSharedComponentIndex(Entity->Chunk, ComponentIndex) == ValueIndex)
+  {
+    return;
+  }
+
+  // Same archetype, another chunk
+  archetype* Archetype = Entity->Chunk->Archetype;
+  u32 SharedValueIndices[ECS_MAX_COMPONENT_TYPES];
+  GetMovedSharedValueIndices(Entity->Chunk, Archetype, SharedValueIndices);
+  SharedValueIndices[GetSetBitCountBelow(Archetype->SharedFlags, ComponentIndex)] = ValueIndex;
+  MoveEntityToArchetype(EM, Entity, Archetype, SharedValueIndices);
+}
+
+u32 GetSharedComponentIndex(entity_manager* EM, entity_id* EntityID, component_signature ComponentFlag)
+{
+  entity* Entity = GetEntityFromID(EM, EntityID);
+  u32 Result = GetSharedComponentIndex(Entity->Chunk, GetComponentIndex(ComponentFlag));
+  return Result;
+}
+
+// One row of every column of an archetype and the shared values its instances use
+struct prefab
+{
+  archetype* Archetype;
+  bptr* ColumnValues;       // [Archetype->ColumnCount], each of Columns[ColumnIndex].ByteSize
+  u32* SharedValueIndices;  // [Archetype->SharedCount]
+};
+
+prefab* CreatePrefab(entity_manager* EM, component_signature ComponentFlags)
+{
+  component_signature TotalRequirements = GetTotalRequirements(EM, ComponentFlags);
+  Assert(!IsEmpty(TotalRequirements));
+  archetype* Archetype = GetOrCreateArchetype(EM, TotalRequirements);
+
+  prefab* Result = PushStruct(&EM->Arena, prefab);
+  Result->Archetype = Archetype;
+  Result->ColumnValues = PushArray(&EM->Arena, Archetype->ColumnCount, bptr);
+  for(u32 ColumnIndex = 0; ColumnIndex < Archetype->ColumnCount; ++ColumnIndex)
+  {
+    u32 ByteSize = Archetype->Columns[ColumnIndex].ByteSize;
+    Result->ColumnValues[ColumnIndex] = (bptr) PushSize(&EM->Arena, ByteSize);
+    memset(Result->ColumnValues[ColumnIndex], 0, ByteSize);
+  }
+  Result->SharedValueIndices = PushArray(&EM->Arena, Archetype->SharedCount, u32);
+  for(u32 SharedIndex = 0; SharedIndex < Archetype->SharedCount; ++SharedIndex)
+  {
+    Result->SharedValueIndices[SharedIndex] = 0;
+  }
+  return Result;
+}
+
+component_signature GetPrefabComponentFlags(prefab* Prefab)
+{
+  component_signature Result = Prefab->Archetype->ComponentFlags;
+  return Result;
+}
+
+bptr GetPrefabComponentField(prefab* Prefab, component_signature ComponentFlag, u32 FieldIndex)
+{
+  archetype* Archetype = Prefab->Archetype;
+  u32 ComponentIndex = GetComponentIndex(ComponentFlag);
+  Assert(IsBitSet(Archetype->StoredFlags, ComponentIndex)); // Not in the prefab, or a tag or shared component
+  u32 ArrayIndex = GetComponentArrayIndex(ComponentIndex, Archetype->StoredFlags);
+  bptr Result = Prefab->ColumnValues[GetColumnIndex(Archetype, ArrayIndex, FieldIndex)];
+  return Result;
+}
+
+bptr GetPrefabComponent(prefab* Prefab, component_signature ComponentFlag)
+{
+  bptr Result = GetPrefabComponentField(Prefab, ComponentFlag, 0);
+  return Result;
+}
+
+void SetPrefabSharedComponent(entity_manager* EM, prefab* Prefab, component_signature ComponentFlag, u32 ValueIndex)
+{
+  component_list* ComponentList = GetSharedComponentList(EM, ComponentFlag);
+  Assert(ValueIndex < ComponentList->SharedValueCount);
+  archetype* Archetype = Prefab->Archetype;
+  u32 ComponentIndex = (u32) (ComponentList - EM->ComponentTypeVector);
+  Assert(IsBitSet(Archetype->SharedFlags, ComponentIndex));
+  Prefab->SharedValueIndices[GetSetBitCountBelow(Archetype->SharedFlags, ComponentIndex)] = ValueIndex;
+}
+
+void InstantiatePrefab(entity_manager* EM, prefab* Prefab, u32 Count, entity_id* OutIDs)
+{
+  AllocateArchetypeRows(EM, Prefab->Archetype, Count, OutIDs, Prefab->SharedValueIndices, Prefab->ColumnValues);
+}
+
+// Ids looked up together in TryGetComponents
+#define ECS_LOOKUP_BATCH_SIZE 16u
+
+internal inline void PrefetchEntitySlot(entity_manager* EM, entity_id* EntityID)
+{
+  if(EntityID->SlotIndex < EM->EntitySlotCount)
+  {
+    _mm_prefetch((const char*) GetEntitySlot(EM, EntityID->SlotIndex), _MM_HINT_T0);
+  }
+}
+
+internal u32 TryGetComponents(entity_manager* EM, u32 Count, entity_id* EntityIDs, component_signature ComponentFlag, bptr* OutComponents, b32 Write)
+{
+  u32 ComponentIndex = GetComponentIndex(ComponentFlag);
+  Assert(IsStoredAsStruct(EM->ComponentTypeVector + ComponentIndex));
+  u32 FoundCount = 0;
+  entity* Entities[ECS_LOOKUP_BATCH_SIZE];
+  for(u32 BatchStart = 0; BatchStart < Count; BatchStart += ECS_LOOKUP_BATCH_SIZE)
+  {
+    u32 BatchCount = Minimum(ECS_LOOKUP_BATCH_SIZE, Count - BatchStart);
+    entity_id* BatchIDs = EntityIDs + BatchStart;
+    // Three passes so the misses of a batch overlap: slots, then chunk headers, then components
+    for(u32 Index = 0; Index < BatchCount; ++Index)
+    {
+      PrefetchEntitySlot(EM, BatchIDs + Index);
+    }
+    for(u32 Index = 0; Index < BatchCount; ++Index)
+    {
+      entity* Entity = TryGetEntityFromID(EM, BatchIDs + Index);
+      Entities[Index] = Entity;
+      if(Entity && Entity->Chunk)
+      {
+        _mm_prefetch((const char*) Entity->Chunk, _MM_HINT_T0);
+      }
+    }
+    for(u32 Index = 0; Index < BatchCount; ++Index)
+    {
+      bptr Component = Entities[Index] ? GetComponent(EM, Entities[Index], ComponentIndex, 0, Write) : 0;
+      OutComponents[BatchStart + Index] = Component;
+      FoundCount += Component != 0;
+    }
+  }
+  return FoundCount;
+}
+
+u32 TryGetComponents(entity_manager* EM, u32 Count, entity_id* EntityIDs, component_signature ComponentFlag, bptr* OutComponents)
+{
+  u32 Result = TryGetComponents(EM, Count, EntityIDs, ComponentFlag, OutComponents, true);
+  return Result;
+}
+
+u32 TryGetReadOnlyComponents(entity_manager* EM, u32 Count, entity_id* EntityIDs, component_signature ComponentFlag, bptr* OutComponents)
+{
+  u32 Result = TryGetComponents(EM, Count, EntityIDs, ComponentFlag, OutComponents, false);
+  return Result;
+}
+
+u32 AreAlive(entity_manager* EM, u32 Count, entity_id* EntityIDs, b32* OutAlive)
+{
+  u32 AliveCount = 0;
+  for(u32 BatchStart = 0; BatchStart < Count; BatchStart += ECS_LOOKUP_BATCH_SIZE)
+  {
+    u32 BatchCount = Minimum(ECS_LOOKUP_BATCH_SIZE, Count - BatchStart);
+    for(u32 Index = 0; Index < BatchCount; ++Index)
+    {
+      PrefetchEntitySlot(EM, EntityIDs + BatchStart + Index);
+    }
+    for(u32 Index = 0; Index < BatchCount; ++Index)
+    {
+      b32 Alive = TryGetEntityFromID(EM, EntityIDs + BatchStart + Index) != 0;
+      if(OutAlive)
+      {
+        OutAlive[BatchStart + Index] = Alive;
+      }
+      AliveCount += Alive;
+    }
+  }
+  return AliveCount;
+}
+
+b32 HasComponents(entity_manager* EM, entity_id* EntityID, component_signature ComponentFlags)
+{
+  Assert( !IsEmpty(ComponentFlags) );
+  entity* Entity = GetEntityFromID(EM, EntityID);
+  Assert(Entity);
+  b32 Result = HasAll(GetEntityComponentFlags(Entity), ComponentFlags);
+  return Result;
+}
+
+b32 HasOneOfComponents(entity_manager* EM, entity_id* EntityID, component_signature ComponentFlags)
+{
+  Assert( !IsEmpty(ComponentFlags) );
+  entity* Entity = GetEntityFromID(EM, EntityID);
+  Assert(Entity);
+  b32 Result = HasAny(GetEntityComponentFlags(Entity), ComponentFlags);
+  return Result;
+}
+
+query* RegisterQuery(entity_manager* EM, component_signature ComponentFlags)
+{
+  Assert(!IsEmpty(ComponentFlags));
+  query* Result = EM->FirstQuery;
+  while(Result)
+  {
+    if(Result->ComponentFlags == ComponentFlags)
+    {
+      return Result;
+    }
+    Result = Result->Next;
+  }
+
+  Result = PushStruct(&EM->Arena, query);
+  Result->ComponentFlags = ComponentFlags;
+  Result->Next = EM->FirstQuery;
+  EM->FirstQuery = Result;
+
+  // Catch up on the archetypes created before the query was registered
+  chunk_list_iterator Iterator = BeginIterator(&EM->Archetypes);
+  while(archetype* Archetype = (archetype*) Next(&Iterator))
+  {
+    AddArchetypeIfMatching(EM, Result, Archetype);
+  }
+  return Result;
+}
+
+u32 GetEntityCount(query* Query)
+{
+  u32 Result = 0;
+  for(u32 ArchetypeIndex = 0; ArchetypeIndex < Query->ArchetypeCount; ++ArchetypeIndex)
+  {
+    Result += Query->Archetypes[ArchetypeIndex]->EntityCount;
+  }
+  return Result;
+}
+
+filtered_entity_iterator GetComponentsOfType(entity_manager* EM, query* Query)
+{
+  Assert(Query);
+  filtered_entity_iterator Result = {};
+  Result.EM = EM;
+  Result.Query = Query;
+  return Result;
+}
+
+filtered_entity_iterator GetChangedComponentsOfType(entity_manager* EM, query* Query, change_filter Filter)
+{
+  Assert(HasAll(Query->ComponentFlags, Filter.ComponentFlags));
+  filtered_entity_iterator Result = GetComponentsOfType(EM, Query);
+  Result.ChangeFilter = Filter;
+  return Result;
+}
+
+filtered_entity_iterator GetComponentsOfType(entity_manager* EM, component_signature ComponentFlagsToFilterOn)
+{
+  filtered_entity_iterator Result = GetComponentsOfType(EM, RegisterQuery(EM, ComponentFlagsToFilterOn));
+  return Result;
+};
+
+bptr GetComponent(entity_manager* EM, filtered_entity_iterator* EntityIterator, component_signature ComponentFlag)
+{
+  if(!EntityIterator->OnEntity)
+  {
+    return 0;
+  }
+  archetype_chunk* Chunk = EntityIterator->CurrentChunk;
+  u32 ComponentIndex = GetComponentIndex(ComponentFlag);
+  if(!IsBitSet(Chunk->Archetype->ComponentFlags, ComponentIndex))
+  {
+    return 0;
+  }
+  Assert(IsStoredAsStruct(EM->ComponentTypeVector + ComponentIndex));
+  u32 ArrayIndex = GetComponentArrayIndex(ComponentIndex, Chunk->Archetype->StoredFlags);
+  archetype_column Column = Chunk->Archetype->Columns[ArrayIndex];
+  bptr Result = ((bptr) Chunk) + Column.ByteOffset + EntityIterator->CurrentRow * Column.ByteSize;
+  GetChunkChangeVersions(Chunk)[ArrayIndex] = EM->ChangeVersion;
+  return Result;
+}
+
+b32 NextChunk(filtered_entity_iterator* EntityIterator)
+{
+  archetype_chunk* Chunk = EntityIterator->CurrentChunk ? EntityIterator->CurrentChunk->Next : 0;
+  query* Query = EntityIterator->Query;
+  b32 UseChangeFilter = !IsEmpty(EntityIterator->ChangeFilter.ComponentFlags);
+  for(;;)
+  {
+    while(!Chunk && EntityIterator->ArchetypeIndex < Query->ArchetypeCount)
+    {
+      archetype* Archetype = Query->Archetypes[EntityIterator->ArchetypeIndex++];
+      Assert(DoesArchetypeHoldAllComponents(Archetype, Query->ComponentFlags));
+      Chunk = Archetype->FirstChunk;
+    }
+    if(!Chunk || !UseChangeFilter || HasChunkChanged(Chunk, &EntityIterator->ChangeFilter))
+    {
+      break;
+    }
+    Chunk = Chunk->Next;
+  }
+
+  // Chunks are separate 16KB blocks, start loading the header and first entity ids of the next
+  // one while the caller works on this one
+  if(Chunk && Chunk->Next)
+  {
+    _mm_prefetch((const char*) Chunk->Next, _MM_HINT_T0);
+    _mm_prefetch(((const char*) Chunk->Next) + 64, _MM_HINT_T0);
+  }
+
+  EntityIterator->CurrentChunk = Chunk;
+  EntityIterator->CurrentRow = 0;
+  EntityIterator->OnEntity = false;
+  return Chunk != 0;
+}
+
+u32 GetChunkEntityCount(filtered_entity_iterator* EntityIterator)
+{
+  Assert(EntityIterator->CurrentChunk);
+  u32 Result = EntityIterator->CurrentChunk->EntityCount;
+  return Result;
+}
+
+entity_id const* GetChunkEntityIDs(filtered_entity_iterator* EntityIterator)
+{
+  Assert(EntityIterator->CurrentChunk);
+  entity_id const* Result = GetChunkEntityIDs(EntityIterator->CurrentChunk);
+  return Result;
+}
+
+internal bptr GetComponentArray(filtered_entity_iterator* EntityIterator, component_signature ComponentFlag, u32 FieldIndex, b32 Write)
+{
+  archetype_chunk* Chunk = EntityIterator->CurrentChunk;
+  Assert(Chunk);
+  u32 ComponentIndex = GetComponentIndex(ComponentFlag);
+  if(!IsBitSet(Chunk->Archetype->ComponentFlags, ComponentIndex))
+  {
+    return 0;
+  }
+  Assert(IsBitSet(Chunk->Archetype->StoredFlags, ComponentIndex));
+  u32 ArrayIndex = GetComponentArrayIndex(ComponentIndex, Chunk->Archetype->StoredFlags);
+  bptr Result = GetChunkComponentArray(Chunk, ArrayIndex, FieldIndex);
+  if(Write)
+  {
+    GetChunkChangeVersions(Chunk)[ArrayIndex] = EntityIterator->EM->ChangeVersion;
+  }
+  return Result;
+}
+
+bptr GetComponentArray(filtered_entity_iterator* EntityIterator, component_signature ComponentFlag)
+{
+  Assert(IsStoredAsStruct(EntityIterator->EM->ComponentTypeVector + GetComponentIndex(ComponentFlag))); // See GetComponentFieldArray
+  bptr Result = GetComponentArray(EntityIterator, ComponentFlag, 0, true);
+  return Result;
+}
+
+bptr GetReadOnlyComponentArray(filtered_entity_iterator* EntityIterator, component_signature ComponentFlag)
+{
+  Assert(IsStoredAsStruct(EntityIterator->EM->ComponentTypeVector + GetComponentIndex(ComponentFlag)));
+  bptr Result = GetComponentArray(EntityIterator, ComponentFlag, 0, false);
+  return Result;
+}
+
+internal bptr GetComponentInstances(filtered_entity_iterator* EntityIterator, component_signature ComponentFlag, u32 Row, u32* InstanceCount, b32 Write)
+{
+  entity_manager* EM = EntityIterator->EM;
+  u32 ComponentIndex = GetComponentIndex(ComponentFlag);
+  component_list* ComponentList = EM->ComponentTypeVector + ComponentIndex;
+  Assert(ComponentList->InstanceCapacity);
+  bptr Rows = GetComponentArray(EntityIterator, ComponentFlag, 0, Write);
+  if(!Rows)
+  {
+    *InstanceCount = 0;
+    return 0;
+  }
+  Assert(Row < EntityIterator->CurrentChunk->EntityCount);
+  component_instances* Instances = (component_instances*) (Rows + Row * ComponentList->ComponentByteSize);
+  *InstanceCount = Instances->Count;
+  bptr Result = GetFirstInstance(Instances);
+  return Result;
+}
+
+bptr GetComponentInstances(filtered_entity_iterator* EntityIterator, component_signature ComponentFlag, u32 Row, u32* InstanceCount)
+{
+  bptr Result = GetComponentInstances(EntityIterator, ComponentFlag, Row, InstanceCount, true);
+  return Result;
+}
+
+bptr GetReadOnlyComponentInstances(filtered_entity_iterator* EntityIterator, component_signature ComponentFlag, u32 Row, u32* InstanceCount)
+{
+  bptr Result = GetComponentInstances(EntityIterator, ComponentFlag, Row, InstanceCount, false);
+  return Result;
+}
+
+u32 GetSharedComponentIndex(filtered_entity_iterator* EntityIterator, component_signature ComponentFlag)
+{
+  Assert(EntityIterator->CurrentChunk);
+  u32 Result = GetSharedComponentIndex(EntityIterator->CurrentChunk, GetComponentIndex(ComponentFlag));
+  return Result;
+}
+
+bptr GetSharedComponent(filtered_entity_iterator* EntityIterator, component_signature ComponentFlag)
+{
+  u32 ValueIndex = GetSharedComponentIndex(EntityIterator, ComponentFlag);
+  bptr Result = ValueIndex != U32Max ? GetSharedComponentValue(EntityIterator->EM, ComponentFlag, ValueIndex) : 0;
+  return Result;
+}
+
+bptr GetComponentFieldArray(filtered_entity_iterator* EntityIterator, component_signature ComponentFlag, u32 FieldIndex)
+{
+  bptr Result = GetComponentArray(EntityIterator, ComponentFlag, FieldIndex, true);
+  return Result;
+}
+
+bptr GetReadOnlyComponentFieldArray(filtered_entity_iterator* EntityIterator, component_signature ComponentFlag, u32 FieldIndex)
+{
+  bptr Result = GetComponentArray(EntityIterator, ComponentFlag, FieldIndex, false);
+  return Result;
+}
+
+b32 HasChunkChanged(archetype_chunk* Chunk, change_filter* Filter)
+{
+  archetype* Archetype = Chunk->Archetype;
+  Assert(HasAll(Archetype->StoredFlags, Filter->ComponentFlags)); // Tags are never written, they can't be filtered on
+  u32* ChangeVersions = GetChunkChangeVersions(Chunk);
+  component_signature ComponentsToCheck = Filter->ComponentFlags;
+  u32 ComponentIndex = 0;
+  while(IndexOfLeastSignificantSetBit(ComponentsToCheck, &ComponentIndex))
+  {
+    u32 ArrayIndex = GetComponentArrayIndex(ComponentIndex, Archetype->StoredFlags);
+    if(ChangeVersions[ArrayIndex] > Filter->SinceVersion)
+    {
+      return true;
+    }
+    ComponentsToCheck = AndNot(ComponentsToCheck, ComponentFlagFromIndex(ComponentIndex));
+  }
+  return false;
+}
+
+u32 AdvanceChangeVersion(entity_manager* EM)
+{
+  u32 Result = EM->ChangeVersion++;
+  return Result;
+}
+
+b32 Next(filtered_entity_iterator* EntityIterator)
+{
+  if(EntityIterator->OnEntity)
+  {
+    EntityIterator->CurrentRow++;
+  }
+
+  while(!EntityIterator->CurrentChunk || EntityIterator->CurrentRow >= EntityIterator->CurrentChunk->EntityCount)
+  {
+    if(!NextChunk(EntityIterator))
+    {
+      return false;
+    }
+  }
+
+  EntityIterator->OnEntity = true;
+  return true;
+}
+
+entity_manager* CreateEntityManager(u32 EntityChunkCount, u32 ComponentCount, entity_manager_definition* DefinitionVector)
+{
+  Assert(ComponentCount <= ECS_MAX_COMPONENT_TYPES);
+  entity_manager* Result = BootstrapPushStruct(entity_manager, Arena);
+
+  Result->ComponentTypeCount = ComponentCount;
+  Result->ComponentTypeVector = PushArray(&Result->Arena, ComponentCount, component_list);
+  for(u32 idx = 0; idx < ComponentCount; idx++)
+  {
+    entity_manager_definition* Definition = DefinitionVector + idx;
+    component_list* ComponentList = Result->ComponentTypeVector + GetComponentIndex(Definition->ComponentFlag);
+    *ComponentList = CreateComponentList(Definition->ComponentFlag, Definition->RequirementsFlag, Definition->ComponentByteSize, Definition->ComponentChunkCount);
+    if(IsTag(ComponentList))
+    {
+      Assert(!Definition->FieldCount && !Definition->InstanceCapacity && !Definition->SharedValueCapacity);
+      Result->TagFlags = Result->TagFlags | Definition->ComponentFlag;
+    }
+    if(Definition->SharedValueCapacity)
+    {
+      Assert(!Definition->FieldCount && !Definition->InstanceCapacity);
+      ComponentList->SharedValueCapacity = Definition->SharedValueCapacity;
+      ComponentList->SharedValues = (bptr) PushSize(&Result->Arena, Definition->SharedValueCapacity * (midx) Definition->ComponentByteSize);
+      ComponentList->SharedValueCount = 1; // The zeroed value 0
+      Result->SharedFlags = Result->SharedFlags | Definition->ComponentFlag;
+    }
+    if(Definition->FieldCount)
+    {
+      ComponentList->FieldCount = Definition->FieldCount;
+      ComponentList->FieldByteSizes = PushArray(&Result->Arena, Definition->FieldCount, u32);
+      u32 FieldByteSizeSum = 0;
+      for(u32 FieldIndex = 0; FieldIndex < Definition->FieldCount; ++FieldIndex)
+      {
+        ComponentList->FieldByteSizes[FieldIndex] = Definition->FieldByteSizes[FieldIndex];
+        FieldByteSizeSum += Definition->FieldByteSizes[FieldIndex];
+      }
+      Assert(FieldByteSizeSum == Definition->ComponentByteSize);
+    }else{
+      ComponentList->FieldCount = 1;
+      ComponentList->FieldByteSizes = &ComponentList->ComponentByteSize;
+    }
+    if(Definition->InstanceCapacity)
+    {
+      Assert(!Definition->FieldCount); // Instances can't be split into fields
+      ComponentList->InstanceCapacity = Definition->InstanceCapacity;
+      ComponentList->InstanceByteSize = Definition->ComponentByteSize;
+      // Rows are padded so the instances of every row are as aligned as the first
+      midx RowByteSize = ECS_COMPONENT_INSTANCES_HEADER_SIZE + Definition->InstanceCapacity * Definition->ComponentByteSize;
+      ComponentList->ComponentByteSize = (u32) GetAlignedOffset(RowByteSize, ECS_COMPONENT_ALIGNMENT);
+    }
+  }
+
+  Assert(EntityChunkCount > 0);
+  while((1u << Result->EntitySlotPageSizeLog2) < EntityChunkCount)
+  {
+    Result->EntitySlotPageSizeLog2++;
+  }
+  Result->FirstFreeEntitySlot = U32Max;
+  Result->ChangeVersion = 1;
+  Result->Archetypes = NewChunkList(&Result->Arena, sizeof(archetype), 32);
+
+#if HANDMADE_SLOW
+  for(s32 i = 0; i<ComponentCount; i++)
+  {
+    Assert(!IsEmpty(Result->ComponentTypeVector[i].Type));
+  }
+#endif
+
+  ComputeRequirementClosures(Result);
+
+  return Result;
+}
+
+u32 GetEntityCountHoldingTypes(entity_manager* EM, component_signature ComponentFlags)
+{
+  Assert(!IsEmpty(ComponentFlags));
+  u32 Result = GetEntityCount(RegisterQuery(EM, ComponentFlags));
+  return Result;
+}
+
+entity_id GetEntityIDFromComponent( bptr Component )
+{
+  // Chunks are aligned to ECS_ARCHETYPE_CHUNK_BYTE_SIZE so rounding down gives us the chunk
+  archetype_chunk* Chunk = (archetype_chunk*) (((midx) Component) & ~((midx) ECS_ARCHETYPE_CHUNK_BYTE_SIZE - 1));
+  archetype* Archetype = Chunk->Archetype;
+  Assert(Archetype);
+
+  // Columns are laid out in increasing order so the last column starting before the component holds it
+  u32 ComponentOffset = (u32) (Component - (bptr) Chunk);
+  u32 ColumnIndex = Archetype->ColumnCount - 1;
+  while(Archetype->Columns[ColumnIndex].ByteOffset > ComponentOffset)
+  {
+    Assert(ColumnIndex > 0);
+    ColumnIndex--;
+  }
+  u32 Row = (ComponentOffset - Archetype->Columns[ColumnIndex].ByteOffset) / Archetype->Columns[ColumnIndex].ByteSize;
+  Assert(Row < Chunk->EntityCount);
+  return GetChunkEntityIDs(Chunk)[Row];
+}
+
+entity_id GetEntityID( filtered_entity_iterator* Iterator )
+{
+  Assert(Iterator->OnEntity);
+  entity_id Result = GetChunkEntityIDs(Iterator->CurrentChunk)[Iterator->CurrentRow];
+  return Result;
+}
+
+// Copies the ids of all entities in Query to ResultVector chunk by chunk, returns the number copied
+internal u32 CopyEntityIDs(query* Query, entity_id* ResultVector)
+{
+  u32 Result = 0;
+  for(u32 ArchetypeIndex = 0; ArchetypeIndex < Query->ArchetypeCount; ++ArchetypeIndex)
+  {
+    for(archetype_chunk* Chunk = Query->Archetypes[ArchetypeIndex]->FirstChunk; Chunk; Chunk = Chunk->Next)
+    {
+      utils::Copy(Chunk->EntityCount * sizeof(entity_id), GetChunkEntityIDs(Chunk), ResultVector + Result);
+      Result += Chunk->EntityCount;
+    }
+  }
+  return Result;
+}
+
+// Result must point to an array of entity_id long enough to hold all entities holding ComponentFlags
+void GetEntitiesHoldingTypes(entity_manager* EM, component_signature ComponentFlags, entity_id* ResultVector)
+{
+  Assert(!IsEmpty(ComponentFlags));
+  CopyEntityIDs(RegisterQuery(EM, ComponentFlags), ResultVector);
+}
+
+entity_id_span GetEntitiesHoldingTypes(entity_manager* EM, component_signature ComponentFlags, memory_arena* Arena)
+{
+  Assert(!IsEmpty(ComponentFlags));
+  query* Query = RegisterQuery(EM, ComponentFlags);
+  u32 EntityCount = GetEntityCount(Query);
+  entity_id_span Result = {};
+  Result.EntityIDs = PushArray(Arena, EntityCount, entity_id);
+  Result.Count = CopyEntityIDs(Query, Result.EntityIDs);
+  Assert(Result.Count == EntityCount);
+  return Result;
+}
+
+internal inline component_list* GetComponentList(entity_manager* EM, component_signature ComponentFlag)
+{
+  u32 ComponentListIndex = GetComponentIndex(ComponentFlag);
+  component_list* ComponentList = EM->ComponentTypeVector + ComponentListIndex;
+  return ComponentList;
+}
+
+// ComponentFlag and all components in EntityFlags that directly or indirectly require it
+component_signature GetCascadedRequirements(entity_manager* EM, component_signature EntityFlags, component_signature ComponentFlag)
+{
+  // Entities always hold the requirements of their components, so masking the closure
+  // with EntityFlags gives exactly the components that would be left without a requirement.
+  component_signature RequiredBy = {};
+  component_signature ComponentsToCheck = ComponentFlag;
+  u32 ComponentIndex = 0;
+  while(IndexOfLeastSignificantSetBit(ComponentsToCheck, &ComponentIndex))
+  {
+    Assert(ComponentIndex < EM->ComponentTypeCount);
+    component_list* ComponentList = EM->ComponentTypeVector + ComponentIndex;
+    RequiredBy = RequiredBy | ComponentList->RequiredBy;
+    ComponentsToCheck = AndNot(ComponentsToCheck, ComponentList->Type);
+  }
+  component_signature TotalRequirements = ComponentFlag | (RequiredBy & EntityFlags);
+  return TotalRequirements;
+}
+
+component_signature GetCascadedRequirements(entity_manager* EM, entity* Entity, component_signature ComponentFlag)
+{
+  component_signature EntityFlags = GetEntityComponentFlags(Entity);
+  component_signature TotalRequirements = GetCascadedRequirements(EM, EntityFlags, ComponentFlag);
+  Assert(HasAll(EntityFlags, TotalRequirements));
+  return TotalRequirements;
+}
+
+void DeleteComponents(entity_manager* EM, entity_id* EntityID, component_signature ComponentFlag)
+{
+  entity* Entity = GetEntityFromID(EM, EntityID);
+
+  Assert(Entity->Chunk); // For now we cannot delete components in entities with no components. Can be handled if needed.
+
+  component_signature TotalRequirements = GetCascadedRequirements(EM, Entity, ComponentFlag);
+  component_signature NewComponentFlags = AndNot(GetEntityComponentFlags(Entity), TotalRequirements);
+
+  MoveEntityToArchetype(EM, Entity, NewComponentFlags);
+
+  // Makes sure that if we have 0 components left, we are not stored in any chunk
+  // Or if we have components left we are stored in the chunk of our archetype
+  Assert((IsEmpty(NewComponentFlags) && Entity->Chunk == 0) ||
+         (!IsEmpty(NewComponentFlags) && Entity->Chunk->Archetype->ComponentFlags == NewComponentFlags))
+}
+
+fragmentation_stats GetFragmentation(entity_manager* EM)
+{
+  fragmentation_stats Result = {};
+  chunk_list_iterator Iterator = BeginIterator(&EM->Archetypes);
+  while(archetype* Archetype = (archetype*) Next(&Iterator))
+  {
+    Result.ChunkCount += Archetype->ChunkCount;
+    Result.MinimumChunkCount += (Archetype->EntityCount + Archetype->ChunkCapacity - 1) / Archetype->ChunkCapacity;
+    Result.EntityRowCount += Archetype->EntityCount;
+    Result.RowCapacity += Archetype->ChunkCount * Archetype->ChunkCapacity;
+  }
+  Result.FreeChunkCount = EM->FreeChunkCount;
+  return Result;
+}
+
+memory_stats GetMemoryStats(entity_manager* EM, component_memory_stats* ComponentStats)
+{
+  memory_stats Result = {};
+  if(ComponentStats)
+  {
+    memset(ComponentStats, 0, EM->ComponentTypeCount * sizeof(component_memory_stats));
+  }
+
+  u32 SlotsPerPage = 1 << EM->EntitySlotPageSizeLog2;
+  Result.EntityCount = EM->EntityCount;
+  Result.EntitySlotCount = EM->EntitySlotCount;
+  Result.EntitySlotCapacity = EM->EntitySlotPageCount * SlotsPerPage;
+  Result.EntitySlotBytes = Result.EntitySlotCapacity * sizeof(entity) + EM->EntitySlotPageCapacity * sizeof(entity*);
+
+  u32 RowCount = 0;
+  u32 RowCapacity = 0;
+  chunk_list_iterator Iterator = BeginIterator(&EM->Archetypes);
+  while(archetype* Archetype = (archetype*) Next(&Iterator))
+  {
+    u32 ArchetypeRowCapacity = Archetype->ChunkCount * Archetype->ChunkCapacity;
+    u32 FreeRowCount = ArchetypeRowCapacity - Archetype->EntityCount;
+    Result.ArchetypeCount++;
+    Result.ChunkCount += Archetype->ChunkCount;
+    Result.EntityRowBytes += ArchetypeRowCapacity * sizeof(entity_id);
+    RowCount += Archetype->EntityCount;
+    RowCapacity += ArchetypeRowCapacity;
+
+    component_signature ComponentFlags = Archetype->ComponentFlags;
+    u32 ComponentIndex = 0;
+    while(IndexOfLeastSignificantSetBit(ComponentFlags, &ComponentIndex))
+    {
+      u32 ByteSize = IsBitSet(Archetype->StoredFlags, ComponentIndex) ? EM->ComponentTypeVector[ComponentIndex].ComponentByteSize : 0;
+      Result.ComponentBytesUsed += Archetype->EntityCount * (midx) ByteSize;
+      Result.ComponentBytesWasted += FreeRowCount * (midx) ByteSize;
+      if(ComponentStats)
+      {
+        component_memory_stats* Stats = ComponentStats + ComponentIndex;
+        Stats->EntityCount += Archetype->EntityCount;
+        Stats->RowCapacity += ArchetypeRowCapacity;
+        Stats->ChunkCount += Archetype->ChunkCount;
+        Stats->ArchetypeCount++;
+        Stats->BytesUsed += Archetype->EntityCount * (midx) ByteSize;
+        Stats->BytesWasted += FreeRowCount * (midx) ByteSize;
+      }
+      ComponentFlags = AndNot(ComponentFlags, ComponentFlagFromIndex(ComponentIndex));
+    }
+  }
+
+  Result.FreeChunkCount = EM->FreeChunkCount;
+  Result.ChunkBytes = Result.ChunkCount * (midx) ECS_ARCHETYPE_CHUNK_BYTE_SIZE;
+  Result.FreeChunkBytes = Result.FreeChunkCount * (midx) ECS_ARCHETYPE_CHUNK_BYTE_SIZE;
+  Result.ChunkOverheadBytes = Result.ChunkBytes - Result.ComponentBytesUsed - Result.ComponentBytesWasted - Result.EntityRowBytes;
+  Result.AverageChunkFill = RowCapacity ? RowCount / (r32) RowCapacity : 0;
+  if(ComponentStats)
+  {
+    for(u32 ComponentIndex = 0; ComponentIndex < EM->ComponentTypeCount; ++ComponentIndex)
+    {
+      component_memory_stats* Stats = ComponentStats + ComponentIndex;
+      Stats->AverageChunkFill = Stats->RowCapacity ? Stats->EntityCount / (r32) Stats->RowCapacity : 0;
+    }
+  }
+  return Result;
+}
+
+void PrintMemoryReport(entity_manager* EM)
+{
+  temporary_memory TempMem = BeginTemporaryMemory(GlobalTransientArena);
+  component_memory_stats* ComponentStats = PushArray(GlobalTransientArena, EM->ComponentTypeCount, component_memory_stats);
+  memory_stats Stats = GetMemoryStats(EM, ComponentStats);
+
+  r64 KB = 1.0 / 1024.0;
+  Platform.DEBUGPrint("Entity manager memory\n");
+  Platform.DEBUGPrint("  Entities: %u live, %u slots, %u slot capacity in pages of %u (%.1f KB)\n",
+    Stats.EntityCount, Stats.EntitySlotCount, Stats.EntitySlotCapacity, 1u << EM->EntitySlotPageSizeLog2, Stats.EntitySlotBytes * KB);
+  Platform.DEBUGPrint("  Chunks: %u in %u archetypes, %u free, %.1f%% full (%.1f KB, %.1f KB free)\n",
+    Stats.ChunkCount, Stats.ArchetypeCount, Stats.FreeChunkCount, 100.0 * Stats.AverageChunkFill, Stats.ChunkBytes * KB, Stats.FreeChunkBytes * KB);
+  Platform.DEBUGPrint("  Chunk bytes: %.1f KB components, %.1f KB free rows, %.1f KB entity ids, %.1f KB headers and padding\n",
+    Stats.ComponentBytesUsed * KB, Stats.ComponentBytesWasted * KB, Stats.EntityRowBytes * KB, Stats.ChunkOverheadBytes * KB);
+  Platform.DEBUGPrint("  %-6s %10s %10s %8s %8s %12s %12s\n", "Type", "Entities", "Rows", "Chunks", "Fill", "KB used", "KB wasted");
+  for(u32 ComponentIndex = 0; ComponentIndex < EM->ComponentTypeCount; ++ComponentIndex)
+  {
+    component_memory_stats* Component = ComponentStats + ComponentIndex;
+    Platform.DEBUGPrint("  %-6u %10u %10u %8u %7.1f%% %12.1f %12.1f\n", ComponentIndex, Component->EntityCount, Component->RowCapacity,
+      Component->ChunkCount, 100.0 * Component->AverageChunkFill, Component->BytesUsed * KB, Component->BytesWasted * KB);
+  }
+  EndTemporaryMemory(TempMem);
+}
+
+// Moves the last RowCount rows of Source to the end of Destination, one copy per component array
+internal void MoveArchetypeRows(entity_manager* EM, archetype_chunk* Source, archetype_chunk* Destination, u32 RowCount)
+{
+  archetype* Archetype = Source->Archetype;
+  Assert(Destination->Archetype == Archetype);
+  Assert(HasSharedValues(Destination, GetChunkSharedValueIndices(Source)));
+  Assert(RowCount <= Source->EntityCount);
+  Assert(Destination->EntityCount + RowCount <= Archetype->ChunkCapacity);
+
+  u32 SourceRow = Source->EntityCount - RowCount;
+  u32 DestinationRow = Destination->EntityCount;
+  for(u32 ColumnIndex = 0; ColumnIndex < Archetype->ColumnCount; ++ColumnIndex)
+  {
+    u32 ByteSize = Archetype->Columns[ColumnIndex].ByteSize;
+    utils::Copy(RowCount * ByteSize,
+                GetChunkColumn(Source, ColumnIndex) + SourceRow * ByteSize,
+                GetChunkColumn(Destination, ColumnIndex) + DestinationRow * ByteSize);
+  }
+
+  entity_id* SourceEntityIDs = GetChunkEntityIDs(Source);
+  entity_id* DestinationEntityIDs = GetChunkEntityIDs(Destination);
+  for(u32 Index = 0; Index < RowCount; ++Index)
+  {
+    entity_id EntityID = SourceEntityIDs[SourceRow + Index];
+    entity* Entity = GetEntitySlot(EM, EntityID.SlotIndex);
+    Entity->Chunk = Destination;
+    Entity->Row = DestinationRow + Index;
+    DestinationEntityIDs[DestinationRow + Index] = EntityID;
+  }
+
+  // Source was not full since it is in the with-space list, so its links stay as they are
+  Assert(Source->EntityCount < Archetype->ChunkCapacity);
+  Source->EntityCount -= RowCount;
+  Destination->EntityCount += RowCount;
+  MarkChunkChanged(EM, Destination);
+  if(Destination->EntityCount == Archetype->ChunkCapacity)
+  {
+    UnlinkChunkWithSpace(Archetype, Destination);
+  }
+  if(Source->EntityCount == 0)
+  {
+    FreeChunk(EM, Source);
+  }
+}
+
+// Finds the fullest and the emptiest of the chunks with space using the same shared values as the first
+// such chunk that has a partner. Returns false if the archetype is packed: no two chunks with space use
+// the same shared values. Without shared components that is at most one chunk with space.
+internal b32 GetChunksToCompact(archetype* Archetype, archetype_chunk** OutFullest, archetype_chunk** OutEmptiest)
+{
+  for(archetype_chunk* First = Archetype->FirstChunkWithSpace; First; First = First->NextWithSpace)
+  {
+    // Fill the fullest chunk with the rows of the emptiest, which frees chunks the fastest
+    archetype_chunk* Fullest = First;
+    archetype_chunk* Emptiest = First;
+    u32* SharedValueIndices = GetChunkSharedValueIndices(First);
+    for(archetype_chunk* Chunk = First->NextWithSpace; Chunk; Chunk = Chunk->NextWithSpace)
+    {
+      if(!HasSharedValues(Chunk, SharedValueIndices))
+      {
+        continue;
+      }
+      if(Chunk->EntityCount > Fullest->EntityCount)
+      {
+        Fullest = Chunk;
+      }
+      if(Chunk->EntityCount <= Emptiest->EntityCount)
+      {
+        Emptiest = Chunk;
+      }
+    }
+    // Ties pick the first fullest and the last emptiest chunk, so they only match if First is alone
+    if(Fullest != Emptiest)
+    {
+      *OutFullest = Fullest;
+      *OutEmptiest = Emptiest;
+      return true;
+    }
+  }
+  return false;
+}
+
+compaction_result CompactChunks(entity_manager* EM, midx ByteBudget)
+{
+  compaction_result Result = {};
+  Result.Before = GetFragmentation(EM);
+  Result.Done = true;
+
+  chunk_list_iterator Iterator = BeginIterator(&EM->Archetypes);
+  while(archetype* Archetype = (archetype*) Next(&Iterator))
+  {
+    midx RowByteSize = 0;
+    for(u32 ColumnIndex = 0; ColumnIndex < Archetype->ColumnCount; ++ColumnIndex)
+    {
+      RowByteSize += Archetype->Columns[ColumnIndex].ByteSize;
+    }
+    RowByteSize = Maximum(RowByteSize, (midx) 1);
+
+    archetype_chunk* Fullest = 0;
+    archetype_chunk* Emptiest = 0;
+    while(GetChunksToCompact(Archetype, &Fullest, &Emptiest))
+    {
+      u32 BudgetRowCount = (u32) Minimum((ByteBudget - Result.BytesMoved) / RowByteSize, (midx) U32Max);
+      u32 RowCount = Minimum(Emptiest->EntityCount, Archetype->ChunkCapacity - Fullest->EntityCount);
+      RowCount = Minimum(RowCount, BudgetRowCount);
+      if(RowCount == 0)
+      {
+        Result.Done = false;
+        break;
+      }
+
+      b32 ReleasesChunk = RowCount == Emptiest->EntityCount;
+      MoveArchetypeRows(EM, Emptiest, Fullest, RowCount);
+      Result.BytesMoved += RowCount * RowByteSize;
+      Result.EntitiesMoved += RowCount;
+      Result.ChunksReleased += ReleasesChunk ? 1 : 0;
+    }
+    if(!Result.Done)
+    {
+      break;
+    }
+  }
+
+  Result.After = GetFragmentation(EM);
+  return Result;
+}
+
+// Removes the DeletedCount rows of each chunk whose entity id has been cleared. Each chunk is compacted
+// once, rows from the end are moved into the holes. Emptied chunks go back to the free pool.
+internal void RemoveClearedRows(entity_manager* EM, u32 ChunkCount, archetype_chunk** Chunks)
+{
+  for(u32 ChunkIndex = 0; ChunkIndex < ChunkCount; ++ChunkIndex)
+  {
+    archetype_chunk* Chunk = Chunks[ChunkIndex];
+    archetype* Archetype = Chunk->Archetype;
+    entity_id* ChunkEntityIDs = GetChunkEntityIDs(Chunk);
+    u32 NewEntityCount = Chunk->EntityCount - Chunk->DeletedCount;
+    if(NewEntityCount)
+    {
+      u32 LastRow = Chunk->EntityCount - 1;
+      for(u32 Row = 0; Row < NewEntityCount; ++Row)
+      {
+        if(ChunkEntityIDs[Row].Generation)
+        {
+          continue;
+        }
+        while(!ChunkEntityIDs[LastRow].Generation)
+        {
+          LastRow--;
+        }
+        Assert(LastRow > Row);
+        for(u32 ColumnIndex = 0; ColumnIndex < Archetype->ColumnCount; ++ColumnIndex)
+        {
+          u32 ByteSize = Archetype->Columns[ColumnIndex].ByteSize;
+          bptr Column = GetChunkColumn(Chunk, ColumnIndex);
+          utils::Copy(ByteSize, Column + LastRow * ByteSize, Column + Row * ByteSize);
+        }
+        ChunkEntityIDs[Row] = ChunkEntityIDs[LastRow];
+        GetEntitySlot(EM, ChunkEntityIDs[Row].SlotIndex)->Row = Row;
+        ChunkEntityIDs[LastRow] = {};
+        MarkChunkChanged(EM, Chunk);
+      }
+    }
+
+    if(Chunk->EntityCount == Archetype->ChunkCapacity)
+    {
+      LinkChunkWithSpace(Archetype, Chunk);
+    }
+    Archetype->EntityCount -= Chunk->DeletedCount;
+    Chunk->EntityCount = NewEntityCount;
+    Chunk->DeletedCount = 0;
+    if(NewEntityCount == 0)
+    {
+      FreeChunk(EM, Chunk);
+    }
+  }
+}
+
+void DeleteEntities(entity_manager* EM, u32 Count, entity_id* EntityID)
+{
+  temporary_memory TempMem = BeginTemporaryMemory(GlobalTransientArena);
+  entity** Entities = PushArray(GlobalTransientArena, Count, entity*);
+  archetype_chunk** Chunks = PushArray(GlobalTransientArena, Count, archetype_chunk*);
+  u32 ChunkCount = 0;
+
+  // Mark the rows to delete by clearing their entity id (Generation 0 is never live) and collect
+  // the chunks they are in
+  for(u32 Index = 0; Index < Count; ++Index)
+  {
+    entity* Entity = GetEntityFromID(EM, EntityID + Index);
+    Entities[Index] = Entity;
+    archetype_chunk* Chunk = Entity->Chunk;
+    if(Chunk)
+    {
+      entity_id* ChunkEntityIDs = GetChunkEntityIDs(Chunk);
+      Assert(ChunkEntityIDs[Entity->Row].Generation); // The same entity is listed twice
+      ChunkEntityIDs[Entity->Row] = {};
+      if(Chunk->DeletedCount++ == 0)
+      {
+        Chunks[ChunkCount++] = Chunk;
+      }
+    }
+  }
+
+  RemoveClearedRows(EM, ChunkCount, Chunks);
+
+  for(u32 Index = 0; Index < Count; ++Index)
+  {
+    FreeEntitySlot(EM, Entities[Index]);
+  }
+  EndTemporaryMemory(TempMem);
+}
+
+void DeleteEntity(entity_manager* EM, entity_id* EntityID)
+{
+  entity* Entity = GetEntityFromID(EM, EntityID);
+  if(Entity->Chunk)
+  {
+    RemoveArchetypeRow(EM, Entity->Chunk, Entity->Row);
+  }
+
+  FreeEntitySlot(EM, Entity);
+}
+
+
+// Entity managers created from the same definitions lay out their chunks the same way
+internal b32 HaveSameComponentTypes(entity_manager* A, entity_manager* B)
+{
+  if(A->ComponentTypeCount != B->ComponentTypeCount)
+  {
+    return false;
+  }
+  for(u32 ComponentIndex = 0; ComponentIndex < A->ComponentTypeCount; ++ComponentIndex)
+  {
+    component_list* ListA = A->ComponentTypeVector + ComponentIndex;
+    component_list* ListB = B->ComponentTypeVector + ComponentIndex;
+    if(ListA->Type != ListB->Type ||
+       ListA->TotalRequirements != ListB->TotalRequirements ||
+       ListA->ComponentByteSize != ListB->ComponentByteSize ||
+       ListA->FieldCount != ListB->FieldCount ||
+       ListA->InstanceCapacity != ListB->InstanceCapacity ||
+       ListA->SharedValueCapacity != ListB->SharedValueCapacity)
+    {
+      return false;
+    }
+    for(u32 FieldIndex = 0; FieldIndex < ListA->FieldCount; ++FieldIndex)
+    {
+      if(ListA->FieldByteSizes[FieldIndex] != ListB->FieldByteSizes[FieldIndex])
+      {
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+// Indices in Destination of the shared values used by Chunk of Source, values missing in Destination are added.
+// Returns false if Destination has no room for one of them, its index is U32Max.
+internal b32 GetSharedValueIndicesIn(entity_manager* Source, entity_manager* Destination, archetype_chunk* Chunk, u32* Result)
+{
+  b32 AllAdded = true;
+  u32* SourceIndices = GetChunkSharedValueIndices(Chunk);
+  component_signature SharedFlags = Chunk->Archetype->SharedFlags;
+  u32 SharedIndex = 0;
+  u32 ComponentIndex = 0;
+  while(IndexOfLeastSignificantSetBit(SharedFlags, &ComponentIndex))
+  {
+    component_signature ComponentFlag = ComponentFlagFromIndex(ComponentIndex);
+    bptr Value = GetSharedComponentValue(Source, ComponentFlag, SourceIndices[SharedIndex]);
+    Result[SharedIndex] = AddSharedComponentValue(Destination, ComponentFlag, Value);
+    AllAdded = AllAdded && Result[SharedIndex] != U32Max;
+    SharedIndex++;
+    SharedFlags = AndNot(SharedFlags, ComponentFlag);
+  }
+  return AllAdded;
+}
+
+// Copies a chunk of Source whose entities all move into a new chunk of Destination. Both managers lay out
+// their chunks the same way so the rows are copied as one block. The rows get new entity slots in Destination,
+// their ids are also written over the old ones in Chunk so MoveEntities can look them up before freeing it.
+internal void CopyWholeChunk(entity_manager* Source, entity_manager* Destination, archetype_chunk* Chunk)
+{
+  archetype* SourceArchetype = Chunk->Archetype;
+  archetype* DestinationArchetype = GetOrCreateArchetype(Destination, SourceArchetype->ComponentFlags);
+  Assert(DestinationArchetype->ChunkCapacity == SourceArchetype->ChunkCapacity);
+  Assert(DestinationArchetype->EntitiesByteOffset == SourceArchetype->EntitiesByteOffset);
+  u32 SharedValueIndices[ECS_MAX_COMPONENT_TYPES];
+  GetSharedValueIndicesIn(Source, Destination, Chunk, SharedValueIndices);
+
+  archetype_chunk* NewChunk = AllocateChunk(Destination, DestinationArchetype, SharedValueIndices);
+  u32 RowsByteOffset = SourceArchetype->EntitiesByteOffset;
+  utils::Copy(ECS_ARCHETYPE_CHUNK_BYTE_SIZE - RowsByteOffset, ((bptr) Chunk) + RowsByteOffset, ((bptr) NewChunk) + RowsByteOffset);
+  NewChunk->EntityCount = Chunk->EntityCount;
+  if(NewChunk->EntityCount == DestinationArchetype->ChunkCapacity)
+  {
+    UnlinkChunkWithSpace(DestinationArchetype, NewChunk);
+  }
+  DestinationArchetype->EntityCount += NewChunk->EntityCount;
+
+  entity_id* OldEntityIDs = GetChunkEntityIDs(Chunk);
+  entity_id* NewEntityIDs = GetChunkEntityIDs(NewChunk);
+  for(u32 Row = 0; Row < NewChunk->EntityCount; ++Row)
+  {
+    entity* Entity = AllocateEntitySlot(Destination);
+    Entity->Chunk = NewChunk;
+    Entity->Row = Row;
+    NewEntityIDs[Row] = Entity->ID;
+    OldEntityIDs[Row] = Entity->ID;
+  }
+  MarkChunkChanged(Destination, NewChunk);
+}
+
+b32 MoveEntities(entity_manager* Source, entity_manager* Destination, u32 Count, entity_id* EntityIDs, entity_id* OutIDs)
+{
+  Assert(Source != Destination);
+  if(!HaveSameComponentTypes(Source, Destination))
+  {
+    return false;
+  }
+  temporary_memory TempMem = BeginTemporaryMemory(GlobalTransientArena);
+  entity** Entities = PushArray(GlobalTransientArena, Count, entity*);
+  entity_id* NewIDs = PushArray(GlobalTransientArena, Count, entity_id);
+  archetype_chunk** Chunks = PushArray(GlobalTransientArena, Count, archetype_chunk*);
+  u32 ChunkCount = 0;
+
+  // Count the rows leaving each chunk
+  for(u32 Index = 0; Index < Count; ++Index)
+  {
+    entity* Entity = GetEntityFromID(Source, EntityIDs + Index);
+    Entities[Index] = Entity;
+    archetype_chunk* Chunk = Entity->Chunk;
+    if(Chunk && Chunk->DeletedCount++ == 0)
+    {
+      Chunks[ChunkCount++] = Chunk;
+    }
+  }
+
+  // All shared values are added up front, nothing is moved if Destination has no room for them
+  u32 SharedValueIndices[ECS_MAX_COMPONENT_TYPES];
+  for(u32 ChunkIndex = 0; ChunkIndex < ChunkCount; ++ChunkIndex)
+  {
+    if(!GetSharedValueIndicesIn(Source, Destination, Chunks[ChunkIndex], SharedValueIndices))
+    {
+      for(u32 ResetIndex = 0; ResetIndex < ChunkCount; ++ResetIndex)
+      {
+        Chunks[ResetIndex]->DeletedCount = 0;
+      }
+      EndTemporaryMemory(TempMem);
+      return false;
+    }
+  }
+
+  // Chunks leaving as a whole are copied in one go
+  for(u32 ChunkIndex = 0; ChunkIndex < ChunkCount; ++ChunkIndex)
+  {
+    archetype_chunk* Chunk = Chunks[ChunkIndex];
+    Assert(Chunk->DeletedCount <= Chunk->EntityCount); // The same entity is listed twice
+    if(Chunk->DeletedCount == Chunk->EntityCount)
+    {
+      CopyWholeChunk(Source, Destination, Chunk);
+    }
+  }
+
+  // The rest are copied row by row. All source rows are cleared and removed below, the chunks of Source
+  // go back to its own free chunks.
+  archetype_chunk* SharedValuesChunk = 0;
+  for(u32 Index = 0; Index < Count; ++Index)
+  {
+    entity* Entity = Entities[Index];
+    archetype_chunk* Chunk = Entity->Chunk;
+    if(!Chunk)
+    {
+      NewIDs[Index] = AllocateEntitySlot(Destination)->ID;
+      continue;
+    }
+    if(Chunk->DeletedCount == Chunk->EntityCount)
+    {
+      // Copied as a whole, the row holds the new id
+      NewIDs[Index] = GetChunkEntityIDs(Chunk)[Entity->Row];
+      GetChunkEntityIDs(Chunk)[Entity->Row] = {};
+      continue;
+    }
+
+    archetype* SourceArchetype = Chunk->Archetype;
+    archetype* DestinationArchetype = GetOrCreateArchetype(Destination, SourceArchetype->ComponentFlags);
+    if(Chunk != SharedValuesChunk)
+    {
+      GetSharedValueIndicesIn(Source, Destination, Chunk, SharedValueIndices);
+      SharedValuesChunk = Chunk;
+    }
+    Assert(GetChunkEntityIDs(Chunk)[Entity->Row].Generation); // The same entity is listed twice
+    entity* DestinationEntity = AllocateEntitySlot(Destination);
+    AllocateArchetypeRow(Destination, DestinationArchetype, DestinationEntity, SharedValueIndices);
+    for(u32 ColumnIndex = 0; ColumnIndex < SourceArchetype->ColumnCount; ++ColumnIndex)
+    {
+      u32 ByteSize = SourceArchetype->Columns[ColumnIndex].ByteSize;
+      utils::Copy(ByteSize, GetChunkColumn(Chunk, ColumnIndex) + Entity->Row * ByteSize,
+                  GetChunkColumn(DestinationEntity->Chunk, ColumnIndex) + DestinationEntity->Row * ByteSize);
+    }
+    GetChunkEntityIDs(Chunk)[Entity->Row] = {};
+    NewIDs[Index] = DestinationEntity->ID;
+  }
+  RemoveClearedRows(Source, ChunkCount, Chunks);
+
+  for(u32 Index = 0; Index < Count; ++Index)
+  {
+    FreeEntitySlot(Source, Entities[Index]);
+  }
+  if(OutIDs)
+  {
+    utils::Copy(Count * sizeof(entity_id), NewIDs, OutIDs);
+  }
+  EndTemporaryMemory(TempMem);
+  return true;
+}
+
+void ClearEntityManager(entity_manager* EM)
+{
+  chunk_list_iterator Iterator = BeginIterator(&EM->Archetypes);
+  while(archetype* Archetype = (archetype*) Next(&Iterator))
+  {
+    while(archetype_chunk* Chunk = Archetype->FirstChunk)
+    {
+      if(Chunk->EntityCount == Archetype->ChunkCapacity)
+      {
+        LinkChunkWithSpace(Archetype, Chunk);
+      }
+      Chunk->EntityCount = 0;
+      FreeChunk(EM, Chunk);
+    }
+    Archetype->EntityCount = 0;
+  }
+
+  // Every slot goes back to the free list, lowest first. Freeing bumps the generation of each slot
+  // so all handles into EM go stale, including those of slots that were already free.
+  EM->FirstFreeEntitySlot = U32Max;
+  EM->EntityCount = EM->EntitySlotCount;
+  for(u32 SlotIndex = EM->EntitySlotCount; SlotIndex > 0; --SlotIndex)
+  {
+    FreeEntitySlot(EM, GetEntitySlot(EM, SlotIndex - 1));
+  }
+  Assert(EM->EntityCount == 0);
+}
+
+}
@@ -1,103 +1,370 @@
 #pragma once
 #include "commons/types.h"
 #include "containers/chunk_list.h"
+#include "component_signature.h"
 
 namespace ecs{
 
-struct component_head;
 struct component_list;
+struct archetype;
+struct archetype_chunk;
 struct entity;
+struct query;
 
-  
+// Size of one archetype_chunk in bytes. Chunks are allocated aligned to this size so the chunk
+// owning a component can be found from the component pointer alone (see GetEntityIDFromComponent).
+#define ECS_ARCHETYPE_CHUNK_BYTE_SIZE (16*1024)
 
-// TODO: Assemble entities into a balanced binary search tree for "easy" search and access
-
-//  Each entity_component_mapping only point to one component_head* stored in a chunk_list of entity_component_mapping_entry in entity manager
-//    Pro: Components allocated togeather would be next to each other.
-//         Easy to implement
-//    Con: entity_component_mapping* Next; would be the only "wasted cache" memory
-// Note: Can be improved later by useing the memory management strategy we use in the interface class/
-//              Pro: Don't take the 50% cache hit from having a entity_component_mapping_entry* for each component_head*
-//                   Very flexible
-//                   Easy to implement
-//                   Have to extract management strategy to its seaparate file which can be use elsewhere
-//              Con: Have to extract management strategy to its seaparate file which can be alot of work
+// Components are stored by archetype. An archetype is the unique set of components an entity holds.
+// All entities with the same ComponentFlags live in the same archetype and are packed into fixed size
+// archetype_chunks. Each chunk holds one contiguous array per component type in the archetype:
+//
+//   archetype_chunk: | header | entity_id [Capacity] | A [Capacity] | B [Capacity] | ... |
+//
+// The chunk keeps the id of the entity in each row, so visiting the entities of a query
+// (including GetEntityID) only reads the chunks and never the entity slot table.
+// Adding or removing components moves the entity (and the data of the components it keeps)
+// to the chunk of the new archetype. Rows within a chunk are always packed, a removed row is
+// filled with the last row of the same chunk.
+//    Pro: Iterating over a set of components is a linear walk over arrays.
+//         No per-entity links to follow.
+//    Con: Adding/Removing components copies the entity's data to a new chunk.
 
+// Handle to an entity. SlotIndex is where the entity lives in the slot table of the entity_manager.
+// Slots of deleted entities are reused and get a new Generation each time they are freed, so a
+// handle to a deleted entity is detected by comparing generations. Live entities never have Generation 0.
+// The slot table is a paged sparse set, looking up an entity_id is O(1) and ids stay valid for the
+// lifetime of the entity no matter how its components move. They can be kept across frames.
 struct entity_id
 {
-  u32 EntityID;
-  u32 ChunkListIndex;
+  u32 SlotIndex;
+  u32 Generation;
 };
+// Generation of the pending entity_ids handed out by a command_buffer. Never used by a live entity.
+#define ECS_PENDING_ENTITY_GENERATION U32Max
 
 struct entity_manager
 {
   memory_arena Arena;
   temporary_memory TemporaryMemory;
 
-  u32 EntityIdCounter; // Guarantees a nuique id for new entities
-  // List filled with type entity
-  chunk_list EntityList;
-  // List filled with entity_component_link
-  chunk_list EntityComponentLinks;
+  // Entity slot table. Entities are stored in pages of (1 << EntitySlotPageSizeLog2) slots.
+  // Pages never move once allocated, only the page directory grows.
+  u32 EntitySlotPageSizeLog2;
+  u32 EntitySlotPageCount;
+  u32 EntitySlotPageCapacity;
+  entity** EntitySlotPages;
+  u32 EntitySlotCount;     // Slots handed out so far, live or free
+  u32 EntityCount;         // Live entities
+  u32 FirstFreeEntitySlot; // Head of the list of freed slots, U32Max if empty
+  // List filled with type archetype
+  chunk_list Archetypes;
+  // Chunks no longer used by any archetype. Reused before new memory is pushed to the arena.
+  archetype_chunk* FirstFreeChunk;
+  u32 FreeChunkCount;
+  // All registered queries. Updated every time a new archetype is created.
+  query* FirstQuery;
+  // Stamped on a component array of a chunk when it is written to, see change_filter
+  u32 ChangeVersion;
 
   u32 ComponentTypeCount;
   component_list* ComponentTypeVector;
+  component_signature TagFlags;    // Component types defined with ComponentByteSize 0
+  component_signature SharedFlags; // Component types defined with SharedValueCapacity
 };
 
 struct entity_manager_definition
 {
-  bitmask32 ComponentFlag;
-  bitmask32 RequirementsFlag;
-  u32 ComponentChunkCount;
+  component_signature ComponentFlag;
+  component_signature RequirementsFlag;
+  u32 ComponentChunkCount; // Max number of entities holding this component per archetype_chunk. 0 = as many as fits.
+  // 0 makes the component a tag. Tags are only a bit in the signature of the entity's archetype, they take
+  // no memory per entity but work in queries, requirements and HasComponents like any other component.
+  // A tag has no data to get or change filter on. Its ComponentChunkCount is ignored.
   u32 ComponentByteSize;
+  // Optional structure of arrays layout. Each field is stored in its own array in a chunk so a system
+  // reading one field doesn't pull the others into cache. The field sizes must add up to ComponentByteSize.
+  // Access the fields with GetComponentField and GetComponentFieldArray, GetComponent is for
+  // components stored as one struct (FieldCount 0).
+  u32 FieldCount;
+  u32* FieldByteSizes;
+  // Optional, lets an entity hold up to InstanceCapacity instances of the component (several meshes,
+  // colliders, ...). The instances of one entity are stored next to each other in its row so they can be
+  // walked as an array. ComponentByteSize is the size of one instance. See GetComponentInstances.
+  u32 InstanceCapacity;
+  // Optional, makes the component shared. Up to SharedValueCapacity distinct values are stored once in the
+  // entity_manager and each chunk holds the index of the value all its entities use, so entities are grouped
+  // in chunks by value and take no memory per entity for it. See AddSharedComponentValue.
+  // ComponentChunkCount is ignored.
+  u32 SharedValueCapacity;
 };
-entity_manager* CreateEntityManager(u32 EntityChunkCount, u32 EntityMapChunkCount, u32 ComponentCount, entity_manager_definition* DefinitionVector);
+// EntityChunkCount: Number of entity slots allocated at a time, rounded up to a power of two.
+entity_manager* CreateEntityManager(u32 EntityChunkCount, u32 ComponentCount, entity_manager_definition* DefinitionVector);
 
 
 // Create Entities and Components
 entity_id NewEntity( entity_manager* EM );
-entity_id NewEntity( entity_manager* EM, bitmask32 ComponentFlags);
-void NewComponents(entity_manager* EM, entity_id* EntityID, bitmask32 ComponentFlags);
+entity_id NewEntity( entity_manager* EM, component_signature ComponentFlags);
+void NewComponents(entity_manager* EM, entity_id* EntityID, component_signature ComponentFlags);
+// Creates Count entities holding ComponentFlags and their requirements, all zero initialized.
+// Cheaper than Count calls to NewEntity. OutIDs holds Count entity_ids or is 0.
+void NewEntities(entity_manager* EM, u32 Count, component_signature ComponentFlags, entity_id* OutIDs);
 
-// TODO: Add Unit tests
+// Valid means the handle was once returned by NewEntity, it may since have been deleted. See IsAlive.
 inline b32 IsValid(entity_id* EntityID)
 {
-  return EntityID && EntityID->EntityID;
+  return EntityID && EntityID->Generation;
 }
 
-// TODO: Add Unit tests
 inline b32 Compare(entity_id* A, entity_id* B)
 {
   // Two invalid entities are not considered to be the same
-  return IsValid(A) && IsValid(B) && (A->EntityID == B->EntityID);
+  return IsValid(A) && IsValid(B) && (A->SlotIndex == B->SlotIndex) && (A->Generation == B->Generation);
 }
 
+// Stale handle detection that also works in release builds.
+// IsAlive returns false if the entity has been deleted, TryGetComponent then returns 0.
+b32 IsAlive(entity_manager* EM, entity_id* EntityID);
+bptr TryGetComponent(entity_manager* EM, entity_id* EntityID, component_signature ComponentFlag);
+
+// Bulk versions for many ids at once, for example ids kept by tools or scripts. The slot and chunk
+// loads of a batch of ids are issued together instead of one cache miss after the other.
+// OutComponents[i] is 0 if EntityIDs[i] has been deleted or doesn't hold ComponentFlag.
+// Returns the number of components found.
+u32 TryGetComponents(entity_manager* EM, u32 Count, entity_id* EntityIDs, component_signature ComponentFlag, bptr* OutComponents);
+u32 TryGetReadOnlyComponents(entity_manager* EM, u32 Count, entity_id* EntityIDs, component_signature ComponentFlag, bptr* OutComponents);
+// OutAlive may be 0. Returns the number of live entities.
+u32 AreAlive(entity_manager* EM, u32 Count, entity_id* EntityIDs, b32* OutAlive);
+
 // Access Entities and components
 entity_id GetEntityIDFromComponent( bptr Component );
 
-u32 GetEntityCountHoldingTypes(entity_manager* EM, bitmask32 ComponentFlags);
-void GetEntitiesHoldingTypes(entity_manager* EM, bitmask32 ComponentFlags, entity_id* ResultVector);
-bptr GetComponent(entity_manager* EM, entity_id* EntityID, bitmask32 ComponentFlag);
+// Goes through the query registered for ComponentFlags, registers one if there is none.
+// Only the archetypes holding all of ComponentFlags are visited, rare combinations cost next to nothing.
+u32 GetEntityCountHoldingTypes(entity_manager* EM, component_signature ComponentFlags);
+void GetEntitiesHoldingTypes(entity_manager* EM, component_signature ComponentFlags, entity_id* ResultVector);
+struct entity_id_span
+{
+  u32 Count;
+  entity_id* EntityIDs;
+};
+// Pushes the ids on Arena, sized from the entity counts of the archetypes so no counting pass is needed
+entity_id_span GetEntitiesHoldingTypes(entity_manager* EM, component_signature ComponentFlags, memory_arena* Arena);
+bptr GetComponent(entity_manager* EM, entity_id* EntityID, component_signature ComponentFlag);
+// Same as GetComponent without marking the component as changed
+bptr GetReadOnlyComponent(entity_manager* EM, entity_id* EntityID, component_signature ComponentFlag);
+// One field of a component declared with FieldCount
+bptr GetComponentField(entity_manager* EM, entity_id* EntityID, component_signature ComponentFlag, u32 FieldIndex);
+bptr GetReadOnlyComponentField(entity_manager* EM, entity_id* EntityID, component_signature ComponentFlag, u32 FieldIndex);
+
+// Components declared with InstanceCapacity. GetComponentInstances returns the first of InstanceCount
+// instances, 0 if the entity doesn't hold the component. Adding or removing instances invalidates the pointer.
+bptr GetComponentInstances(entity_manager* EM, entity_id* EntityID, component_signature ComponentFlag, u32* InstanceCount);
+bptr GetReadOnlyComponentInstances(entity_manager* EM, entity_id* EntityID, component_signature ComponentFlag, u32* InstanceCount);
+// Adds the component if the entity doesn't hold it. Returns the new zeroed instance, 0 if the entity
+// already holds InstanceCapacity instances.
+bptr AddComponentInstance(entity_manager* EM, entity_id* EntityID, component_signature ComponentFlag);
+// Keeps the order of the remaining instances. The component stays, even without instances.
+void RemoveComponentInstance(entity_manager* EM, entity_id* EntityID, component_signature ComponentFlag, u32 InstanceIndex);
+
+// Components declared with SharedValueCapacity. Value 0 is zeroed and used by entities that just got the component.
+// Returns the index of Value, adding it if no equal value was added before. Returns U32Max if Value is new
+// and the SharedValueCapacity values of the component are used up.
+u32 AddSharedComponentValue(entity_manager* EM, component_signature ComponentFlag, void const* Value);
+// Writing to a value changes it for every entity using it
+bptr GetSharedComponentValue(entity_manager* EM, component_signature ComponentFlag, u32 ValueIndex);
+// Moves the entity to a chunk of entities using ValueIndex. The entity must hold the component.
+void SetSharedComponent(entity_manager* EM, entity_id* EntityID, component_signature ComponentFlag, u32 ValueIndex);
+// U32Max if the entity doesn't hold the component
+u32 GetSharedComponentIndex(entity_manager* EM, entity_id* EntityID, component_signature ComponentFlag);
+
+// Prefabs hold default values for a set of components and create any number of entities holding them at
+// once. Their values are copied into the chunks of the new entities with a few memcpys per array and chunk.
+// The values are zeroed when the prefab is created, write them through GetPrefabComponent.
+// Components pointing to memory of their own, like position nodes, must be set up after instantiation.
+//   prefab* Prop = CreatePrefab(EM, flag::RENDER);
+//   ((render::component*) GetPrefabComponent(Prop, flag::RENDER))->MeshHandle = Mesh;
+//   InstantiatePrefab(EM, Prop, 1000, EntityIDs);
+struct prefab;
+// Holds ComponentFlags and their requirements
+prefab* CreatePrefab(entity_manager* EM, component_signature ComponentFlags);
+component_signature GetPrefabComponentFlags(prefab* Prefab);
+bptr GetPrefabComponent(prefab* Prefab, component_signature ComponentFlag);
+bptr GetPrefabComponentField(prefab* Prefab, component_signature ComponentFlag, u32 FieldIndex);
+// Value of a shared component of the prefab, 0 until set
+void SetPrefabSharedComponent(entity_manager* EM, prefab* Prefab, component_signature ComponentFlag, u32 ValueIndex);
+// Creates Count entities with the components and values of Prefab. OutIDs holds Count entity_ids or is 0.
+void InstantiatePrefab(entity_manager* EM, prefab* Prefab, u32 Count, entity_id* OutIDs);
 
 // TODO: Add Unit tests
-b32 HasComponents(entity_manager* EM, entity_id* EntityID, u32 ComponentFlags);
-b32 HasOneOfComponents(entity_manager* EM, entity_id* EntityID, u32 ComponentFlags);
+b32 HasComponents(entity_manager* EM, entity_id* EntityID, component_signature ComponentFlags);
+b32 HasOneOfComponents(entity_manager* EM, entity_id* EntityID, component_signature ComponentFlags);
+
+// A persistent query. Holds the archetypes matching ComponentFlags and stays subscribed to the
+// entity_manager, every new archetype is added to the queries it matches when it is created.
+// Iterating a query therefore only touches chunks with matching entities.
+// Register queries once at startup and keep the pointer, RegisterQuery returns the already
+// registered query if one exists for the same ComponentFlags.
+struct query
+{
+  component_signature ComponentFlags;
+  u32 ArchetypeCount;
+  u32 ArchetypeCapacity;
+  archetype** Archetypes;
+  query* Next;
+};
+query* RegisterQuery(entity_manager* EM, component_signature ComponentFlags);
+u32 GetEntityCount(query* Query);
+
+// Change tracking. Every component array of a chunk carries the ChangeVersion of the entity_manager
+// at its last write. GetComponent, GetComponentArray and TryGetComponent count as writes, so do
+// entities being added, removed or moved in the chunk. The ReadOnly accessors don't.
+// A system skips chunks nothing has written to since its last run:
+//   u32 Since = System->LastVersion;
+//   System->LastVersion = AdvanceChangeVersion(EM);
+//   filtered_entity_iterator It = GetChangedComponentsOfType(EM, System->Query, {flag::POSITION, Since});
+// Writes through GetComponent by id from a parallel callback may hit chunks owned by other threads, use
+// GetReadOnlyComponent there.
+struct change_filter
+{
+  component_signature ComponentFlags; // A chunk passes if any of these arrays changed, empty = no filter
+  u32 SinceVersion;                   // Changed means written at a version later than this
+};
+// Returns the current version, writes after the call get a later one
+u32 AdvanceChangeVersion(entity_manager* EM);
 
+// Iterates all entities holding at least the components in the query.
+// Entities are visited archetype by archetype and chunk by chunk.
 struct filtered_entity_iterator
 {
   entity_manager* EM;
-  bitmask32 ComponentFilter;
-  entity* CurrentEntity;
-  chunk_list_iterator ComponentIterator;
+  query* Query;
+  change_filter ChangeFilter;
+  u32 ArchetypeIndex; // Next archetype in Query to visit
+  b32 OnEntity;       // Next has stepped onto CurrentRow
+  archetype_chunk* CurrentChunk;
+  u32 CurrentRow;
 };
 entity_id GetEntityID( filtered_entity_iterator* Iterator);
 b32 Next(filtered_entity_iterator* EntityIterator);
-filtered_entity_iterator GetComponentsOfType(entity_manager* EM, bitmask32 ComponentFlagsToFilterOn);
-bptr GetComponent(entity_manager* EM, filtered_entity_iterator* ComponentList, bitmask32 ComponentFlag);
+filtered_entity_iterator GetComponentsOfType(entity_manager* EM, query* Query);
+// Only visits the chunks passing Filter. Filter.ComponentFlags must be part of the query.
+filtered_entity_iterator GetChangedComponentsOfType(entity_manager* EM, query* Query, change_filter Filter);
+// Uses the query registered for ComponentFlagsToFilterOn, registers one if there is none.
+filtered_entity_iterator GetComponentsOfType(entity_manager* EM, component_signature ComponentFlagsToFilterOn);
+bptr GetComponent(entity_manager* EM, filtered_entity_iterator* ComponentList, component_signature ComponentFlag);
+
+// Chunk-wise iteration. Use NextChunk instead of Next to step one archetype_chunk at a time
+// and get the contiguous component arrays of the chunk with GetComponentArray.
+// Example:
+//   filtered_entity_iterator It = GetComponentsOfType(EM, PositionQuery);
+//   while(NextChunk(&It)) {
+//     position::component* Positions = (position::component*) GetComponentArray(&It, flag::POSITION);
+//     for(u32 i = 0; i < GetChunkEntityCount(&It); i++) { ... Positions[i] ... }
+//   }
+b32 NextChunk(filtered_entity_iterator* EntityIterator);
+u32 GetChunkEntityCount(filtered_entity_iterator* EntityIterator);
+// Ids of the entities in the rows of the current chunk, same order as the component arrays
+entity_id const* GetChunkEntityIDs(filtered_entity_iterator* EntityIterator);
+bptr GetComponentArray(filtered_entity_iterator* EntityIterator, component_signature ComponentFlag);
+bptr GetReadOnlyComponentArray(filtered_entity_iterator* EntityIterator, component_signature ComponentFlag);
+// The array of one field of a component declared with FieldCount
+bptr GetComponentFieldArray(filtered_entity_iterator* EntityIterator, component_signature ComponentFlag, u32 FieldIndex);
+bptr GetReadOnlyComponentFieldArray(filtered_entity_iterator* EntityIterator, component_signature ComponentFlag, u32 FieldIndex);
+// The instances of the entity at Row of the current chunk, for components declared with InstanceCapacity
+bptr GetComponentInstances(filtered_entity_iterator* EntityIterator, component_signature ComponentFlag, u32 Row, u32* InstanceCount);
+bptr GetReadOnlyComponentInstances(filtered_entity_iterator* EntityIterator, component_signature ComponentFlag, u32 Row, u32* InstanceCount);
+// All entities of a chunk use the same value of a shared component, iterating chunks visits them grouped by value.
+// U32Max and 0 if the chunk doesn't hold the component.
+u32 GetSharedComponentIndex(filtered_entity_iterator* EntityIterator, component_signature ComponentFlag);
+bptr GetSharedComponent(filtered_entity_iterator* EntityIterator, component_signature ComponentFlag);
+b32 HasChunkChanged(archetype_chunk* Chunk, change_filter* Filter);
+
+// Chunk fragmentation. Rows within a chunk are always packed but after churn an archetype can be
+// spread over many partially filled chunks, which costs memory and iteration time.
+struct fragmentation_stats
+{
+  u32 ChunkCount;        // Chunks used by archetypes
+  u32 MinimumChunkCount; // Chunks needed if every archetype was packed, ignoring shared component values
+  u32 FreeChunkCount;    // Chunks in the free pool, reused before new memory is allocated
+  u32 EntityRowCount;    // Rows holding an entity
+  u32 RowCapacity;       // Rows in all used chunks
+};
+fragmentation_stats GetFragmentation(entity_manager* EM);
+
+// Memory telemetry, for sizing EntityChunkCount and ComponentChunkCount and catching regressions.
+// Per component type, summed over the archetypes holding it. Wasted bytes are the free rows of the type
+// in its chunks.
+struct component_memory_stats
+{
+  u32 EntityCount;
+  u32 RowCapacity;
+  u32 ChunkCount;
+  u32 ArchetypeCount;
+  midx BytesUsed;
+  midx BytesWasted;
+  r32 AverageChunkFill; // EntityCount / RowCapacity
+};
+
+struct memory_stats
+{
+  u32 EntityCount;
+  u32 EntitySlotCount;        // Slots handed out, live or free
+  u32 EntitySlotCapacity;     // Slots in the allocated pages
+  midx EntitySlotBytes;       // Slot pages and the page directory
+  u32 ArchetypeCount;
+  u32 ChunkCount;
+  u32 FreeChunkCount;
+  midx ChunkBytes;            // Chunks used by archetypes, the sum of the four below
+  midx ComponentBytesUsed;
+  midx ComponentBytesWasted;
+  midx EntityRowBytes;        // The entity id of every row, used or free
+  midx ChunkOverheadBytes;    // Chunk headers, change versions and alignment padding
+  midx FreeChunkBytes;        // Chunks in the free pool
+  r32 AverageChunkFill;
+};
+// ComponentStats holds ComponentTypeCount entries indexed like the component bits, may be 0
+memory_stats GetMemoryStats(entity_manager* EM, component_memory_stats* ComponentStats);
+// Prints GetMemoryStats with Platform.DEBUGPrint
+void PrintMemoryReport(entity_manager* EM);
+
+struct compaction_result
+{
+  fragmentation_stats Before;
+  fragmentation_stats After;
+  midx BytesMoved;
+  u32 EntitiesMoved;
+  u32 ChunksReleased;
+  b32 Done; // Every archetype is packed
+};
+// Incremental compaction. Moves entities from the emptiest chunks of an archetype into its fullest
+// ones until ByteBudget bytes of components have been moved or everything is packed. Only chunks using
+// the same shared component values are merged.
+// Emptied chunks go back to the free pool. Entity ids stay valid, component pointers do not.
+// Must not be called while iterating.
+compaction_result CompactChunks(entity_manager* EM, midx ByteBudget);
 
 // Delete entities and components
-void DeleteComponent(entity_manager* EM, entity_id* EntityID, bitmask32 ComponentFlag);
+void DeleteComponents(entity_manager* EM, entity_id* EntityID, component_signature ComponentFlag);
 void DeleteEntity(entity_manager* EM, entity_id* EntityID);
+// Deletes Count entities at once, each chunk is compacted once. Each entity may only be listed once.
 void DeleteEntities(entity_manager* EM, u32 Count, entity_id* EntityID);
 
-}
\ No newline at end of file
+// Several entity managers
+// Entity managers are independent, each has its own entities, chunks and queries. Entities can be moved
+// between managers created from the same definitions, for example to freeze a region of the world
+// by moving it out of the manager that gets updated.
+
+// Moves Count entities with all their components from Source to Destination. Entities get new ids in
+// Destination, written to OutIDs in the order of EntityIDs, OutIDs may be 0. The old ids go stale.
+// Chunks whose entities all move are copied as a whole into new chunks of Destination, the others row by row.
+// Destination never holds memory of Source, so either can be destroyed afterwards.
+// Shared component values are added to Destination when missing. Each entity may only be listed once.
+// Returns false and moves nothing if Destination has no room left for the shared values of the entities
+// or was created from other definitions than Source.
+b32 MoveEntities(entity_manager* Source, entity_manager* Destination, u32 Count, entity_id* EntityIDs, entity_id* OutIDs);
+// Deletes all entities, all chunks go back to the free pool. Archetypes, queries and shared values are kept
+// so the entity_manager can be reused for a new set of entities.
+void ClearEntityManager(entity_manager* EM);
+
+}
@@ -0,0 +1,981 @@
+#pragma once
+#include "entity_components_backend.h"
+#include "entity_components_parallel.h"
+#include "entity_components_snapshot.h"
+#include "entity_components_typed_query.h"
+#include "entity_components_scheduler.h"
+#include <thread>
+#include <chrono>
+#include <math.h>
+#include <stdio.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#else
+#include <x86intrin.h>
+#endif
+
+// Micro benchmarks for the entity_manager backend.
+// Like the unit tests these are meant to be called from a debug build, results are printed with Platform.DEBUGPrint.
+namespace entity_components_backend_benchmarks
+{
+using namespace ecs;
+
+enum component_type_benchmark
+{
+  BENCH_COMPONENT_FLAG_A = 1<<0,
+  BENCH_COMPONENT_FLAG_B = 1<<1,
+  BENCH_COMPONENT_FLAG_C = 1<<2,
+  BENCH_COMPONENT_FLAG_D = 1<<3,
+  BENCH_COMPONENT_FLAG_E = 1<<4,
+  BENCH_COMPONENT_FLAG_F = 1<<5,
+  BENCH_COMPONENT_TYPE_COUNT = 6
+};
+
+struct bench_component_small
+{
+  u32 Value;
+};
+
+struct bench_component_medium
+{
+  u32 Value;
+  r32 Data[7];
+};
+
+struct bench_component_large
+{
+  u32 Value;
+  r32 Data[31];
+};
+
+}
+// Typed queries need one struct per component type, E shares its struct with B and is left out
+ECS_TYPED_COMPONENT(entity_components_backend_benchmarks::bench_component_medium, entity_components_backend_benchmarks::BENCH_COMPONENT_FLAG_B);
+ECS_TYPED_COMPONENT(entity_components_backend_benchmarks::bench_component_large, entity_components_backend_benchmarks::BENCH_COMPONENT_FLAG_D);
+namespace entity_components_backend_benchmarks
+{
+
+inline u64 ReadCycleCounter()
+{
+  return __rdtsc();
+}
+
+struct bench_random
+{
+  u32 State;
+};
+
+inline u32 NextRandom(bench_random* Random)
+{
+  // xorshift32
+  u32 X = Random->State;
+  X ^= X << 13;
+  X ^= X >> 17;
+  X ^= X << 5;
+  Random->State = X;
+  return X;
+}
+
+entity_manager* CreateBenchmarkEntityManager(u32 EntityChunkCount)
+{
+  entity_manager_definition Definitions[] =
+  {
+    {BENCH_COMPONENT_FLAG_A, 0, 0, sizeof(bench_component_small)},
+    {BENCH_COMPONENT_FLAG_B, 0, 0, sizeof(bench_component_medium)},
+    {BENCH_COMPONENT_FLAG_C, 0, 0, sizeof(bench_component_small)},
+    {BENCH_COMPONENT_FLAG_D, 0, 0, sizeof(bench_component_large)},
+    {BENCH_COMPONENT_FLAG_E, 0, 0, sizeof(bench_component_medium)},
+    {BENCH_COMPONENT_FLAG_F, 0, 0, sizeof(bench_component_small)}
+  };
+  entity_manager* Result = CreateEntityManager(EntityChunkCount, ArrayCount(Definitions), Definitions);
+  return Result;
+}
+
+// Creates EntityCount entities which all hold component A plus a random subset of the other components.
+// The first u32 of every component is set to the SlotIndex of the entity.
+entity_id* CreateMixedEntities(memory_arena* Arena, entity_manager* EM, u32 EntityCount, bench_random* Random)
+{
+  entity_id* Result = PushArray(Arena, EntityCount, entity_id);
+  for(u32 Index = 0; Index < EntityCount; ++Index)
+  {
+    bitmask32 Flags = BENCH_COMPONENT_FLAG_A | (NextRandom(Random) & ((1 << BENCH_COMPONENT_TYPE_COUNT) - 1));
+    Result[Index] = NewEntity(EM, Flags);
+    for(u32 TypeIndex = 0; TypeIndex < BENCH_COMPONENT_TYPE_COUNT; ++TypeIndex)
+    {
+      u32* Value = (u32*) GetComponent(EM, Result + Index, 1 << TypeIndex);
+      if(Value)
+      {
+        *Value = Result[Index].SlotIndex;
+      }
+    }
+  }
+  return Result;
+}
+
+// The way GetComponent located a component array before it used a masked popcount:
+// Step through the set bits of the archetype until we reach the requested component.
+internal u32 GetComponentArrayIndexBitScan(u32 IndexOfComponent, component_signature ArchetypeFlags)
+{
+  u32 Index = 0;
+  u32 IndexOfBitInMap = 0;
+  while(IndexOfLeastSignificantSetBit(ArchetypeFlags, &IndexOfBitInMap))
+  {
+    if(IndexOfComponent == IndexOfBitInMap)
+    {
+      return Index;
+    }
+    ArchetypeFlags = AndNot(ArchetypeFlags, ComponentFlagFromIndex(IndexOfBitInMap));
+    ++Index;
+  }
+  INVALID_CODE_PATH;
+  return 0;
+}
+
+internal bptr GetComponentBitScan(entity_manager* EM, entity_id* EntityID, component_signature ComponentFlag)
+{
+  entity* Entity = GetEntityFromID(EM, EntityID);
+  component_signature EntityFlags = GetEntityComponentFlags(Entity);
+  u32 ComponentIndex = GetComponentIndex(ComponentFlag);
+  if(!IsBitSet(EntityFlags, ComponentIndex))
+  {
+    return 0;
+  }
+  u32 ArrayIndex = GetComponentArrayIndexBitScan(ComponentIndex, Entity->Chunk->Archetype->StoredFlags);
+  bptr Result = GetChunkComponentArray(Entity->Chunk, ArrayIndex) + Entity->Row * Entity->Chunk->Archetype->Columns[ArrayIndex].ByteSize;
+  return Result;
+}
+
+// Looks up Flags for every entity in AccessOrder RepeatCount times, returns cycles per lookup
+template<typename lookup_function>
+r64 TimeLookups(entity_manager* EM, entity_id* EntityIDs, u32* AccessOrder, u32 EntityCount, bitmask32 ComponentFlag, u32 RepeatCount, lookup_function Lookup, u64* Checksum)
+{
+  u64 Sum = 0;
+  u64 Begin = ReadCycleCounter();
+  for(u32 Repeat = 0; Repeat < RepeatCount; ++Repeat)
+  {
+    for(u32 Index = 0; Index < EntityCount; ++Index)
+    {
+      u32* Value = (u32*) Lookup(EM, EntityIDs + AccessOrder[Index], ComponentFlag);
+      Sum += Value ? *Value : 0;
+    }
+  }
+  u64 End = ReadCycleCounter();
+  *Checksum += Sum;
+  r64 Result = (End - Begin) / (r64) (EntityCount * (u64) RepeatCount);
+  return Result;
+}
+
+// Compares GetComponent (masked popcount) against the bit scanning lookup it replaced.
+void BenchmarkGetComponent(memory_arena* Arena, u32 EntityCount, u32 RepeatCount)
+{
+  ScopedMemory ScopedMem = ScopedMemory(Arena);
+  bench_random Random = {0x1234567};
+  entity_manager* EM = CreateBenchmarkEntityManager(1024);
+  entity_id* EntityIDs = CreateMixedEntities(Arena, EM, EntityCount, &Random);
+
+  u32* LinearOrder = PushArray(Arena, EntityCount, u32);
+  u32* RandomOrder = PushArray(Arena, EntityCount, u32);
+  for(u32 Index = 0; Index < EntityCount; ++Index)
+  {
+    LinearOrder[Index] = Index;
+    RandomOrder[Index] = Index;
+  }
+  for(u32 Index = EntityCount - 1; Index > 0; --Index)
+  {
+    u32 SwapIndex = NextRandom(&Random) % (Index + 1);
+    u32 Tmp = RandomOrder[Index];
+    RandomOrder[Index] = RandomOrder[SwapIndex];
+    RandomOrder[SwapIndex] = Tmp;
+  }
+
+  auto PopCountLookup = [](entity_manager* EM, entity_id* ID, bitmask32 Flag) { return GetReadOnlyComponent(EM, ID, Flag); };
+  auto BitScanLookup  = [](entity_manager* EM, entity_id* ID, bitmask32 Flag) { return GetComponentBitScan(EM, ID, Flag); };
+
+  u64 Checksum = 0;
+  Platform.DEBUGPrint("GetComponent, %d entities, cycles per lookup:\n", EntityCount);
+  Platform.DEBUGPrint("  %-8s %-8s %10s %10s\n", "Order", "Type", "BitScan", "PopCount");
+  for(u32 Ordering = 0; Ordering < 2; ++Ordering)
+  {
+    u32* AccessOrder = Ordering == 0 ? LinearOrder : RandomOrder;
+    bitmask32 FlagsToTest[] = {BENCH_COMPONENT_FLAG_A, BENCH_COMPONENT_FLAG_D, BENCH_COMPONENT_FLAG_F};
+    for(u32 FlagIndex = 0; FlagIndex < ArrayCount(FlagsToTest); ++FlagIndex)
+    {
+      bitmask32 Flag = FlagsToTest[FlagIndex];
+      r64 BitScanCycles  = TimeLookups(EM, EntityIDs, AccessOrder, EntityCount, Flag, RepeatCount, BitScanLookup, &Checksum);
+      r64 PopCountCycles = TimeLookups(EM, EntityIDs, AccessOrder, EntityCount, Flag, RepeatCount, PopCountLookup, &Checksum);
+      Platform.DEBUGPrint("  %-8s %-8d %10.2f %10.2f\n", Ordering == 0 ? "Linear" : "Random", IndexOfLeastSignificantSetBit(Flag), BitScanCycles, PopCountCycles);
+    }
+  }
+  // Both lookups read the same components so they contribute the same amount to the checksum
+  Platform.DEBUGPrint("  Checksum %llu\n", Checksum);
+}
+
+inline r64 GetWallClockSeconds()
+{
+  r64 Result = std::chrono::duration<r64>(std::chrono::steady_clock::now().time_since_epoch()).count();
+  return Result;
+}
+
+// Some per entity work, roughly what a movement or transform update costs
+internal void BenchmarkParallelCallback(parallel_chunk* Chunk, void*)
+{
+  bench_component_medium* Medium = (bench_component_medium*) GetComponentArray(&Chunk->Iterator, BENCH_COMPONENT_FLAG_B);
+  bench_component_large* Large = (bench_component_large*) GetComponentArray(&Chunk->Iterator, BENCH_COMPONENT_FLAG_D);
+  u32 EntityCount = GetChunkEntityCount(&Chunk->Iterator);
+  for(u32 Index = 0; Index < EntityCount; ++Index)
+  {
+    r32* In = Medium[Index].Data;
+    r32* Out = Large[Index].Data;
+    for(u32 DataIndex = 0; DataIndex < ArrayCount(Large[Index].Data); ++DataIndex)
+    {
+      r32 X = In[DataIndex % ArrayCount(Medium[Index].Data)];
+      Out[DataIndex] = Out[DataIndex] * 0.5f + sqrtf(X * X + 1.f);
+    }
+  }
+}
+
+// Times ParallelForEachChunk over EntityCount entities holding B and D for 1 to hardware_concurrency threads.
+void BenchmarkParallelForEach(memory_arena* Arena, u32 EntityCount, u32 RepeatCount)
+{
+  ScopedMemory ScopedMem = ScopedMemory(Arena);
+  entity_manager* EM = CreateBenchmarkEntityManager(1024);
+  bench_random Random = {0x7654321};
+  for(u32 Index = 0; Index < EntityCount; ++Index)
+  {
+    // Spread the entities over a few archetypes
+    bitmask32 Flags = BENCH_COMPONENT_FLAG_B | BENCH_COMPONENT_FLAG_D | (NextRandom(&Random) & (BENCH_COMPONENT_FLAG_A | BENCH_COMPONENT_FLAG_F));
+    entity_id EntityID = NewEntity(EM, Flags);
+    bench_component_medium* Medium = (bench_component_medium*) GetComponent(EM, &EntityID, BENCH_COMPONENT_FLAG_B);
+    for(u32 DataIndex = 0; DataIndex < ArrayCount(Medium->Data); ++DataIndex)
+    {
+      Medium->Data[DataIndex] = (r32) (NextRandom(&Random) % 1000);
+    }
+  }
+  query* Query = RegisterQuery(EM, BENCH_COMPONENT_FLAG_B | BENCH_COMPONENT_FLAG_D);
+
+  u32 MaxThreadCount = std::thread::hardware_concurrency();
+  if(MaxThreadCount == 0)
+  {
+    MaxThreadCount = 1;
+  }
+
+  u32 ChunkCount = 0;
+  for(u32 ArchetypeIndex = 0; ArchetypeIndex < Query->ArchetypeCount; ++ArchetypeIndex)
+  {
+    ChunkCount += Query->Archetypes[ArchetypeIndex]->ChunkCount;
+  }
+  Platform.DEBUGPrint("ParallelForEachChunk, %d entities, %d chunks:\n", EntityCount, ChunkCount);
+  Platform.DEBUGPrint("  %-8s %12s %10s\n", "Threads", "ms/pass", "Speedup");
+  r64 SingleThreadTime = 0;
+  for(u32 ThreadCount = 1; ThreadCount <= MaxThreadCount; ++ThreadCount)
+  {
+    worker_pool* Pool = CreateWorkerPool(ThreadCount - 1);
+    ParallelForEachChunk(Pool, EM, Query, BenchmarkParallelCallback, 0); // Warm up
+    r64 Begin = GetWallClockSeconds();
+    for(u32 Repeat = 0; Repeat < RepeatCount; ++Repeat)
+    {
+      ParallelForEachChunk(Pool, EM, Query, BenchmarkParallelCallback, 0);
+    }
+    r64 PassTime = (GetWallClockSeconds() - Begin) / RepeatCount;
+    DestroyWorkerPool(Pool);
+    if(ThreadCount == 1)
+    {
+      SingleThreadTime = PassTime;
+    }
+    Platform.DEBUGPrint("  %-8d %12.3f %10.2f\n", ThreadCount, PassTime * 1000.0, SingleThreadTime / PassTime);
+  }
+}
+
+// Creates and deletes EntityCount identical entities one at a time and in bulk
+void BenchmarkBulkCreateDelete(memory_arena* Arena, u32 EntityCount)
+{
+  ScopedMemory ScopedMem = ScopedMemory(Arena);
+  bitmask32 Flags = BENCH_COMPONENT_FLAG_B | BENCH_COMPONENT_FLAG_D | BENCH_COMPONENT_FLAG_F;
+  entity_id* EntityIDs = PushArray(Arena, EntityCount, entity_id);
+
+  entity_manager* SingleEM = CreateBenchmarkEntityManager(1024);
+  r64 Begin = GetWallClockSeconds();
+  for(u32 Index = 0; Index < EntityCount; ++Index)
+  {
+    EntityIDs[Index] = NewEntity(SingleEM, Flags);
+  }
+  r64 SingleCreateTime = GetWallClockSeconds() - Begin;
+  Begin = GetWallClockSeconds();
+  for(u32 Index = 0; Index < EntityCount; ++Index)
+  {
+    DeleteEntity(SingleEM, EntityIDs + Index);
+  }
+  r64 SingleDeleteTime = GetWallClockSeconds() - Begin;
+
+  entity_manager* BulkEM = CreateBenchmarkEntityManager(1024);
+  Begin = GetWallClockSeconds();
+  NewEntities(BulkEM, EntityCount, Flags, EntityIDs);
+  r64 BulkCreateTime = GetWallClockSeconds() - Begin;
+  Begin = GetWallClockSeconds();
+  DeleteEntities(BulkEM, EntityCount, EntityIDs);
+  r64 BulkDeleteTime = GetWallClockSeconds() - Begin;
+
+  r64 NanoSeconds = 1e9 / EntityCount;
+  Platform.DEBUGPrint("Create/Delete, %d entities:\n", EntityCount);
+  Platform.DEBUGPrint("  %-12s %12s %12s\n", "", "ns/create", "ns/delete");
+  Platform.DEBUGPrint("  %-12s %12.1f %12.1f\n", "One by one", SingleCreateTime * NanoSeconds, SingleDeleteTime * NanoSeconds);
+  Platform.DEBUGPrint("  %-12s %12.1f %12.1f\n", "Bulk", BulkCreateTime * NanoSeconds, BulkDeleteTime * NanoSeconds);
+}
+
+// Resolves EntityCount ids in random order one at a time and with TryGetReadOnlyComponents
+void BenchmarkBulkLookup(memory_arena* Arena, u32 EntityCount, u32 RepeatCount)
+{
+  ScopedMemory ScopedMem = ScopedMemory(Arena);
+  bench_random Random = {0x1357911};
+  entity_manager* EM = CreateBenchmarkEntityManager(4096);
+  entity_id* EntityIDs = CreateMixedEntities(Arena, EM, EntityCount, &Random);
+  for(u32 Index = EntityCount - 1; Index > 0; --Index)
+  {
+    u32 SwapIndex = NextRandom(&Random) % (Index + 1);
+    entity_id Tmp = EntityIDs[Index];
+    EntityIDs[Index] = EntityIDs[SwapIndex];
+    EntityIDs[SwapIndex] = Tmp;
+  }
+  bptr* Components = PushArray(Arena, EntityCount, bptr);
+
+  u64 Checksum = 0;
+  r64 Begin = GetWallClockSeconds();
+  for(u32 Repeat = 0; Repeat < RepeatCount; ++Repeat)
+  {
+    for(u32 Index = 0; Index < EntityCount; ++Index)
+    {
+      Components[Index] = TryGetComponent(EM, EntityIDs + Index, BENCH_COMPONENT_FLAG_A);
+    }
+    Checksum += *(u32*) Components[EntityCount / 2];
+  }
+  r64 SingleTime = GetWallClockSeconds() - Begin;
+
+  Begin = GetWallClockSeconds();
+  for(u32 Repeat = 0; Repeat < RepeatCount; ++Repeat)
+  {
+    TryGetReadOnlyComponents(EM, EntityCount, EntityIDs, BENCH_COMPONENT_FLAG_A, Components);
+    Checksum += *(u32*) Components[EntityCount / 2];
+  }
+  r64 BulkTime = GetWallClockSeconds() - Begin;
+
+  r64 NanoSeconds = 1e9 / (EntityCount * (r64) RepeatCount);
+  Platform.DEBUGPrint("Lookup by id in random order, %d entities:\n", EntityCount);
+  Platform.DEBUGPrint("  %-12s %12s\n", "", "ns/lookup");
+  Platform.DEBUGPrint("  %-12s %12.1f\n", "One by one", SingleTime * NanoSeconds);
+  Platform.DEBUGPrint("  %-12s %12.1f\n", "Bulk", BulkTime * NanoSeconds);
+  Platform.DEBUGPrint("  Checksum %llu\n", Checksum);
+}
+
+// Visits the entities holding A and B where only SelectedPercent of the entities holding A also
+// hold B, the rest hold A and C. Compares filtering entity by entity through the slot table with
+// the query, which skips the A|C archetype as a whole and reads ids from the chunk rows.
+void BenchmarkFilteredIteration(memory_arena* Arena, u32 EntityCount, u32 SelectedPercent, u32 RepeatCount)
+{
+  ScopedMemory ScopedMem = ScopedMemory(Arena);
+  bench_random Random = {0x2468ace};
+  entity_manager* EM = CreateBenchmarkEntityManager(4096);
+  entity_id* EntityIDs = PushArray(Arena, EntityCount, entity_id);
+  u32 SelectedCount = 0;
+  for(u32 Index = 0; Index < EntityCount; ++Index)
+  {
+    b32 Selected = (NextRandom(&Random) % 100) < SelectedPercent;
+    EntityIDs[Index] = NewEntity(EM, BENCH_COMPONENT_FLAG_A | (Selected ? BENCH_COMPONENT_FLAG_B : BENCH_COMPONENT_FLAG_C));
+    ((bench_component_small*) GetComponent(EM, EntityIDs + Index, BENCH_COMPONENT_FLAG_A))->Value = Index;
+    SelectedCount += Selected;
+  }
+  query* Query = RegisterQuery(EM, BENCH_COMPONENT_FLAG_A | BENCH_COMPONENT_FLAG_B);
+
+  u64 Checksum = 0;
+  r64 Begin = GetWallClockSeconds();
+  for(u32 Repeat = 0; Repeat < RepeatCount; ++Repeat)
+  {
+    for(u32 Index = 0; Index < EntityCount; ++Index)
+    {
+      if(HasComponents(EM, EntityIDs + Index, BENCH_COMPONENT_FLAG_A | BENCH_COMPONENT_FLAG_B))
+      {
+        Checksum += ((bench_component_small*) GetReadOnlyComponent(EM, EntityIDs + Index, BENCH_COMPONENT_FLAG_A))->Value + EntityIDs[Index].SlotIndex;
+      }
+    }
+  }
+  r64 ByIDTime = GetWallClockSeconds() - Begin;
+
+  Begin = GetWallClockSeconds();
+  for(u32 Repeat = 0; Repeat < RepeatCount; ++Repeat)
+  {
+    filtered_entity_iterator Iterator = GetComponentsOfType(EM, Query);
+    while(Next(&Iterator))
+    {
+      Checksum += ((bench_component_small*) GetComponent(EM, &Iterator, BENCH_COMPONENT_FLAG_A))->Value + GetEntityID(&Iterator).SlotIndex;
+    }
+  }
+  r64 NextTime = GetWallClockSeconds() - Begin;
+
+  Begin = GetWallClockSeconds();
+  for(u32 Repeat = 0; Repeat < RepeatCount; ++Repeat)
+  {
+    filtered_entity_iterator Iterator = GetComponentsOfType(EM, Query);
+    while(NextChunk(&Iterator))
+    {
+      bench_component_small* Values = (bench_component_small*) GetReadOnlyComponentArray(&Iterator, BENCH_COMPONENT_FLAG_A);
+      entity_id const* IDs = GetChunkEntityIDs(&Iterator);
+      u32 ChunkEntityCount = GetChunkEntityCount(&Iterator);
+      for(u32 Row = 0; Row < ChunkEntityCount; ++Row)
+      {
+        Checksum += Values[Row].Value + IDs[Row].SlotIndex;
+      }
+    }
+  }
+  r64 NextChunkTime = GetWallClockSeconds() - Begin;
+
+  r64 PerVisited = 1e9 / (Maximum(SelectedCount, (u32) 1) * (r64) RepeatCount);
+  r64 PerEntity = 1e9 / (EntityCount * (r64) RepeatCount);
+  Platform.DEBUGPrint("Filtered iteration, %d entities, %d%% selected:\n", EntityCount, SelectedPercent);
+  Platform.DEBUGPrint("  %-12s %12s %12s\n", "", "ns/visited", "ns/entity");
+  Platform.DEBUGPrint("  %-12s %12.2f %12.2f\n", "Check by id", ByIDTime * PerVisited, ByIDTime * PerEntity);
+  Platform.DEBUGPrint("  %-12s %12.2f %12.2f\n", "Next", NextTime * PerVisited, NextTime * PerEntity);
+  Platform.DEBUGPrint("  %-12s %12.2f %12.2f\n", "NextChunk", NextChunkTime * PerVisited, NextChunkTime * PerEntity);
+  Platform.DEBUGPrint("  Checksum %llu\n", Checksum);
+}
+
+// Moves EntityCount entities to a second entity_manager, once all of them so whole chunks change owner
+// and once every other entity so rows are copied
+void BenchmarkMoveEntities(memory_arena* Arena, u32 EntityCount)
+{
+  ScopedMemory ScopedMem = ScopedMemory(Arena);
+  entity_id* EntityIDs = PushArray(Arena, EntityCount, entity_id);
+  entity_id* MovedIDs = PushArray(Arena, EntityCount, entity_id);
+  bitmask32 Flags = BENCH_COMPONENT_FLAG_A | BENCH_COMPONENT_FLAG_B | BENCH_COMPONENT_FLAG_C;
+
+  entity_manager* Source = CreateBenchmarkEntityManager(4096);
+  entity_manager* Destination = CreateBenchmarkEntityManager(4096);
+  NewEntities(Source, EntityCount, Flags, EntityIDs);
+  r64 Begin = GetWallClockSeconds();
+  MoveEntities(Source, Destination, EntityCount, EntityIDs, MovedIDs);
+  r64 WholeChunkTime = GetWallClockSeconds() - Begin;
+  Assert(Destination->EntityCount == EntityCount);
+
+  // Every other entity back, the ids are now in Destination
+  u32 HalfCount = 0;
+  for(u32 Index = 0; Index < EntityCount; Index += 2)
+  {
+    EntityIDs[HalfCount++] = MovedIDs[Index];
+  }
+  Begin = GetWallClockSeconds();
+  MoveEntities(Destination, Source, HalfCount, EntityIDs, MovedIDs);
+  r64 RowTime = GetWallClockSeconds() - Begin;
+  Assert(Source->EntityCount == HalfCount);
+
+  Platform.DEBUGPrint("Move entities between entity managers, %d entities:\n", EntityCount);
+  Platform.DEBUGPrint("  %-14s %12s\n", "", "ns/entity");
+  Platform.DEBUGPrint("  %-14s %12.2f\n", "Whole chunks", WholeChunkTime * 1e9 / EntityCount);
+  Platform.DEBUGPrint("  %-14s %12.2f\n", "Every other", RowTime * 1e9 / HalfCount);
+}
+
+// Same per entity work through Next and GetComponent, through the arrays of NextChunk written by
+// hand and through a typed query
+void BenchmarkTypedQuery(memory_arena* Arena, u32 EntityCount, u32 RepeatCount)
+{
+  ScopedMemory ScopedMem = ScopedMemory(Arena);
+  entity_manager* EM = CreateBenchmarkEntityManager(4096);
+  NewEntities(EM, EntityCount, BENCH_COMPONENT_FLAG_B | BENCH_COMPONENT_FLAG_D, 0);
+  typed_query<const bench_component_medium, bench_component_large> Query = RegisterTypedQuery<const bench_component_medium, bench_component_large>(EM);
+
+  r64 Begin = GetWallClockSeconds();
+  for(u32 Repeat = 0; Repeat < RepeatCount; ++Repeat)
+  {
+    filtered_entity_iterator Iterator = GetComponentsOfType(EM, Query.Query);
+    while(Next(&Iterator))
+    {
+      bench_component_medium* Medium = (bench_component_medium*) GetComponent(EM, &Iterator, BENCH_COMPONENT_FLAG_B);
+      bench_component_large* Large = (bench_component_large*) GetComponent(EM, &Iterator, BENCH_COMPONENT_FLAG_D);
+      Large->Data[0] += Medium->Data[0] + 1;
+    }
+  }
+  r64 NextTime = GetWallClockSeconds() - Begin;
+
+  Begin = GetWallClockSeconds();
+  for(u32 Repeat = 0; Repeat < RepeatCount; ++Repeat)
+  {
+    filtered_entity_iterator Iterator = GetComponentsOfType(EM, Query.Query);
+    while(NextChunk(&Iterator))
+    {
+      bench_component_medium* Mediums = (bench_component_medium*) GetReadOnlyComponentArray(&Iterator, BENCH_COMPONENT_FLAG_B);
+      bench_component_large* Larges = (bench_component_large*) GetComponentArray(&Iterator, BENCH_COMPONENT_FLAG_D);
+      u32 ChunkEntityCount = GetChunkEntityCount(&Iterator);
+      for(u32 Row = 0; Row < ChunkEntityCount; ++Row)
+      {
+        Larges[Row].Data[0] += Mediums[Row].Data[0] + 1;
+      }
+    }
+  }
+  r64 ArrayTime = GetWallClockSeconds() - Begin;
+
+  Begin = GetWallClockSeconds();
+  for(u32 Repeat = 0; Repeat < RepeatCount; ++Repeat)
+  {
+    ForEach(EM, Query, [](const bench_component_medium& Medium, bench_component_large& Large)
+    {
+      Large.Data[0] += Medium.Data[0] + 1;
+    });
+  }
+  r64 TypedTime = GetWallClockSeconds() - Begin;
+
+  r64 Checksum = 0;
+  ForEach(EM, Query, [&Checksum](const bench_component_medium& Medium, bench_component_large& Large)
+  {
+    Checksum += Large.Data[0] - Medium.Data[0];
+  });
+
+  r64 NanoSeconds = 1e9 / (EntityCount * (r64) RepeatCount);
+  Platform.DEBUGPrint("Typed query, %d entities:\n", EntityCount);
+  Platform.DEBUGPrint("  %-12s %12s\n", "", "ns/entity");
+  Platform.DEBUGPrint("  %-12s %12.2f\n", "Next", NextTime * NanoSeconds);
+  Platform.DEBUGPrint("  %-12s %12.2f\n", "NextChunk", ArrayTime * NanoSeconds);
+  Platform.DEBUGPrint("  %-12s %12.2f\n", "ForEach", TypedTime * NanoSeconds);
+  Platform.DEBUGPrint("  Checksum %.0f\n", Checksum);
+}
+
+// Writes and restores a snapshot of EntityCount entities spread over a few archetypes
+void BenchmarkSnapshot(memory_arena* Arena, u32 EntityCount)
+{
+  ScopedMemory ScopedMem = ScopedMemory(Arena);
+  entity_manager* EM = CreateBenchmarkEntityManager(4096);
+  bitmask32 FlagsToCreate[] =
+  {
+    BENCH_COMPONENT_FLAG_A | BENCH_COMPONENT_FLAG_B,
+    BENCH_COMPONENT_FLAG_A | BENCH_COMPONENT_FLAG_C,
+    BENCH_COMPONENT_FLAG_A | BENCH_COMPONENT_FLAG_B | BENCH_COMPONENT_FLAG_F,
+    BENCH_COMPONENT_FLAG_E,
+  };
+  for(u32 FlagIndex = 0; FlagIndex < ArrayCount(FlagsToCreate); ++FlagIndex)
+  {
+    NewEntities(EM, EntityCount / ArrayCount(FlagsToCreate), FlagsToCreate[FlagIndex], 0);
+  }
+
+  midx SnapshotByteSize = GetSnapshotByteSize(EM);
+  void* Snapshot = PushSize(Arena, SnapshotByteSize);
+  entity_manager* Restored = CreateBenchmarkEntityManager(4096);
+  // Once to fault in the pages of the snapshot and of the restored chunks
+  WriteSnapshot(EM, Snapshot, SnapshotByteSize);
+  RestoreSnapshot(Restored, Snapshot, SnapshotByteSize);
+
+  r64 Begin = GetWallClockSeconds();
+  WriteSnapshot(EM, Snapshot, SnapshotByteSize);
+  r64 WriteTime = GetWallClockSeconds() - Begin;
+  Begin = GetWallClockSeconds();
+  b32 Success = RestoreSnapshot(Restored, Snapshot, SnapshotByteSize);
+  r64 RestoreTime = GetWallClockSeconds() - Begin;
+  if(!Success || Restored->EntityCount != EM->EntityCount)
+  {
+    Platform.DEBUGPrint("Snapshot, %d entities: restore failed, %d entities restored\n", EM->EntityCount, Restored->EntityCount);
+    return;
+  }
+
+  Platform.DEBUGPrint("Snapshot, %d entities, %.1f MB:\n", EM->EntityCount, SnapshotByteSize / (1024.0 * 1024.0));
+  Platform.DEBUGPrint("  %-12s %12s\n", "", "ms");
+  Platform.DEBUGPrint("  %-12s %12.2f\n", "Write", WriteTime * 1000.0);
+  Platform.DEBUGPrint("  %-12s %12.2f\n", "Restore", RestoreTime * 1000.0);
+}
+
+// Benchmark suite with machine readable output, see entity_components_benchmark_main.cpp.
+// Every layout is run at 1e3, 1e4, ... entities up to MaxEntityCount. Results are written as JSON:
+//   {"chunk_byte_size": 16384, "runs": [{"layout": "mixed", "entity_count": 1000, "bytes_per_entity": 52.1,
+//     "ns_per_op": {"create": 80.2, ...}}, ...]}
+// ns_per_op is per entity except for get_entity_count_holding_types which is per call.
+struct benchmark_layout
+{
+  const char* Name;
+  bitmask32 RequiredFlags; // Held by every entity
+  bitmask32 RandomFlags;   // Each entity holds a random subset of these
+};
+
+struct benchmark_timer
+{
+  r64 Begin;
+};
+
+inline benchmark_timer StartTimer()
+{
+  benchmark_timer Result = {GetWallClockSeconds()};
+  return Result;
+}
+
+inline r64 GetNanoSecondsPerOp(benchmark_timer Timer, u64 OpCount)
+{
+  r64 Result = (GetWallClockSeconds() - Timer.Begin) * 1e9 / (r64) OpCount;
+  return Result;
+}
+
+// Memory held for the entities: the chunks in use and the entity slots
+internal r64 GetBytesPerEntity(entity_manager* EM)
+{
+  fragmentation_stats Stats = GetFragmentation(EM);
+  midx ByteSize = Stats.ChunkCount * (midx) ECS_ARCHETYPE_CHUNK_BYTE_SIZE + EM->EntitySlotCount * sizeof(entity);
+  r64 Result = EM->EntityCount ? ByteSize / (r64) EM->EntityCount : 0;
+  return Result;
+}
+
+internal void WriteBenchmarkRun(memory_arena* Arena, FILE* Output, benchmark_layout* Layout, u32 EntityCount, b32 FirstRun)
+{
+  ScopedMemory ScopedMem = ScopedMemory(Arena);
+  bench_random Random = {0x2468ace};
+  // Small runs are repeated so every measurement covers at least about a million operations
+  u32 RepeatCount = Maximum(1u, 1000000u / EntityCount);
+  u32 RoundCount = Maximum(1u, 100000u / EntityCount);
+
+  entity_manager* EM = CreateBenchmarkEntityManager(4096);
+  query* Query = RegisterQuery(EM, BENCH_COMPONENT_FLAG_A);
+  bitmask32* Flags = PushArray(Arena, EntityCount, bitmask32);
+  u32* RandomOrder = PushArray(Arena, EntityCount, u32);
+  entity_id* EntityIDs = PushArray(Arena, EntityCount, entity_id);
+  for(u32 Index = 0; Index < EntityCount; ++Index)
+  {
+    Flags[Index] = Layout->RequiredFlags | (NextRandom(&Random) & Layout->RandomFlags);
+    RandomOrder[Index] = Index;
+  }
+  for(u32 Index = EntityCount - 1; Index > 0; --Index)
+  {
+    u32 SwapIndex = NextRandom(&Random) % (Index + 1);
+    u32 Tmp = RandomOrder[Index];
+    RandomOrder[Index] = RandomOrder[SwapIndex];
+    RandomOrder[SwapIndex] = Tmp;
+  }
+
+  // One by one
+  r64 CreateTime = 0;
+  r64 DeleteTime = 0;
+  for(u32 Round = 0; Round < RoundCount; ++Round)
+  {
+    benchmark_timer Timer = StartTimer();
+    for(u32 Index = 0; Index < EntityCount; ++Index)
+    {
+      EntityIDs[Index] = NewEntity(EM, Flags[Index]);
+    }
+    CreateTime += GetNanoSecondsPerOp(Timer, EntityCount * (u64) RoundCount);
+    Timer = StartTimer();
+    for(u32 Index = 0; Index < EntityCount; ++Index)
+    {
+      DeleteEntity(EM, EntityIDs + RandomOrder[Index]);
+    }
+    DeleteTime += GetNanoSecondsPerOp(Timer, EntityCount * (u64) RoundCount);
+  }
+
+  // In bulk, one NewEntities call per distinct set of components
+  u32 SubsetCount = 0;
+  bitmask32 SubsetFlags[1 << BENCH_COMPONENT_TYPE_COUNT] = {};
+  u32 SubsetEntityCounts[1 << BENCH_COMPONENT_TYPE_COUNT] = {};
+  for(bitmask32 Subset = 0; ; Subset = (Subset - Layout->RandomFlags) & Layout->RandomFlags)
+  {
+    SubsetFlags[SubsetCount] = Layout->RequiredFlags | Subset;
+    for(u32 Index = 0; Index < EntityCount; ++Index)
+    {
+      SubsetEntityCounts[SubsetCount] += Flags[Index] == SubsetFlags[SubsetCount];
+    }
+    SubsetCount++;
+    if(Subset == Layout->RandomFlags)
+    {
+      break;
+    }
+  }
+
+  r64 BulkCreateTime = 0;
+  r64 BulkDeleteTime = 0;
+  for(u32 Round = 0; Round <= RoundCount; ++Round)
+  {
+    benchmark_timer Timer = StartTimer();
+    u32 CreatedCount = 0;
+    for(u32 SubsetIndex = 0; SubsetIndex < SubsetCount; ++SubsetIndex)
+    {
+      NewEntities(EM, SubsetEntityCounts[SubsetIndex], SubsetFlags[SubsetIndex], EntityIDs + CreatedCount);
+      CreatedCount += SubsetEntityCounts[SubsetIndex];
+    }
+    Assert(CreatedCount == EntityCount);
+    r64 Time = GetNanoSecondsPerOp(Timer, EntityCount * (u64) RoundCount);
+    if(Round == RoundCount)
+    {
+      // The last round keeps its entities for the lookups below
+      break;
+    }
+    BulkCreateTime += Time;
+    Timer = StartTimer();
+    DeleteEntities(EM, EntityCount, EntityIDs);
+    BulkDeleteTime += GetNanoSecondsPerOp(Timer, EntityCount * (u64) RoundCount);
+  }
+  r64 BytesPerEntity = GetBytesPerEntity(EM);
+
+  u64 Checksum = 0;
+  benchmark_timer Timer = StartTimer();
+  for(u32 Repeat = 0; Repeat < RepeatCount; ++Repeat)
+  {
+    for(u32 Index = 0; Index < EntityCount; ++Index)
+    {
+      Checksum += *(u32*) GetReadOnlyComponent(EM, EntityIDs + Index, BENCH_COMPONENT_FLAG_A);
+    }
+  }
+  r64 GetComponentLinearTime = GetNanoSecondsPerOp(Timer, EntityCount * (u64) RepeatCount);
+
+  Timer = StartTimer();
+  for(u32 Repeat = 0; Repeat < RepeatCount; ++Repeat)
+  {
+    for(u32 Index = 0; Index < EntityCount; ++Index)
+    {
+      Checksum += *(u32*) GetReadOnlyComponent(EM, EntityIDs + RandomOrder[Index], BENCH_COMPONENT_FLAG_A);
+    }
+  }
+  r64 GetComponentRandomTime = GetNanoSecondsPerOp(Timer, EntityCount * (u64) RepeatCount);
+
+  Timer = StartTimer();
+  for(u32 Repeat = 0; Repeat < RepeatCount; ++Repeat)
+  {
+    filtered_entity_iterator Iterator = GetComponentsOfType(EM, Query);
+    while(Next(&Iterator))
+    {
+      Checksum += *(u32*) GetComponent(EM, &Iterator, BENCH_COMPONENT_FLAG_A);
+    }
+  }
+  r64 IterateEntitiesTime = GetNanoSecondsPerOp(Timer, EntityCount * (u64) RepeatCount);
+
+  Timer = StartTimer();
+  for(u32 Repeat = 0; Repeat < RepeatCount; ++Repeat)
+  {
+    filtered_entity_iterator Iterator = GetComponentsOfType(EM, Query);
+    while(NextChunk(&Iterator))
+    {
+      bench_component_small* Components = (bench_component_small*) GetReadOnlyComponentArray(&Iterator, BENCH_COMPONENT_FLAG_A);
+      u32 ChunkEntityCount = GetChunkEntityCount(&Iterator);
+      for(u32 Index = 0; Index < ChunkEntityCount; ++Index)
+      {
+        Checksum += Components[Index].Value;
+      }
+    }
+  }
+  r64 IterateChunksTime = GetNanoSecondsPerOp(Timer, EntityCount * (u64) RepeatCount);
+
+  u32 CallCount = 100000;
+  Timer = StartTimer();
+  for(u32 Call = 0; Call < CallCount; ++Call)
+  {
+    Checksum += GetEntityCountHoldingTypes(EM, BENCH_COMPONENT_FLAG_A);
+  }
+  r64 GetEntityCountTime = GetNanoSecondsPerOp(Timer, CallCount);
+
+  entity_id* HoldingIDs = PushArray(Arena, EntityCount, entity_id);
+  Timer = StartTimer();
+  for(u32 Repeat = 0; Repeat < RepeatCount; ++Repeat)
+  {
+    GetEntitiesHoldingTypes(EM, BENCH_COMPONENT_FLAG_A, HoldingIDs);
+    Checksum += HoldingIDs[EntityCount - 1].SlotIndex;
+  }
+  r64 GetEntitiesTime = GetNanoSecondsPerOp(Timer, EntityCount * (u64) RepeatCount);
+
+  fprintf(Output, "%s\n    {\"layout\": \"%s\", \"entity_count\": %u, \"bytes_per_entity\": %.2f, \"checksum\": %llu,\n",
+          FirstRun ? "" : ",", Layout->Name, EntityCount, BytesPerEntity, (unsigned long long) Checksum);
+  fprintf(Output, "     \"ns_per_op\": {\"create\": %.2f, \"delete\": %.2f, \"create_bulk\": %.2f, \"delete_bulk\": %.2f,\n",
+          CreateTime, DeleteTime, BulkCreateTime, BulkDeleteTime);
+  fprintf(Output, "                   \"get_component_linear\": %.2f, \"get_component_random\": %.2f,\n",
+          GetComponentLinearTime, GetComponentRandomTime);
+  fprintf(Output, "                   \"iterate_entities\": %.2f, \"iterate_chunks\": %.2f,\n",
+          IterateEntitiesTime, IterateChunksTime);
+  fprintf(Output, "                   \"get_entity_count_holding_types\": %.2f, \"get_entities_holding_types\": %.2f}}",
+          GetEntityCountTime, GetEntitiesTime);
+  fflush(Output);
+}
+
+void RunBenchmarkSuite(memory_arena* Arena, u32 MaxEntityCount, FILE* Output)
+{
+  benchmark_layout Layouts[] =
+  {
+    {"small", BENCH_COMPONENT_FLAG_A, 0},
+    {"mixed", BENCH_COMPONENT_FLAG_A, BENCH_COMPONENT_FLAG_B | BENCH_COMPONENT_FLAG_C | BENCH_COMPONENT_FLAG_E | BENCH_COMPONENT_FLAG_F},
+    {"wide",  BENCH_COMPONENT_FLAG_A | BENCH_COMPONENT_FLAG_B | BENCH_COMPONENT_FLAG_E, 0},
+  };
+
+  fprintf(Output, "{\n  \"chunk_byte_size\": %d,\n  \"runs\": [", ECS_ARCHETYPE_CHUNK_BYTE_SIZE);
+  b32 FirstRun = true;
+  for(u32 LayoutIndex = 0; LayoutIndex < ArrayCount(Layouts); ++LayoutIndex)
+  {
+    for(u32 EntityCount = 1000; EntityCount <= MaxEntityCount; EntityCount *= 10)
+    {
+      WriteBenchmarkRun(Arena, Output, Layouts + LayoutIndex, EntityCount, FirstRun);
+      FirstRun = false;
+      if(EntityCount > U32Max / 10)
+      {
+        break;
+      }
+    }
+  }
+  fprintf(Output, "\n  ]\n}\n");
+}
+
+// Creates EntityCount entities holding B and D with the same values, once with NewEntities and a write per
+// component and once from a prefab
+void BenchmarkPrefab(memory_arena* Arena, u32 EntityCount)
+{
+  ScopedMemory ScopedMem = ScopedMemory(Arena);
+  entity_id* EntityIDs = PushArray(Arena, EntityCount, entity_id);
+  bench_component_medium Medium = {1, {1, 2, 3, 4, 5, 6, 7}};
+  bench_component_large Large = {2};
+  for(u32 DataIndex = 0; DataIndex < ArrayCount(Large.Data); ++DataIndex)
+  {
+    Large.Data[DataIndex] = (r32) DataIndex;
+  }
+
+  // The first pass of each touches the memory, the second one is timed on chunks and slots from the free lists
+  entity_manager* ByHandEM = CreateBenchmarkEntityManager(4096);
+  r64 ByHandTime = 0;
+  for(u32 Pass = 0; Pass < 2; ++Pass)
+  {
+    if(Pass)
+    {
+      DeleteEntities(ByHandEM, EntityCount, EntityIDs);
+    }
+    r64 Begin = GetWallClockSeconds();
+    NewEntities(ByHandEM, EntityCount, BENCH_COMPONENT_FLAG_B | BENCH_COMPONENT_FLAG_D, EntityIDs);
+    for(u32 Index = 0; Index < EntityCount; ++Index)
+    {
+      *(bench_component_medium*) GetComponent(ByHandEM, EntityIDs + Index, BENCH_COMPONENT_FLAG_B) = Medium;
+      *(bench_component_large*) GetComponent(ByHandEM, EntityIDs + Index, BENCH_COMPONENT_FLAG_D) = Large;
+    }
+    ByHandTime = GetWallClockSeconds() - Begin;
+  }
+
+  entity_manager* PrefabEM = CreateBenchmarkEntityManager(4096);
+  prefab* Prefab = CreatePrefab(PrefabEM, BENCH_COMPONENT_FLAG_B | BENCH_COMPONENT_FLAG_D);
+  *GetPrefabComponent<bench_component_medium>(Prefab) = Medium;
+  *GetPrefabComponent<bench_component_large>(Prefab) = Large;
+  r64 PrefabTime = 0;
+  for(u32 Pass = 0; Pass < 2; ++Pass)
+  {
+    if(Pass)
+    {
+      DeleteEntities(PrefabEM, EntityCount, EntityIDs);
+    }
+    r64 Begin = GetWallClockSeconds();
+    InstantiatePrefab(PrefabEM, Prefab, EntityCount, EntityIDs);
+    PrefabTime = GetWallClockSeconds() - Begin;
+  }
+
+  r64 Checksum = 0;
+  filtered_entity_iterator Iterator = GetComponentsOfType(PrefabEM, BENCH_COMPONENT_FLAG_D);
+  while(NextChunk(&Iterator))
+  {
+    Checksum += ((bench_component_large*) GetReadOnlyComponentArray(&Iterator, BENCH_COMPONENT_FLAG_D))[0].Data[30];
+  }
+
+  r64 NanoSeconds = 1e9 / EntityCount;
+  r64 ComponentBytes = (r64) EntityCount * (sizeof(bench_component_medium) + sizeof(bench_component_large));
+  Platform.DEBUGPrint("Prefab, %d entities:\n", EntityCount);
+  Platform.DEBUGPrint("  %-18s %12s %10s\n", "", "ns/entity", "GB/s");
+  Platform.DEBUGPrint("  %-18s %12.2f %10.2f\n", "NewEntities+write", ByHandTime * NanoSeconds, ComponentBytes / ByHandTime * 1e-9);
+  Platform.DEBUGPrint("  %-18s %12.2f %10.2f\n", "InstantiatePrefab", PrefabTime * NanoSeconds, ComponentBytes / PrefabTime * 1e-9);
+  Platform.DEBUGPrint("  Checksum %.0f\n", Checksum);
+}
+
+// One system of BenchmarkScheduler, stirs the first u32 of its component type
+struct benchmark_system
+{
+  query* Query;
+  component_signature ComponentFlag;
+  u32 ComponentSize;
+};
+
+internal ECS_PARALLEL_CHUNK_CALLBACK(BenchmarkSystemChunk)
+{
+  benchmark_system* System = (benchmark_system*) UserData;
+  u8* Components = (u8*) GetComponentArray(&Chunk->Iterator, System->ComponentFlag);
+  u32 EntityCount = GetChunkEntityCount(&Chunk->Iterator);
+  for(u32 Index = 0; Index < EntityCount; ++Index)
+  {
+    u32* Value = (u32*) (Components + Index * System->ComponentSize);
+    for(u32 Round = 0; Round < 32; ++Round)
+    {
+      *Value = *Value * 1664525u + 1013904223u;
+    }
+  }
+}
+
+internal ECS_SYSTEM_CALLBACK(BenchmarkSystem)
+{
+  benchmark_system* System = (benchmark_system*) UserData;
+  ParallelForEachChunk(Context->Pool, Context->EM, System->Query, BenchmarkSystemChunk, System);
+}
+
+// Runs one system per component type over EntityCount mixed entities. The systems are scheduled once
+// declaring only their own type, so they share a level, and once declaring all types, so they run one
+// after another each spreading its chunks over the pool.
+void BenchmarkScheduler(memory_arena* Arena, u32 EntityCount, u32 RepeatCount)
+{
+  ScopedMemory ScopedMem = ScopedMemory(Arena);
+  entity_manager* EM = CreateBenchmarkEntityManager(1024);
+  bench_random Random = {0x2468ace};
+  CreateMixedEntities(Arena, EM, EntityCount, &Random);
+
+  benchmark_system Systems[BENCH_COMPONENT_TYPE_COUNT] = {};
+  scheduler* Independent = CreateScheduler();
+  scheduler* Conflicting = CreateScheduler();
+  component_signature AllFlags = (1 << BENCH_COMPONENT_TYPE_COUNT) - 1;
+  u32 ComponentSizes[BENCH_COMPONENT_TYPE_COUNT] = {sizeof(bench_component_small), sizeof(bench_component_medium), sizeof(bench_component_small),
+                                                    sizeof(bench_component_large), sizeof(bench_component_medium), sizeof(bench_component_small)};
+  for(u32 TypeIndex = 0; TypeIndex < BENCH_COMPONENT_TYPE_COUNT; ++TypeIndex)
+  {
+    benchmark_system* System = Systems + TypeIndex;
+    System->ComponentFlag = 1 << TypeIndex;
+    System->ComponentSize = ComponentSizes[TypeIndex];
+    System->Query = RegisterQuery(EM, System->ComponentFlag);
+    AddSystem(Independent, "Independent", 0, System->ComponentFlag, BenchmarkSystem, System);
+    AddSystem(Conflicting, "Conflicting", 0, AllFlags, BenchmarkSystem, System);
+  }
+
+  worker_pool* Pool = CreateWorkerPool();
+  struct scheduler_run
+  {
+    const char* Name;
+    scheduler* Scheduler;
+    worker_pool* Pool;
+  } Runs[] =
+  {
+    {"No pool", Independent, 0},
+    {"Conflicting", Conflicting, Pool},
+    {"Independent", Independent, Pool},
+  };
+
+  Platform.DEBUGPrint("Scheduler, %d systems over %d entities, %d threads:\n", BENCH_COMPONENT_TYPE_COUNT, EntityCount, GetThreadCount(Pool));
+  Platform.DEBUGPrint("  %-12s %8s %12s %10s\n", "", "Levels", "ms/frame", "Speedup");
+  r64 SerialTime = 0;
+  for(u32 RunIndex = 0; RunIndex < ArrayCount(Runs); ++RunIndex)
+  {
+    scheduler_run* Run = Runs + RunIndex;
+    RunSystems(Run->Scheduler, EM, Run->Pool); // Warm up
+    r64 Begin = GetWallClockSeconds();
+    for(u32 Repeat = 0; Repeat < RepeatCount; ++Repeat)
+    {
+      RunSystems(Run->Scheduler, EM, Run->Pool);
+    }
+    r64 FrameTime = (GetWallClockSeconds() - Begin) / RepeatCount;
+    if(RunIndex == 0)
+    {
+      SerialTime = FrameTime;
+    }
+    scheduler_stats Stats = GetSchedulerStats(Run->Scheduler, 0);
+    Platform.DEBUGPrint("  %-12s %8d %12.3f %10.2f\n", Run->Name, Stats.LevelCount, FrameTime * 1000.0, SerialTime / FrameTime);
+  }
+  DestroyWorkerPool(Pool);
+}
+
+void RunBenchmarks(memory_arena* Arena)
+{
+  BenchmarkGetComponent(Arena, 100000, 10);
+  BenchmarkParallelForEach(Arena, 200000, 20);
+  BenchmarkBulkCreateDelete(Arena, 200000);
+  BenchmarkBulkLookup(Arena, 1000000, 5);
+  BenchmarkFilteredIteration(Arena, 1000000, 50, 5);
+  BenchmarkFilteredIteration(Arena, 1000000, 5, 5);
+  BenchmarkTypedQuery(Arena, 1000000, 5);
+  BenchmarkSnapshot(Arena, 1000000);
+  BenchmarkMoveEntities(Arena, 1000000);
+  BenchmarkScheduler(Arena, 20000, 200);
+  BenchmarkScheduler(Arena, 1000000, 10);
+  BenchmarkPrefab(Arena, 1000000);
+}
+
+}
@@ -1,7 +1,13 @@
 #include "entity_components_backend.h"
+#include "entity_components_parallel.h"
+#include "entity_components_commands.h"
+#include "entity_components_snapshot.h"
+#include "entity_components_typed_query.h"
+#include "entity_components_scheduler.h"
+#include <atomic>
 namespace entity_components_backend_tests
 {
-namespace ecs{
+using namespace ecs;
 
 enum component_type_test
 {
@@ -49,45 +55,50 @@ struct test_component_e
   u32 e;
 };
 
+}
+ECS_TYPED_COMPONENT(entity_components_backend_tests::test_component_a, entity_components_backend_tests::TEST_COMPONENT_FLAG_A);
+ECS_TYPED_COMPONENT(entity_components_backend_tests::test_component_b, entity_components_backend_tests::TEST_COMPONENT_FLAG_B);
+ECS_TYPED_COMPONENT(entity_components_backend_tests::test_component_c, entity_components_backend_tests::TEST_COMPONENT_FLAG_C);
+ECS_TYPED_COMPONENT(entity_components_backend_tests::test_component_d, entity_components_backend_tests::TEST_COMPONENT_FLAG_D);
+ECS_TYPED_COMPONENT(entity_components_backend_tests::test_component_e, entity_components_backend_tests::TEST_COMPONENT_FLAG_E);
+namespace entity_components_backend_tests
+{
+
 
 entity_manager* CreateEntityManager(u32 EntityChunkCount, u32 ChunkSizeA, u32 ChunkSizeB, u32 ChunkSizeC, u32 ChunkSizeD, u32 ChunkSizeE)
 {
   entity_manager_definition Definitions[] =
   {
-    {TEST_COMPONENT_FLAG_A, COMPONENT_FLAG_NONE,   ChunkSizeA, sizeof(test_component_a)},
-    {TEST_COMPONENT_FLAG_B, COMPONENT_FLAG_NONE,   ChunkSizeB, sizeof(test_component_b)},
+    {TEST_COMPONENT_FLAG_A, TEST_COMPONENT_FLAG_NONE,   ChunkSizeA, sizeof(test_component_a)},
+    {TEST_COMPONENT_FLAG_B, TEST_COMPONENT_FLAG_NONE,   ChunkSizeB, sizeof(test_component_b)},
     {TEST_COMPONENT_FLAG_C, TEST_COMPONENT_FLAG_A, ChunkSizeC, sizeof(test_component_c)},
-    {TEST_COMPONENT_FLAG_D, COMPONENT_FLAG_NONE,   ChunkSizeD, sizeof(test_component_d)},
+    {TEST_COMPONENT_FLAG_D, TEST_COMPONENT_FLAG_NONE,   ChunkSizeD, sizeof(test_component_d)},
     {TEST_COMPONENT_FLAG_E, TEST_COMPONENT_FLAG_C, ChunkSizeE, sizeof(test_component_e)}
   }; 
   
-  entity_manager* Result = CreateEntityManager(EntityChunkCount, EntityChunkCount, ArrayCount(Definitions), Definitions);
+  entity_manager* Result = CreateEntityManager(EntityChunkCount, ArrayCount(Definitions), Definitions);
 
   Assert(Result->ComponentTypeCount == ArrayCount(Definitions));
-  Assert(GetCapacity(&(Result->EntityList)) == EntityChunkCount);
-  Assert(GetCapacity(&(Result->EntityComponentLinks)) == EntityChunkCount);
-  Assert(GetCapacity(&Result->ComponentTypeVector[0].Components) == ChunkSizeA);
-  Assert(GetCapacity(&Result->ComponentTypeVector[1].Components) == ChunkSizeB);
-  Assert(GetCapacity(&Result->ComponentTypeVector[2].Components) == ChunkSizeC);
-  Assert(GetCapacity(&Result->ComponentTypeVector[3].Components) == ChunkSizeD);
-  Assert(GetCapacity(&Result->ComponentTypeVector[4].Components) == ChunkSizeE);
-  Assert(GetBlockCount(&Result->ComponentTypeVector[0].Components) == 0);
-  Assert(GetBlockCount(&Result->ComponentTypeVector[1].Components) == 0);
-  Assert(GetBlockCount(&Result->ComponentTypeVector[2].Components) == 0);
-  Assert(GetBlockCount(&Result->ComponentTypeVector[3].Components) == 0);
-  Assert(GetBlockCount(&Result->ComponentTypeVector[4].Components) == 0);
+  Assert((1u << Result->EntitySlotPageSizeLog2) >= EntityChunkCount);
+  Assert(Result->EntitySlotCount == 0);
+  Assert(GetBlockCount(&Result->Archetypes) == 0);
+  Assert(Result->ComponentTypeVector[0].ComponentChunkCount == ChunkSizeA);
+  Assert(Result->ComponentTypeVector[1].ComponentChunkCount == ChunkSizeB);
+  Assert(Result->ComponentTypeVector[2].ComponentChunkCount == ChunkSizeC);
+  Assert(Result->ComponentTypeVector[3].ComponentChunkCount == ChunkSizeD);
+  Assert(Result->ComponentTypeVector[4].ComponentChunkCount == ChunkSizeE);
 
   return Result;
 }
 
 void AssertComponentCounts(entity_manager* EntityManager, u32 EntityCount, u32 ACount, u32 BCount, u32 CCount, u32 DCount, u32 ECount)
 {
-  Assert(GetBlockCount(&EntityManager->EntityList) == EntityCount);
-  Assert(GetBlockCount(&EntityManager->ComponentTypeVector[0].Components) == ACount);
-  Assert(GetBlockCount(&EntityManager->ComponentTypeVector[1].Components) == BCount);
-  Assert(GetBlockCount(&EntityManager->ComponentTypeVector[2].Components) == CCount);
-  Assert(GetBlockCount(&EntityManager->ComponentTypeVector[3].Components) == DCount);
-  Assert(GetBlockCount(&EntityManager->ComponentTypeVector[4].Components) == ECount);
+  Assert(EntityManager->EntityCount == EntityCount);
+  Assert(GetEntityCountHoldingTypes(EntityManager, TEST_COMPONENT_FLAG_A) == ACount);
+  Assert(GetEntityCountHoldingTypes(EntityManager, TEST_COMPONENT_FLAG_B) == BCount);
+  Assert(GetEntityCountHoldingTypes(EntityManager, TEST_COMPONENT_FLAG_C) == CCount);
+  Assert(GetEntityCountHoldingTypes(EntityManager, TEST_COMPONENT_FLAG_D) == DCount);
+  Assert(GetEntityCountHoldingTypes(EntityManager, TEST_COMPONENT_FLAG_E) == ECount);
 }
 
 void RunUnitTestsA(memory_arena* Arena)
@@ -114,12 +125,15 @@ void RunUnitTestsA(memory_arena* Arena)
       NewComponents(EntityManager, &EntityID, TEST_COMPONENT_FLAG_A);
       test_component_a* A = (test_component_a*) GetComponent(EntityManager, &EntityID, TEST_COMPONENT_FLAG_A);
       EntityIDs[i] = EntityID;
-      A->a = EntityID.EntityID;
+      A->a = EntityID.SlotIndex + 1; // Entities are numbered from 1 in the diagrams
     }
     AssertComponentCounts(EntityManager, 9,9,0,0,0,0);
-    // Capacity is the number of chunks needed to hold all allocated components. In our case ChunkSizeA x 5 = 10;
-    Assert(GetCapacity(&EntityManager->ComponentTypeVector[0].Components) == ComponentCountA+1);
-    Assert(GetBlockCount(&EntityManager->ComponentTypeVector[0].Components) == ComponentCountA);
+    // All entities share the archetype 'a'. Each chunk holds ChunkSizeA entities so we need 5 chunks to hold 9 entities.
+    archetype* ArchetypeA = GetArchetype(EntityManager, TEST_COMPONENT_FLAG_A);
+    Assert(ArchetypeA);
+    Assert(ArchetypeA->ChunkCapacity == ChunkSizeA);
+    Assert(ArchetypeA->ChunkCount == 5);
+    Assert(ArchetypeA->EntityCount == ComponentCountA);
   }
 
   {
@@ -135,7 +149,7 @@ void RunUnitTestsA(memory_arena* Arena)
       test_component_d* D =  (test_component_d*) GetComponent(EntityManager, EntityID, TEST_COMPONENT_FLAG_D);
       test_component_e* E =  (test_component_e*) GetComponent(EntityManager, EntityID, TEST_COMPONENT_FLAG_E);
       Assert(A);
-      Assert(A->a == EntityID->EntityID);
+      Assert(A->a == EntityID->SlotIndex + 1);
       Assert(!B);
       Assert(!C);
       Assert(!D);
@@ -166,7 +180,7 @@ void RunUnitTestsA(memory_arena* Arena)
       Assert(!E);
 
       entity_id* EntityID = EntityIDs + index++;
-      Assert(A->a == EntityID->EntityID);
+      Assert(A->a == EntityID->SlotIndex + 1);
     }
     Assert(index == ComponentCountA);
   }
@@ -271,7 +285,7 @@ void RunUnitTestsA(memory_arena* Arena)
     {
       // Adding new entity with component b
       entity_id Entity11 = NewEntity( EntityManager );
-      Assert(Entity11.EntityID == 11);
+      Assert(Entity11.SlotIndex == 10);
       NewComponents(EntityManager, &Entity11, TEST_COMPONENT_FLAG_B);
       AssertComponentCounts(EntityManager,11,10,2,1,1,1);
       test_component_a* A =  (test_component_a*) GetComponent(EntityManager, &Entity11, TEST_COMPONENT_FLAG_A);
@@ -293,7 +307,7 @@ void RunUnitTestsA(memory_arena* Arena)
     {
       // Adding component b to entity 2
       entity_id* Entity2 = EntityIDs + 1;
-      Assert(Entity2->EntityID == 2);
+      Assert(Entity2->SlotIndex == 1);
       NewComponents(EntityManager, Entity2, TEST_COMPONENT_FLAG_B);
       AssertComponentCounts(EntityManager,11,10,3,1,1,1);
       test_component_a* A =  (test_component_a*) GetComponent(EntityManager, Entity2, TEST_COMPONENT_FLAG_A);
@@ -398,11 +412,11 @@ void RunUnitTestsA(memory_arena* Arena)
       GetEntitiesHoldingTypes(EntityManager, TEST_COMPONENT_FLAG_B | TEST_COMPONENT_FLAG_A, Entities);
       // Entities are gathererd in the order of when the components were added. 
       // Component B was the smalles common component list and Entity 10 got its component before component 2.
-      Assert(Entities[0].EntityID == 10);
-      Assert(Entities[0].ChunkListIndex == 9);
+      Assert(Entities[0].SlotIndex == 9);
+      Assert(Entities[0].Generation == 1);
       Entity10 = Entities[0];
-      Assert(Entities[1].EntityID == 2);
-      Assert(Entities[1].ChunkListIndex == 1);
+      Assert(Entities[1].SlotIndex == 1);
+      Assert(Entities[1].Generation == 1);
       Entity2 = Entities[1];
       AssertComponentCounts(EntityManager,11,10,3,1,1,1);
       while(EntityCount--)
@@ -421,6 +435,8 @@ void RunUnitTestsA(memory_arena* Arena)
       // 
       DeleteEntity(EntityManager, &Entity2);
       AssertComponentCounts(EntityManager,10,8,1,0,1,0);
+      Assert(!IsAlive(EntityManager, &Entity2));
+      Assert(!TryGetComponent(EntityManager, &Entity2, TEST_COMPONENT_FLAG_A));
       Assert(GetEntityCountHoldingTypes(EntityManager, TEST_COMPONENT_FLAG_D) == 1);
       Assert(GetEntityCountHoldingTypes(EntityManager, TEST_COMPONENT_FLAG_B) == 1);
 
@@ -432,8 +448,13 @@ void RunUnitTestsA(memory_arena* Arena)
       //                                d
       //                e
       entity_id Entity = NewEntity(EntityManager, TEST_COMPONENT_FLAG_E);
-      Assert(Entity.EntityID == 12);
-      Assert(Entity.ChunkListIndex == 1);
+      // The slot of entity 2 is reused with a new generation
+      Assert(Entity.SlotIndex == 1);
+      Assert(Entity.Generation == 2);
+      Assert(!IsAlive(EntityManager, &Entity2));
+      Assert(!Compare(&Entity, &Entity2));
+      Assert(IsAlive(EntityManager, &Entity));
+      Assert(TryGetComponent(EntityManager, &Entity, TEST_COMPONENT_FLAG_E) == GetComponent(EntityManager, &Entity, TEST_COMPONENT_FLAG_E));
       Assert(GetComponent(EntityManager, &Entity, TEST_COMPONENT_FLAG_A) != 0);
       Assert(GetComponent(EntityManager, &Entity, TEST_COMPONENT_FLAG_B) == 0);
       Assert(GetComponent(EntityManager, &Entity, TEST_COMPONENT_FLAG_C) != 0);
@@ -457,16 +478,1807 @@ void RunUnitTestsA(memory_arena* Arena)
     GetEntitiesHoldingTypes(EntityManager, TEST_COMPONENT_FLAG_A, Entities);
     DeleteEntities(EntityManager, 9, Entities);
     AssertComponentCounts(EntityManager,2,0,1,0,1,0);
-    Assert(GetBlockCount(&EntityManager->EntityList) == 2);
-    Assert(GetBlockCount(&EntityManager->EntityComponentLinks) == 2);
+    Assert(EntityManager->EntityCount == 2);
+    Assert(EntityManager->EntitySlotCount == 11);
+    Assert(GetArchetype(EntityManager, TEST_COMPONENT_FLAG_A)->ChunkCount == 0);
+    Assert(GetArchetype(EntityManager, TEST_COMPONENT_FLAG_B)->EntityCount == 1);
+    Assert(GetArchetype(EntityManager, TEST_COMPONENT_FLAG_D)->EntityCount == 1);
+  }
+
+}
+
+
+void RunUnitTestsB(memory_arena* Arena)
+{
+  // Testing that entities keep their data when they move between archetypes and when
+  // other entities are removed from their chunk
+  ScopedMemory ScopedMem = ScopedMemory(Arena);
+  entity_manager* EntityManager = CreateEntityManager(16, 4, 4, 4, 4, 4);
+  const u32 EntityCount = 64;
+  entity_id* EntityIDs = PushArray(Arena, EntityCount, entity_id);
+  for(u32 i = 0; i < EntityCount; i++)
+  {
+    EntityIDs[i] = NewEntity(EntityManager, TEST_COMPONENT_FLAG_A);
+    test_component_a* A = (test_component_a*) GetComponent(EntityManager, EntityIDs + i, TEST_COMPONENT_FLAG_A);
+    A->a = i;
+  }
+  Assert(GetArchetype(EntityManager, TEST_COMPONENT_FLAG_A)->ChunkCount == EntityCount / 4);
+
+  // Every other entity moves to archetype 'ac'
+  for(u32 i = 0; i < EntityCount; i += 2)
+  {
+    NewComponents(EntityManager, EntityIDs + i, TEST_COMPONENT_FLAG_C);
+    test_component_c* C = (test_component_c*) GetComponent(EntityManager, EntityIDs + i, TEST_COMPONENT_FLAG_C);
+    Assert(C->a == 0 && C->b == 0 && C->c == 0); // New components are zero initialized
+    C->c = i;
+  }
+  AssertComponentCounts(EntityManager, EntityCount, EntityCount, 0, EntityCount/2, 0, 0);
+
+  // Delete every third entity
+  u32 DeletedCount = 0;
+  for(u32 i = 0; i < EntityCount; i += 3)
+  {
+    DeleteEntity(EntityManager, EntityIDs + i);
+    EntityIDs[i] = {};
+    DeletedCount++;
+  }
+
+  for(u32 i = 0; i < EntityCount; i++)
+  {
+    if(!IsValid(EntityIDs + i))
+    {
+      continue;
+    }
+    test_component_a* A = (test_component_a*) GetComponent(EntityManager, EntityIDs + i, TEST_COMPONENT_FLAG_A);
+    test_component_c* C = (test_component_c*) GetComponent(EntityManager, EntityIDs + i, TEST_COMPONENT_FLAG_C);
+    Assert(A->a == i);
+    Assert((i % 2 == 0) == (C != 0));
+    Assert(!C || C->c == i);
+    entity_id OwnerID = GetEntityIDFromComponent((bptr) A);
+    Assert(Compare(EntityIDs + i, &OwnerID));
+  }
+
+  // Iterating chunk wise visits each remaining entity once
+  u32 VisitedCount = 0;
+  filtered_entity_iterator Iterator = GetComponentsOfType(EntityManager, TEST_COMPONENT_FLAG_A | TEST_COMPONENT_FLAG_C);
+  while(NextChunk(&Iterator))
+  {
+    test_component_a* A = (test_component_a*) GetComponentArray(&Iterator, TEST_COMPONENT_FLAG_A);
+    test_component_c* C = (test_component_c*) GetComponentArray(&Iterator, TEST_COMPONENT_FLAG_C);
+    Assert(!GetComponentArray(&Iterator, TEST_COMPONENT_FLAG_B));
+    for(u32 i = 0; i < GetChunkEntityCount(&Iterator); i++)
+    {
+      Assert(A[i].a == C[i].c);
+      VisitedCount++;
+    }
+  }
+  Assert(VisitedCount == GetEntityCountHoldingTypes(EntityManager, TEST_COMPONENT_FLAG_A | TEST_COMPONENT_FLAG_C));
+
+  // Removing all components frees the chunks which are then reused by the next archetype
+  for(u32 i = 0; i < EntityCount; i++)
+  {
+    if(IsValid(EntityIDs + i))
+    {
+      DeleteComponents(EntityManager, EntityIDs + i, TEST_COMPONENT_FLAG_A);
+      Assert(!HasOneOfComponents(EntityManager, EntityIDs + i, TEST_COMPONENT_FLAG_A | TEST_COMPONENT_FLAG_C));
+    }
+  }
+  AssertComponentCounts(EntityManager, EntityCount - DeletedCount, 0, 0, 0, 0, 0);
+  Assert(GetArchetype(EntityManager, TEST_COMPONENT_FLAG_A)->ChunkCount == 0);
+  Assert(GetArchetype(EntityManager, TEST_COMPONENT_FLAG_A | TEST_COMPONENT_FLAG_C)->ChunkCount == 0);
+
+  // Spawning and despawning reuses slots, the slot table does not grow
+  u32 SlotCount = EntityManager->EntitySlotCount;
+  for(u32 Round = 0; Round < 8; Round++)
+  {
+    entity_id Spawned[16];
+    for(u32 i = 0; i < ArrayCount(Spawned); i++)
+    {
+      Spawned[i] = NewEntity(EntityManager, TEST_COMPONENT_FLAG_B);
+      Assert(Spawned[i].SlotIndex < SlotCount);
+    }
+    DeleteEntities(EntityManager, ArrayCount(Spawned), Spawned);
+    for(u32 i = 0; i < ArrayCount(Spawned); i++)
+    {
+      Assert(!IsAlive(EntityManager, Spawned + i));
+    }
+  }
+  Assert(EntityManager->EntitySlotCount == SlotCount);
+  AssertComponentCounts(EntityManager, EntityCount - DeletedCount, 0, 0, 0, 0, 0);
+}
+
+void RunUnitTestsC(memory_arena* Arena)
+{
+  // Testing component types beyond bit 32 and across the 64 bit words of component_signature
+  ScopedMemory ScopedMem = ScopedMemory(Arena);
+  const u32 ComponentTypeCount = 72;
+  entity_manager_definition Definitions[ComponentTypeCount] = {};
+  for(u32 i = 0; i < ComponentTypeCount; i++)
+  {
+    Definitions[i].ComponentFlag = ComponentFlagFromIndex(i);
+    Definitions[i].RequirementsFlag = TEST_COMPONENT_FLAG_NONE;
+    Definitions[i].ComponentByteSize = sizeof(test_component_a);
+  }
+  // 65 requires 70 which requires 3
+  Definitions[65].RequirementsFlag = ComponentFlagFromIndex(70);
+  Definitions[70].RequirementsFlag = ComponentFlagFromIndex(3);
+  entity_manager* EntityManager = CreateEntityManager(16, ComponentTypeCount, Definitions);
+
+  component_signature Low = TEST_COMPONENT_FLAG_A | TEST_COMPONENT_FLAG_D;
+  component_signature High = ComponentFlagFromIndex(64) | ComponentFlagFromIndex(71);
+  Assert(GetSetBitCount(Low | High) == 4);
+  Assert(IsEmpty(Low & High));
+  Assert(HasAll(Low | High, High));
+  Assert(!HasAll(Low, Low | High));
+  Assert(HasAny(Low | High, ComponentFlagFromIndex(71)));
+  Assert(AndNot(Low | High, Low) == High);
+  Assert((~Low & Low) == TEST_COMPONENT_FLAG_NONE);
+  Assert(GetSetBitCountBelow(Low | High, 71) == 3);
+
+  entity_id Required = NewEntity(EntityManager, ComponentFlagFromIndex(65));
+  Assert(HasComponents(EntityManager, &Required, ComponentFlagFromIndex(3) | ComponentFlagFromIndex(65) | ComponentFlagFromIndex(70)));
+  Assert(!HasOneOfComponents(EntityManager, &Required, High));
+
+  u32 TypesToAdd[] = {0, 31, 32, 63, 64, 71};
+  entity_id Wide = NewEntity(EntityManager);
+  for(u32 i = 0; i < ArrayCount(TypesToAdd); i++)
+  {
+    NewComponents(EntityManager, &Wide, ComponentFlagFromIndex(TypesToAdd[i]));
+    test_component_a* A = (test_component_a*) GetComponent(EntityManager, &Wide, ComponentFlagFromIndex(TypesToAdd[i]));
+    A->a = TypesToAdd[i];
+  }
+  for(u32 i = 0; i < ArrayCount(TypesToAdd); i++)
+  {
+    test_component_a* A = (test_component_a*) GetComponent(EntityManager, &Wide, ComponentFlagFromIndex(TypesToAdd[i]));
+    Assert(A->a == TypesToAdd[i]);
+    entity_id OwnerID = GetEntityIDFromComponent((bptr) A);
+    Assert(Compare(&OwnerID, &Wide));
+  }
+  Assert(GetComponent(EntityManager, &Wide, ComponentFlagFromIndex(65)) == 0);
+
+  Assert(GetEntityCountHoldingTypes(EntityManager, ComponentFlagFromIndex(64)) == 1);
+  Assert(GetEntityCountHoldingTypes(EntityManager, ComponentFlagFromIndex(70)) == 1);
+  Assert(GetEntityCountHoldingTypes(EntityManager, TEST_COMPONENT_FLAG_A) == 1);
+
+  filtered_entity_iterator Iterator = GetComponentsOfType(EntityManager, ComponentFlagFromIndex(32) | ComponentFlagFromIndex(71));
+  u32 VisitedCount = 0;
+  while(Next(&Iterator))
+  {
+    test_component_a* A = (test_component_a*) GetComponent(EntityManager, &Iterator, ComponentFlagFromIndex(71));
+    Assert(A->a == 71);
+    VisitedCount++;
+  }
+  Assert(VisitedCount == 1);
+
+  // Removing 3 cascades to 70 and 65
+  DeleteComponents(EntityManager, &Required, ComponentFlagFromIndex(3));
+  Assert(!HasOneOfComponents(EntityManager, &Required, ComponentFlagFromIndex(65) | ComponentFlagFromIndex(70)));
+  DeleteComponents(EntityManager, &Wide, ComponentFlagFromIndex(32));
+  Assert(HasComponents(EntityManager, &Wide, ComponentFlagFromIndex(31) | ComponentFlagFromIndex(63)));
+  Assert(((test_component_a*) GetComponent(EntityManager, &Wide, ComponentFlagFromIndex(63)))->a == 63);
+}
+
+u32 CountQueryEntities(entity_manager* EntityManager, query* Query)
+{
+  u32 Result = 0;
+  filtered_entity_iterator Iterator = GetComponentsOfType(EntityManager, Query);
+  while(NextChunk(&Iterator))
+  {
+    Result += GetChunkEntityCount(&Iterator);
+  }
+  return Result;
+}
+
+void RunUnitTestsD(memory_arena* Arena)
+{
+  // Testing that registered queries pick up archetypes created both before and after registration
+  ScopedMemory ScopedMem = ScopedMemory(Arena);
+  entity_manager* EntityManager = CreateEntityManager(16, 4, 4, 4, 4, 4);
+  query* QueryB = RegisterQuery(EntityManager, TEST_COMPONENT_FLAG_B);
+  query* QueryAD = RegisterQuery(EntityManager, TEST_COMPONENT_FLAG_A | TEST_COMPONENT_FLAG_D);
+  Assert(RegisterQuery(EntityManager, TEST_COMPONENT_FLAG_B) == QueryB);
+  Assert(QueryB->ArchetypeCount == 0);
+  Assert(CountQueryEntities(EntityManager, QueryB) == 0);
+
+  // Archetypes: b, ab, abd, ad, d
+  bitmask32 Flags[] =
+  {
+    TEST_COMPONENT_FLAG_B,
+    TEST_COMPONENT_FLAG_A | TEST_COMPONENT_FLAG_B,
+    TEST_COMPONENT_FLAG_A | TEST_COMPONENT_FLAG_B | TEST_COMPONENT_FLAG_D,
+    TEST_COMPONENT_FLAG_A | TEST_COMPONENT_FLAG_D,
+    TEST_COMPONENT_FLAG_D
+  };
+  entity_id EntityIDs[ArrayCount(Flags) * 3] = {};
+  for(u32 i = 0; i < ArrayCount(EntityIDs); i++)
+  {
+    EntityIDs[i] = NewEntity(EntityManager, Flags[i % ArrayCount(Flags)]);
+  }
+  Assert(QueryB->ArchetypeCount == 3);
+  Assert(QueryAD->ArchetypeCount == 2);
+  Assert(CountQueryEntities(EntityManager, QueryB) == 9);
+  Assert(CountQueryEntities(EntityManager, QueryAD) == 6);
+
+  // A query registered late sees the same archetypes
+  query* QueryD = RegisterQuery(EntityManager, TEST_COMPONENT_FLAG_D);
+  Assert(QueryD->ArchetypeCount == 3);
+  Assert(CountQueryEntities(EntityManager, QueryD) == 9);
+  Assert(CountQueryEntities(EntityManager, QueryD) == GetEntityCountHoldingTypes(EntityManager, TEST_COMPONENT_FLAG_D));
+
+  // Adding and removing components moves entities between the archetypes of the queries
+  DeleteComponents(EntityManager, EntityIDs + 0, TEST_COMPONENT_FLAG_B);
+  NewComponents(EntityManager, EntityIDs + 4, TEST_COMPONENT_FLAG_A);
+  Assert(CountQueryEntities(EntityManager, QueryB) == 8);
+  Assert(CountQueryEntities(EntityManager, QueryAD) == 7);
+  Assert(CountQueryEntities(EntityManager, QueryD) == 9);
+
+  // Emptied archetypes stay in the query but have no chunks to visit
+  for(u32 i = 0; i < ArrayCount(EntityIDs); i++)
+  {
+    DeleteEntity(EntityManager, EntityIDs + i);
+  }
+  Assert(QueryB->ArchetypeCount == 3);
+  Assert(CountQueryEntities(EntityManager, QueryB) == 0);
+  Assert(CountQueryEntities(EntityManager, QueryAD) == 0);
+}
+
+struct parallel_test_job
+{
+  u32* ChunkVisits;
+  u32* EntityValues;
+};
+
+internal ECS_PARALLEL_CHUNK_CALLBACK(ParallelTestCallback)
+{
+  parallel_test_job* Job = (parallel_test_job*) UserData;
+  test_component_a* A = (test_component_a*) GetComponentArray(&Chunk->Iterator, TEST_COMPONENT_FLAG_A);
+  test_component_c* C = (test_component_c*) GetComponentArray(&Chunk->Iterator, TEST_COMPONENT_FLAG_C);
+  u32* Scratch = PushArray(Chunk->ScratchArena, GetChunkEntityCount(&Chunk->Iterator), u32);
+  for(u32 i = 0; i < GetChunkEntityCount(&Chunk->Iterator); i++)
+  {
+    Scratch[i] = A[i].a;
+    C[i].c = A[i].a * 2;
+  }
+  for(u32 i = 0; i < GetChunkEntityCount(&Chunk->Iterator); i++)
+  {
+    Job->EntityValues[Chunk->FirstEntityIndex + i] = Scratch[i];
+  }
+  Job->ChunkVisits[Chunk->ChunkIndex]++;
+}
+
+void RunUnitTestsE(memory_arena* Arena)
+{
+  // Testing that ParallelForEachChunk visits every chunk of a query once, with and without workers
+  ScopedMemory ScopedMem = ScopedMemory(Arena);
+  entity_manager* EntityManager = CreateEntityManager(64, 4, 4, 4, 4, 4);
+  const u32 EntityCount = 1000;
+  for(u32 i = 0; i < EntityCount; i++)
+  {
+    entity_id EntityID = NewEntity(EntityManager, (i % 3) ? TEST_COMPONENT_FLAG_C : (TEST_COMPONENT_FLAG_C | TEST_COMPONENT_FLAG_B));
+    ((test_component_a*) GetComponent(EntityManager, &EntityID, TEST_COMPONENT_FLAG_A))->a = i + 1;
+  }
+  query* Query = RegisterQuery(EntityManager, TEST_COMPONENT_FLAG_A | TEST_COMPONENT_FLAG_C);
+  u32 ChunkCount = 0;
+  for(u32 i = 0; i < Query->ArchetypeCount; i++)
+  {
+    ChunkCount += Query->Archetypes[i]->ChunkCount;
+  }
+  Assert(ChunkCount >= EntityCount / 4); // At most 4 entities per chunk
+
+  u32 WorkerCounts[] = {0, 1, 3};
+  for(u32 PoolIndex = 0; PoolIndex < ArrayCount(WorkerCounts) + 1; PoolIndex++)
+  {
+    worker_pool* Pool = PoolIndex < ArrayCount(WorkerCounts) ? CreateWorkerPool(WorkerCounts[PoolIndex]) : 0;
+    Assert(GetThreadCount(Pool) == (Pool ? WorkerCounts[PoolIndex] + 1 : 1));
+    parallel_test_job Job = {};
+    Job.ChunkVisits = PushArray(Arena, ChunkCount, u32);
+    Job.EntityValues = PushArray(Arena, EntityCount, u32);
+    Assert(ParallelForEachChunk(Pool, EntityManager, Query, ParallelTestCallback, &Job) == EntityCount);
+    for(u32 i = 0; i < ChunkCount; i++)
+    {
+      Assert(Job.ChunkVisits[i] == 1);
+    }
+
+    // Every entity wrote its value to its own slot
+    u32* ValueCount = PushArray(Arena, EntityCount + 1, u32);
+    for(u32 i = 0; i < EntityCount; i++)
+    {
+      Assert(Job.EntityValues[i] > 0 && Job.EntityValues[i] <= EntityCount);
+      ValueCount[Job.EntityValues[i]]++;
+    }
+    for(u32 i = 1; i <= EntityCount; i++)
+    {
+      Assert(ValueCount[i] == 1);
+    }
+    if(Pool)
+    {
+      DestroyWorkerPool(Pool);
+    }
+  }
+
+  filtered_entity_iterator Iterator = GetComponentsOfType(EntityManager, Query);
+  while(Next(&Iterator))
+  {
+    test_component_a* A = (test_component_a*) GetComponent(EntityManager, &Iterator, TEST_COMPONENT_FLAG_A);
+    test_component_c* C = (test_component_c*) GetComponent(EntityManager, &Iterator, TEST_COMPONENT_FLAG_C);
+    Assert(C->c == A->a * 2);
+  }
+}
+
+internal ECS_PARALLEL_CHUNK_CALLBACK(CommandBufferTestCallback)
+{
+  command_buffer* Buffer = (command_buffer*) UserData;
+  test_component_a* A = (test_component_a*) GetComponentArray(&Chunk->Iterator, TEST_COMPONENT_FLAG_A);
+  for(u32 i = 0; i < GetChunkEntityCount(&Chunk->Iterator); i++)
+  {
+    entity_id EntityID = GetEntityIDFromComponent((bptr) (A + i));
+    switch(A[i].a % 3)
+    {
+      case 0: DeferDeleteEntity(Buffer, &EntityID); break;
+      case 1: DeferNewComponents(Buffer, &EntityID, TEST_COMPONENT_FLAG_E); break;
+      case 2: DeferDeleteComponents(Buffer, &EntityID, TEST_COMPONENT_FLAG_A); break;
+    }
+  }
+}
+
+void RunUnitTestsF(memory_arena* Arena)
+{
+  // Testing that a command_buffer recorded from worker threads applies the same changes as the immediate calls
+  ScopedMemory ScopedMem = ScopedMemory(Arena);
+  entity_manager* EntityManager = CreateEntityManager(64, 4, 4, 4, 4, 4);
+  const u32 EntityCount = 300;
+  entity_id EntityIDs[EntityCount] = {};
+  for(u32 i = 0; i < EntityCount; i++)
+  {
+    EntityIDs[i] = NewEntity(EntityManager, (i % 2) ? TEST_COMPONENT_FLAG_A : (TEST_COMPONENT_FLAG_A | TEST_COMPONENT_FLAG_B));
+    ((test_component_a*) GetComponent(EntityManager, EntityIDs + i, TEST_COMPONENT_FLAG_A))->a = i + 1;
+  }
+
+  command_buffer* Buffer = CreateCommandBuffer();
+  worker_pool* Pool = CreateWorkerPool(3);
+  query* Query = RegisterQuery(EntityManager, TEST_COMPONENT_FLAG_A);
+  Assert(ParallelForEachChunk(Pool, EntityManager, Query, CommandBufferTestCallback, Buffer) == EntityCount);
+  DestroyWorkerPool(Pool);
+
+  // Nothing changes until the buffer is applied
+  Assert(GetCommandCount(Buffer) == EntityCount);
+  AssertComponentCounts(EntityManager, EntityCount, EntityCount, EntityCount / 2, 0, 0, 0);
+
+  // Pending entities can be used by later commands of the same buffer
+  entity_id PendingACD = DeferNewEntity(Buffer, TEST_COMPONENT_FLAG_C);
+  DeferNewComponents(Buffer, &PendingACD, TEST_COMPONENT_FLAG_D);
+  entity_id PendingDeleted = DeferNewEntity(Buffer, TEST_COMPONENT_FLAG_B);
+  DeferDeleteEntity(Buffer, &PendingDeleted);
+  entity_id PendingEmpty = DeferNewEntity(Buffer, TEST_COMPONENT_FLAG_NONE);
+  Assert(!IsAlive(EntityManager, &PendingACD));
+
+  // Commands on entities deleted before the sync point are ignored
+  entity_id Stale = NewEntity(EntityManager, TEST_COMPONENT_FLAG_D);
+  DeferNewComponents(Buffer, &Stale, TEST_COMPONENT_FLAG_B);
+  DeleteEntity(EntityManager, &Stale);
+
+  // Commands on one entity apply in record order
+  entity_id Ordered = NewEntity(EntityManager, TEST_COMPONENT_FLAG_D);
+  DeferDeleteComponents(Buffer, &Ordered, TEST_COMPONENT_FLAG_D);
+  DeferNewComponents(Buffer, &Ordered, TEST_COMPONENT_FLAG_B);
+  DeferDeleteComponents(Buffer, &Ordered, TEST_COMPONENT_FLAG_B);
+  DeferNewComponents(Buffer, &Ordered, TEST_COMPONENT_FLAG_C);
+
+  ApplyCommandBuffer(EntityManager, Buffer);
+  Assert(GetCommandCount(Buffer) == 0);
+
+  u32 AliveCount = 0;
+  for(u32 i = 0; i < EntityCount; i++)
+  {
+    entity_id* EntityID = EntityIDs + i;
+    b32 HasB = (i % 2) == 0;
+    switch((i + 1) % 3)
+    {
+      case 0:
+      {
+        Assert(!IsAlive(EntityManager, EntityID));
+      }break;
+      case 1:
+      {
+        Assert(HasComponents(EntityManager, EntityID, TEST_COMPONENT_FLAG_A | TEST_COMPONENT_FLAG_C | TEST_COMPONENT_FLAG_E));
+        Assert(((test_component_a*) GetComponent(EntityManager, EntityID, TEST_COMPONENT_FLAG_A))->a == i + 1);
+        Assert((GetComponent(EntityManager, EntityID, TEST_COMPONENT_FLAG_B) != 0) == HasB);
+        AliveCount++;
+      }break;
+      case 2:
+      {
+        Assert(IsAlive(EntityManager, EntityID));
+        Assert(!GetComponent(EntityManager, EntityID, TEST_COMPONENT_FLAG_A));
+        Assert((GetComponent(EntityManager, EntityID, TEST_COMPONENT_FLAG_B) != 0) == HasB);
+        AliveCount++;
+      }break;
+    }
+  }
+
+  entity_id ACD = GetAppliedEntityID(Buffer, &PendingACD);
+  Assert(IsAlive(EntityManager, &ACD));
+  Assert(HasComponents(EntityManager, &ACD, TEST_COMPONENT_FLAG_A | TEST_COMPONENT_FLAG_C | TEST_COMPONENT_FLAG_D));
+  entity_id Deleted = GetAppliedEntityID(Buffer, &PendingDeleted);
+  Assert(!IsValid(&Deleted));
+  entity_id Empty = GetAppliedEntityID(Buffer, &PendingEmpty);
+  Assert(IsAlive(EntityManager, &Empty));
+  Assert(!HasOneOfComponents(EntityManager, &Empty, TEST_COMPONENT_FLAG_A | TEST_COMPONENT_FLAG_B));
+  Assert(!IsAlive(EntityManager, &Stale));
+  Assert(HasComponents(EntityManager, &Ordered, TEST_COMPONENT_FLAG_A | TEST_COMPONENT_FLAG_C));
+  Assert(!HasOneOfComponents(EntityManager, &Ordered, TEST_COMPONENT_FLAG_B | TEST_COMPONENT_FLAG_D));
+  Assert(EntityManager->EntityCount == AliveCount + 3);
+
+  // The buffer can be reused after it has been applied
+  DeferDeleteEntity(Buffer, &ACD);
+  ApplyCommandBuffer(EntityManager, Buffer);
+  Assert(!IsAlive(EntityManager, &ACD));
+  Assert(EntityManager->EntityCount == AliveCount + 2);
+  DestroyCommandBuffer(Buffer);
+}
+
+void RunUnitTestsG(memory_arena* Arena)
+{
+  // Testing bulk creation and deletion against the single entity versions
+  ScopedMemory ScopedMem = ScopedMemory(Arena);
+  entity_manager* EntityManager = CreateEntityManager(64, 4, 4, 4, 4, 4);
+
+  // Fills the chunk left partially used by the single entity first, then whole chunks
+  entity_id Single = NewEntity(EntityManager, TEST_COMPONENT_FLAG_E | TEST_COMPONENT_FLAG_B);
+  const u32 EntityCount = 103;
+  entity_id EntityIDs[EntityCount] = {};
+  NewEntities(EntityManager, EntityCount, TEST_COMPONENT_FLAG_E | TEST_COMPONENT_FLAG_B, EntityIDs);
+  AssertComponentCounts(EntityManager, EntityCount + 1, EntityCount + 1, EntityCount + 1, EntityCount + 1, 0, EntityCount + 1);
+  query* Query = RegisterQuery(EntityManager, TEST_COMPONENT_FLAG_E);
+  Assert(Query->ArchetypeCount == 1);
+  Assert(Query->Archetypes[0]->ChunkCount == (EntityCount + 1 + 3) / 4);
+  for(u32 i = 0; i < EntityCount; i++)
+  {
+    Assert(IsAlive(EntityManager, EntityIDs + i));
+    test_component_e* E = (test_component_e*) GetComponent(EntityManager, EntityIDs + i, TEST_COMPONENT_FLAG_E);
+    Assert(E->a == 0 && E->e == 0);
+    entity_id FromComponent = GetEntityIDFromComponent((bptr) E);
+    Assert(Compare(EntityIDs + i, &FromComponent));
+    E->a = i + 1;
+  }
+
+  // Entities without components and no output array
+  NewEntities(EntityManager, 5, TEST_COMPONENT_FLAG_NONE, 0);
+  Assert(EntityManager->EntityCount == EntityCount + 6);
+
+  // Delete every other entity, then whole chunks
+  entity_id ToDelete[EntityCount] = {};
+  u32 DeleteCount = 0;
+  for(u32 i = 0; i < EntityCount; i += 2)
+  {
+    ToDelete[DeleteCount++] = EntityIDs[i];
+  }
+  DeleteEntities(EntityManager, DeleteCount, ToDelete);
+  Assert(EntityManager->EntityCount == EntityCount + 6 - DeleteCount);
+  for(u32 i = 0; i < EntityCount; i++)
+  {
+    if(i % 2)
+    {
+      test_component_e* E = (test_component_e*) GetComponent(EntityManager, EntityIDs + i, TEST_COMPONENT_FLAG_E);
+      Assert(E->a == i + 1);
+    }else{
+      Assert(!IsAlive(EntityManager, EntityIDs + i));
+    }
+  }
+
+  DeleteCount = 0;
+  for(u32 i = 1; i < EntityCount; i += 2)
+  {
+    ToDelete[DeleteCount++] = EntityIDs[i];
+  }
+  ToDelete[DeleteCount++] = Single;
+  DeleteEntities(EntityManager, DeleteCount, ToDelete);
+  Assert(EntityManager->EntityCount == 5);
+  Assert(GetEntityCount(Query) == 0);
+  Assert(Query->Archetypes[0]->ChunkCount == 0);
+
+  // Freed slots are reused by the next batch
+  u32 SlotCount = EntityManager->EntitySlotCount;
+  NewEntities(EntityManager, EntityCount, TEST_COMPONENT_FLAG_A, EntityIDs);
+  Assert(EntityManager->EntitySlotCount == SlotCount);
+  Assert(GetEntityCountHoldingTypes(EntityManager, TEST_COMPONENT_FLAG_A) == EntityCount);
+}
+
+void RunUnitTestsH(memory_arena* Arena)
+{
+  // Testing requirement closures deeper than one level
+  ScopedMemory ScopedMem = ScopedMemory(Arena);
+  const u32 ComponentTypeCount = 8;
+  entity_manager_definition Definitions[ComponentTypeCount] = {};
+  for(u32 i = 0; i < ComponentTypeCount; i++)
+  {
+    Definitions[i].ComponentFlag = ComponentFlagFromIndex(i);
+    Definitions[i].RequirementsFlag = TEST_COMPONENT_FLAG_NONE;
+    Definitions[i].ComponentByteSize = sizeof(test_component_a);
+  }
+  // 0 -> 1 -> 2 -> 3 -> 4 -> 5 -> 6, and 7 requires both 3 and 6
+  for(u32 i = 0; i < 6; i++)
+  {
+    Definitions[i].RequirementsFlag = ComponentFlagFromIndex(i + 1);
+  }
+  Definitions[7].RequirementsFlag = ComponentFlagFromIndex(3) | ComponentFlagFromIndex(6);
+  entity_manager* EntityManager = CreateEntityManager(16, ComponentTypeCount, Definitions);
+
+  component_signature Chain = {};
+  for(u32 i = 0; i < 7; i++)
+  {
+    Chain = Chain | ComponentFlagFromIndex(i);
+  }
+  component_signature All = Chain | ComponentFlagFromIndex(7);
+
+  entity_id EntityID = NewEntity(EntityManager, ComponentFlagFromIndex(0));
+  Assert(HasComponents(EntityManager, &EntityID, Chain));
+  Assert(!HasOneOfComponents(EntityManager, &EntityID, ComponentFlagFromIndex(7)));
+  NewComponents(EntityManager, &EntityID, ComponentFlagFromIndex(7));
+  Assert(HasComponents(EntityManager, &EntityID, All));
+
+  // Everything requires 6
+  DeleteComponents(EntityManager, &EntityID, ComponentFlagFromIndex(6));
+  Assert(!HasOneOfComponents(EntityManager, &EntityID, All));
+
+  // 0-3 require 4 through the chain, 7 through 3. 5 and 6 are left.
+  EntityID = NewEntity(EntityManager, ComponentFlagFromIndex(0) | ComponentFlagFromIndex(7));
+  DeleteComponents(EntityManager, &EntityID, ComponentFlagFromIndex(4));
+  Assert(HasComponents(EntityManager, &EntityID, ComponentFlagFromIndex(5) | ComponentFlagFromIndex(6)));
+  Assert(!HasOneOfComponents(EntityManager, &EntityID, AndNot(All, ComponentFlagFromIndex(5) | ComponentFlagFromIndex(6))));
+
+  // Removing a component nothing requires only removes itself
+  EntityID = NewEntity(EntityManager, All);
+  DeleteComponents(EntityManager, &EntityID, ComponentFlagFromIndex(7));
+  Assert(HasComponents(EntityManager, &EntityID, Chain));
+  Assert(!HasOneOfComponents(EntityManager, &EntityID, ComponentFlagFromIndex(7)));
+}
+
+void RunUnitTestsI(memory_arena* Arena)
+{
+  // Testing that incremental compaction packs chunks within its budget and keeps entities intact
+  ScopedMemory ScopedMem = ScopedMemory(Arena);
+  entity_manager* EntityManager = CreateEntityManager(64, 4, 4, 4, 4, 4);
+  const u32 EntityCount = 400;
+  entity_id EntityIDs[EntityCount] = {};
+  NewEntities(EntityManager, EntityCount, TEST_COMPONENT_FLAG_A | TEST_COMPONENT_FLAG_B, EntityIDs);
+  for(u32 i = 0; i < EntityCount; i++)
+  {
+    ((test_component_a*) GetComponent(EntityManager, EntityIDs + i, TEST_COMPONENT_FLAG_A))->a = i + 1;
+    ((test_component_b*) GetComponent(EntityManager, EntityIDs + i, TEST_COMPONENT_FLAG_B))->b = i + 1;
+  }
+
+  compaction_result Result = CompactChunks(EntityManager, 1024);
+  Assert(Result.Done && Result.EntitiesMoved == 0);
+  Assert(Result.Before.ChunkCount == EntityCount / 4);
+  Assert(Result.Before.ChunkCount == Result.Before.MinimumChunkCount);
+
+  // Leave one entity in every chunk
+  for(u32 i = 0; i < EntityCount; i++)
+  {
+    if(i % 4)
+    {
+      DeleteEntity(EntityManager, EntityIDs + i);
+    }
+  }
+  fragmentation_stats Fragmented = GetFragmentation(EntityManager);
+  Assert(Fragmented.ChunkCount == EntityCount / 4);
+  Assert(Fragmented.MinimumChunkCount == EntityCount / 16);
+  Assert(Fragmented.EntityRowCount == EntityCount / 4);
+  Assert(Fragmented.RowCapacity == EntityCount);
+
+  // Ten rows worth of budget per call
+  midx RowByteSize = sizeof(test_component_a) + sizeof(test_component_b);
+  u32 CallCount = 0;
+  u32 ChunksReleased = 0;
+  do
+  {
+    Result = CompactChunks(EntityManager, 10 * RowByteSize);
+    Assert(Result.BytesMoved <= 10 * RowByteSize);
+    Assert(Result.After.ChunkCount == Result.Before.ChunkCount - Result.ChunksReleased);
+    ChunksReleased += Result.ChunksReleased;
+    CallCount++;
+  }while(!Result.Done);
+  Assert(CallCount > 1);
+  Assert(Result.After.ChunkCount == Result.After.MinimumChunkCount);
+  Assert(Result.After.FreeChunkCount == Fragmented.FreeChunkCount + ChunksReleased);
+  Assert(ChunksReleased == Fragmented.ChunkCount - Fragmented.MinimumChunkCount);
+
+  for(u32 i = 0; i < EntityCount; i += 4)
+  {
+    test_component_a* A = (test_component_a*) GetComponent(EntityManager, EntityIDs + i, TEST_COMPONENT_FLAG_A);
+    test_component_b* B = (test_component_b*) GetComponent(EntityManager, EntityIDs + i, TEST_COMPONENT_FLAG_B);
+    Assert(A->a == i + 1 && B->b == i + 1);
+    entity_id FromComponent = GetEntityIDFromComponent((bptr) B);
+    Assert(Compare(EntityIDs + i, &FromComponent));
+  }
+  Assert(CountQueryEntities(EntityManager, RegisterQuery(EntityManager, TEST_COMPONENT_FLAG_B)) == EntityCount / 4);
+}
+
+internal u32 CountChangedEntities(entity_manager* EM, query* Query, change_filter Filter)
+{
+  u32 Result = 0;
+  filtered_entity_iterator Iterator = GetChangedComponentsOfType(EM, Query, Filter);
+  while(Next(&Iterator))
+  {
+    Result++;
+  }
+  return Result;
+}
+
+// A parallel_chunk_callback that only counts the chunks, Chunk is left unnamed
+internal void CountChunkCallback(parallel_chunk*, void* UserData)
+{
+  (*(u32*) UserData)++;
+}
+
+void RunUnitTestsJ(memory_arena* Arena)
+{
+  // Testing per chunk change versions and the change filters of iterators and ParallelForEachChunk
+  ScopedMemory ScopedMem = ScopedMemory(Arena);
+  entity_manager* EntityManager = CreateEntityManager(64, 4, 4, 4, 4, 4);
+  const u32 EntityCount = 40;
+  entity_id EntityIDs[EntityCount] = {};
+  NewEntities(EntityManager, EntityCount, TEST_COMPONENT_FLAG_A | TEST_COMPONENT_FLAG_B, EntityIDs);
+  query* Query = RegisterQuery(EntityManager, TEST_COMPONENT_FLAG_A | TEST_COMPONENT_FLAG_B);
+
+  // New entities count as changes
+  u32 Since = AdvanceChangeVersion(EntityManager);
+  Assert(Since > 0);
+  change_filter ChangedA = {TEST_COMPONENT_FLAG_A, 0};
+  Assert(CountChangedEntities(EntityManager, Query, ChangedA) == EntityCount);
+
+  // Nothing written since
+  ChangedA.SinceVersion = Since;
+  change_filter ChangedB = {TEST_COMPONENT_FLAG_B, Since};
+  change_filter ChangedAB = {TEST_COMPONENT_FLAG_A | TEST_COMPONENT_FLAG_B, Since};
+  Assert(CountChangedEntities(EntityManager, Query, ChangedAB) == 0);
+  u32 ChunkCount = 0;
+  Assert(ParallelForEachChunk(0, EntityManager, Query, ChangedAB, CountChunkCallback, &ChunkCount) == 0);
+  Assert(ChunkCount == 0);
+
+  // Reading doesn't count
+  Assert(GetReadOnlyComponent(EntityManager, EntityIDs + 5, TEST_COMPONENT_FLAG_A));
+  filtered_entity_iterator Iterator = GetComponentsOfType(EntityManager, Query);
+  while(NextChunk(&Iterator))
+  {
+    Assert(GetReadOnlyComponentArray(&Iterator, TEST_COMPONENT_FLAG_B));
+  }
+  Assert(CountChangedEntities(EntityManager, Query, ChangedAB) == 0);
+
+  // A write marks the array of one chunk, four entities per chunk
+  ((test_component_a*) GetComponent(EntityManager, EntityIDs + 5, TEST_COMPONENT_FLAG_A))->a = 5;
+  Assert(CountChangedEntities(EntityManager, Query, ChangedA) == 4);
+  Assert(CountChangedEntities(EntityManager, Query, ChangedB) == 0);
+  Assert(CountChangedEntities(EntityManager, Query, ChangedAB) == 4);
+  Assert(ParallelForEachChunk(0, EntityManager, Query, ChangedA, CountChunkCallback, &ChunkCount) == 4);
+  Assert(ChunkCount == 1);
+
+  // A system only sees what was written after its last run
+  Since = AdvanceChangeVersion(EntityManager);
+  ChangedAB.SinceVersion = Since;
+  Assert(CountChangedEntities(EntityManager, Query, ChangedAB) == 0);
+  Iterator = GetComponentsOfType(EntityManager, Query);
+  NextChunk(&Iterator);
+  Assert(GetComponentArray(&Iterator, TEST_COMPONENT_FLAG_B));
+  // Removing the last row of a chunk leaves the other rows as they are, removing the first moves the last one
+  DeleteEntity(EntityManager, EntityIDs + 39);
+  DeleteEntity(EntityManager, EntityIDs + 32);
+  Assert(CountChangedEntities(EntityManager, Query, ChangedAB) == 4 + 3);
+
+  // Entities without any change filter are all visited
+  Assert(CountChangedEntities(EntityManager, Query, change_filter{}) == EntityCount - 2);
+}
+
+void RunUnitTestsK(memory_arena* Arena)
+{
+  // Testing components stored as one array per field
+  ScopedMemory ScopedMem = ScopedMemory(Arena);
+  u32 FieldByteSizes[] = {sizeof(u32), sizeof(u32), sizeof(u32)};
+  entity_manager_definition Definitions[] =
+  {
+    {TEST_COMPONENT_FLAG_A, TEST_COMPONENT_FLAG_NONE, 4, sizeof(test_component_a)},
+    {TEST_COMPONENT_FLAG_B, TEST_COMPONENT_FLAG_NONE, 4, sizeof(test_component_b)},
+    {TEST_COMPONENT_FLAG_C, TEST_COMPONENT_FLAG_A,    4, sizeof(test_component_c), ArrayCount(FieldByteSizes), FieldByteSizes},
+  };
+  entity_manager* EntityManager = CreateEntityManager(64, ArrayCount(Definitions), Definitions);
+  Assert(EntityManager->ComponentTypeVector[0].FieldCount == 1);
+  Assert(EntityManager->ComponentTypeVector[2].FieldCount == 3);
+
+  const u32 EntityCount = 16;
+  entity_id EntityIDs[EntityCount] = {};
+  NewEntities(EntityManager, EntityCount, TEST_COMPONENT_FLAG_C, EntityIDs);
+  for(u32 i = 0; i < EntityCount; i++)
+  {
+    for(u32 FieldIndex = 0; FieldIndex < 3; FieldIndex++)
+    {
+      u32* Field = (u32*) GetComponentField(EntityManager, EntityIDs + i, TEST_COMPONENT_FLAG_C, FieldIndex);
+      Assert(*Field == 0);
+      *Field = 100 * FieldIndex + i;
+    }
+  }
+
+  // Each field is its own packed array within the chunk
+  query* Query = RegisterQuery(EntityManager, TEST_COMPONENT_FLAG_C);
+  filtered_entity_iterator Iterator = GetComponentsOfType(EntityManager, Query);
+  u32 VisitedCount = 0;
+  while(NextChunk(&Iterator))
+  {
+    u32* Fields[3] = {};
+    for(u32 FieldIndex = 0; FieldIndex < 3; FieldIndex++)
+    {
+      Fields[FieldIndex] = (u32*) GetReadOnlyComponentFieldArray(&Iterator, TEST_COMPONENT_FLAG_C, FieldIndex);
+    }
+    Assert(Fields[1] >= Fields[0] + 4 && Fields[2] >= Fields[1] + 4);
+    for(u32 Row = 0; Row < GetChunkEntityCount(&Iterator); Row++)
+    {
+      entity_id ID = GetEntityIDFromComponent((bptr) (Fields[2] + Row));
+      u32 i = ID.SlotIndex - EntityIDs[0].SlotIndex;
+      Assert(Compare(&ID, EntityIDs + i));
+      Assert(Fields[0][Row] == i && Fields[1][Row] == 100 + i && Fields[2][Row] == 200 + i);
+      VisitedCount++;
+    }
+  }
+  Assert(VisitedCount == EntityCount);
+
+  // Fields survive archetype moves, deletes and compaction
+  for(u32 i = 0; i < EntityCount; i += 2)
+  {
+    NewComponents(EntityManager, EntityIDs + i, TEST_COMPONENT_FLAG_B);
+  }
+  for(u32 i = 0; i < EntityCount; i += 3)
+  {
+    DeleteEntity(EntityManager, EntityIDs + i);
+  }
+  CompactChunks(EntityManager, 1024);
+  for(u32 i = 0; i < EntityCount; i++)
+  {
+    if(i % 3 == 0)
+    {
+      Assert(!IsAlive(EntityManager, EntityIDs + i));
+      continue;
+    }
+    for(u32 FieldIndex = 0; FieldIndex < 3; FieldIndex++)
+    {
+      u32* Field = (u32*) GetReadOnlyComponentField(EntityManager, EntityIDs + i, TEST_COMPONENT_FLAG_C, FieldIndex);
+      Assert(*Field == 100 * FieldIndex + i);
+    }
   }
 
+  // Removing the component and adding it back zeroes every field
+  DeleteComponents(EntityManager, EntityIDs + 1, TEST_COMPONENT_FLAG_C);
+  NewComponents(EntityManager, EntityIDs + 1, TEST_COMPONENT_FLAG_C);
+  for(u32 FieldIndex = 0; FieldIndex < 3; FieldIndex++)
+  {
+    Assert(*(u32*) GetReadOnlyComponentField(EntityManager, EntityIDs + 1, TEST_COMPONENT_FLAG_C, FieldIndex) == 0);
+  }
+  Assert(CountQueryEntities(EntityManager, Query) == EntityCount - 6);
 }
 
+void RunUnitTestsL(memory_arena* Arena)
+{
+  // Testing that a snapshot restores the same entities, ids and components
+  ScopedMemory ScopedMem = ScopedMemory(Arena);
+  entity_manager* EntityManager = CreateEntityManager(16, 4, 8, 0, 0, 0);
+  const u32 EntityCount = 100;
+  entity_id EntityIDs[EntityCount] = {};
+  for(u32 i = 0; i < EntityCount; i++)
+  {
+    bitmask32 Flags = (i % 3 == 0) ? TEST_COMPONENT_FLAG_A : TEST_COMPONENT_FLAG_B | TEST_COMPONENT_FLAG_E;
+    EntityIDs[i] = NewEntity(EntityManager, Flags);
+    if(i % 3 == 0)
+    {
+      ((test_component_a*) GetComponent(EntityManager, EntityIDs + i, TEST_COMPONENT_FLAG_A))->a = i;
+    }else{
+      ((test_component_b*) GetComponent(EntityManager, EntityIDs + i, TEST_COMPONENT_FLAG_B))->b = i;
+      ((test_component_e*) GetComponent(EntityManager, EntityIDs + i, TEST_COMPONENT_FLAG_E))->e = 2 * i;
+    }
+  }
+  for(u32 i = 0; i < EntityCount; i += 7)
+  {
+    DeleteEntity(EntityManager, EntityIDs + i);
+  }
+  u32 LiveCount = EntityManager->EntityCount;
+
+  midx SnapshotByteSize = GetSnapshotByteSize(EntityManager);
+  Assert(WriteSnapshot(EntityManager, PushSize(Arena, 16), 16) == 0);
+  u8* Snapshot = (u8*) PushSize(Arena, SnapshotByteSize);
+  Assert(WriteSnapshot(EntityManager, Snapshot, SnapshotByteSize) == SnapshotByteSize);
+
+  // Restored into a new entity_manager and over the changed original
+  entity_manager* Restored = CreateEntityManager(64, 4, 8, 0, 0, 0);
+  NewEntities(Restored, 10, TEST_COMPONENT_FLAG_D, 0);
+  Assert(RestoreSnapshot(Restored, Snapshot, SnapshotByteSize));
+  NewEntities(EntityManager, 10, TEST_COMPONENT_FLAG_D, 0);
+  DeleteEntity(EntityManager, EntityIDs + 1);
+  Assert(RestoreSnapshot(EntityManager, Snapshot, SnapshotByteSize));
+
+  entity_manager* Managers[] = {Restored, EntityManager};
+  for(u32 ManagerIndex = 0; ManagerIndex < ArrayCount(Managers); ManagerIndex++)
+  {
+    entity_manager* EM = Managers[ManagerIndex];
+    Assert(EM->EntityCount == LiveCount);
+    for(u32 i = 0; i < EntityCount; i++)
+    {
+      if(i % 7 == 0)
+      {
+        Assert(!IsAlive(EM, EntityIDs + i));
+        continue;
+      }
+      Assert(IsAlive(EM, EntityIDs + i));
+      if(i % 3 == 0)
+      {
+        Assert(((test_component_a*) GetReadOnlyComponent(EM, EntityIDs + i, TEST_COMPONENT_FLAG_A))->a == i);
+        Assert(!HasComponents(EM, EntityIDs + i, TEST_COMPONENT_FLAG_B));
+      }else{
+        test_component_b* B = (test_component_b*) GetReadOnlyComponent(EM, EntityIDs + i, TEST_COMPONENT_FLAG_B);
+        Assert(B->b == i);
+        Assert(((test_component_e*) GetReadOnlyComponent(EM, EntityIDs + i, TEST_COMPONENT_FLAG_E))->e == 2 * i);
+        entity_id FromComponent = GetEntityIDFromComponent((bptr) B);
+        Assert(Compare(EntityIDs + i, &FromComponent));
+      }
+    }
+    Assert(GetEntityCountHoldingTypes(EM, TEST_COMPONENT_FLAG_D) == 0);
+    Assert(GetEntityCountHoldingTypes(EM, TEST_COMPONENT_FLAG_C) == GetEntityCountHoldingTypes(EM, TEST_COMPONENT_FLAG_E));
+    filtered_entity_iterator Iterator = GetComponentsOfType(EM, TEST_COMPONENT_FLAG_A);
+    u32 Count = 0;
+    while(Next(&Iterator))
+    {
+      Count++;
+    }
+    Assert(Count == GetEntityCountHoldingTypes(EM, TEST_COMPONENT_FLAG_A));
+  }
+
+  // Both reuse the same free slots and keep working like the original
+  entity_id NewA = NewEntity(Restored, TEST_COMPONENT_FLAG_B);
+  entity_id NewB = NewEntity(EntityManager, TEST_COMPONENT_FLAG_B);
+  Assert(Compare(&NewA, &NewB));
+  Assert(NewA.SlotIndex == EntityIDs[98].SlotIndex);
+  DeleteEntity(Restored, EntityIDs + 2);
+  NewEntities(Restored, 20, TEST_COMPONENT_FLAG_E, 0);
+  Assert(Restored->EntityCount == LiveCount + 20);
+
+  // Snapshots of other component types are refused and leave the entity_manager alone
+  entity_manager* Other = CreateEntityManager(64, 4, 4, 4, 4, 4);
+  entity_id OtherID = NewEntity(Other, TEST_COMPONENT_FLAG_A);
+  Assert(!RestoreSnapshot(Other, Snapshot, SnapshotByteSize));
+  Assert(!RestoreSnapshot(Restored, Snapshot, SnapshotByteSize - 1));
+  Snapshot[0]++;
+  Assert(!RestoreSnapshot(Restored, Snapshot, SnapshotByteSize));
+  Snapshot[0]--;
+
+  // So are snapshots whose slots or rows don't add up
+  snapshot_header* Header = (snapshot_header*) Snapshot;
+  snapshot_slot* Slots = (snapshot_slot*) (Snapshot + Header->SlotsOffset);
+  archetype_chunk* FirstBlob = (archetype_chunk*) (Snapshot + Header->ChunksOffset);
+  Slots[EntityIDs[1].SlotIndex].Generation++;
+  Assert(!RestoreSnapshot(Restored, Snapshot, SnapshotByteSize));
+  Slots[EntityIDs[1].SlotIndex].Generation--;
+  FirstBlob->EntityCount += 1000;
+  Assert(!RestoreSnapshot(Restored, Snapshot, SnapshotByteSize));
+  FirstBlob->EntityCount -= 1000;
+  u32 FirstBlobEntityCount = FirstBlob->EntityCount;
+  FirstBlob->EntityCount = 0;
+  Assert(!RestoreSnapshot(Restored, Snapshot, SnapshotByteSize));
+  FirstBlob->EntityCount = FirstBlobEntityCount;
+  Header->EntityCount++;
+  Assert(!RestoreSnapshot(Restored, Snapshot, SnapshotByteSize));
+  Header->EntityCount--;
+
+  // A row listed twice, a row of a free slot and a free list running in a cycle
+  snapshot_archetype* FirstArchetype = (snapshot_archetype*) (Snapshot + Header->ArchetypesOffset);
+  entity_id* FirstBlobIDs = (entity_id*) (((bptr) FirstBlob) + GetArchetype(Restored, FirstArchetype->ComponentFlags)->EntitiesByteOffset);
+  entity_id SecondRow = FirstBlobIDs[1];
+  FirstBlobIDs[1] = FirstBlobIDs[0];
+  Assert(!RestoreSnapshot(Restored, Snapshot, SnapshotByteSize));
+  u32 FreeSlot = Header->FirstFreeEntitySlot;
+  FirstBlobIDs[1].SlotIndex = FreeSlot;
+  FirstBlobIDs[1].Generation = Slots[FreeSlot].Generation;
+  Assert(!RestoreSnapshot(Restored, Snapshot, SnapshotByteSize));
+  FirstBlobIDs[1] = SecondRow;
+  u32 NextFreeSlot = Slots[FreeSlot].NextFreeSlot;
+  u32 NextNextFreeSlot = Slots[NextFreeSlot].NextFreeSlot;
+  Slots[NextFreeSlot].NextFreeSlot = FreeSlot;
+  Assert(!RestoreSnapshot(Restored, Snapshot, SnapshotByteSize));
+  Slots[NextFreeSlot].NextFreeSlot = NextNextFreeSlot;
+  Assert(RestoreSnapshot(Restored, Snapshot, SnapshotByteSize) && Restored->EntityCount == LiveCount);
+  NewEntities(Restored, 20, TEST_COMPONENT_FLAG_E, 0);
+
+  Header->FirstFreeEntitySlot = Header->EntitySlotCount;
+  Assert(!RestoreSnapshot(Restored, Snapshot, SnapshotByteSize));
+  Assert(IsAlive(Other, &OtherID) && Other->EntityCount == 1);
+  Assert(Restored->EntityCount == LiveCount + 20);
+}
+
+void RunUnitTestsM(memory_arena* Arena)
+{
+  // Testing components with several instances per entity
+  ScopedMemory ScopedMem = ScopedMemory(Arena);
+  entity_manager_definition Definitions[] =
+  {
+    {TEST_COMPONENT_FLAG_A, TEST_COMPONENT_FLAG_NONE, 0, sizeof(test_component_a)},
+    {TEST_COMPONENT_FLAG_B, TEST_COMPONENT_FLAG_NONE, 0, sizeof(test_component_b)},
+    {TEST_COMPONENT_FLAG_C, TEST_COMPONENT_FLAG_NONE, 0, sizeof(test_component_c), 0, 0, 4},
+  };
+  entity_manager* EntityManager = CreateEntityManager(64, ArrayCount(Definitions), Definitions);
+
+  const u32 EntityCount = 10;
+  entity_id EntityIDs[EntityCount] = {};
+  NewEntities(EntityManager, EntityCount, TEST_COMPONENT_FLAG_A, EntityIDs);
+  u32 InstanceCount = 1;
+  Assert(!GetReadOnlyComponentInstances(EntityManager, EntityIDs, TEST_COMPONENT_FLAG_C, &InstanceCount));
+  Assert(InstanceCount == 0);
+
+  // Entity i gets i % 5 instances, the fifth doesn't fit
+  for(u32 i = 0; i < EntityCount; i++)
+  {
+    for(u32 j = 0; j < i % 5; j++)
+    {
+      test_component_c* C = (test_component_c*) AddComponentInstance(EntityManager, EntityIDs + i, TEST_COMPONENT_FLAG_C);
+      if(j == 4)
+      {
+        Assert(!C);
+        continue;
+      }
+      Assert(C && C->a == 0);
+      C->a = i;
+      C->b = j;
+    }
+  }
+  Assert(GetEntityCountHoldingTypes(EntityManager, TEST_COMPONENT_FLAG_C) == 8);
+
+  // The instances of an entity are contiguous and keep their order through archetype moves
+  NewComponents(EntityManager, EntityIDs + 3, TEST_COMPONENT_FLAG_B);
+  DeleteEntity(EntityManager, EntityIDs + 1);
+  for(u32 i = 2; i < EntityCount; i++)
+  {
+    test_component_c* C = (test_component_c*) GetReadOnlyComponentInstances(EntityManager, EntityIDs + i, TEST_COMPONENT_FLAG_C, &InstanceCount);
+    Assert(InstanceCount == Minimum(i % 5, 4u));
+    Assert((C != 0) == (i % 5 != 0));
+    for(u32 j = 0; j < InstanceCount; j++)
+    {
+      Assert(C[j].a == i && C[j].b == j);
+    }
+  }
+
+  // Removing from the middle moves the rest down, the component stays when the last one goes
+  RemoveComponentInstance(EntityManager, EntityIDs + 3, TEST_COMPONENT_FLAG_C, 1);
+  test_component_c* C = (test_component_c*) GetComponentInstances(EntityManager, EntityIDs + 3, TEST_COMPONENT_FLAG_C, &InstanceCount);
+  Assert(InstanceCount == 2 && C[0].b == 0 && C[1].b == 2);
+  RemoveComponentInstance(EntityManager, EntityIDs + 3, TEST_COMPONENT_FLAG_C, 1);
+  RemoveComponentInstance(EntityManager, EntityIDs + 3, TEST_COMPONENT_FLAG_C, 0);
+  Assert(GetComponentInstances(EntityManager, EntityIDs + 3, TEST_COMPONENT_FLAG_C, &InstanceCount) && InstanceCount == 0);
+  C = (test_component_c*) AddComponentInstance(EntityManager, EntityIDs + 3, TEST_COMPONENT_FLAG_C);
+  Assert(C->a == 0 && C->b == 0 && C->c == 0);
+
+  // Chunk iteration hands out the instances row by row
+  filtered_entity_iterator Iterator = GetComponentsOfType(EntityManager, TEST_COMPONENT_FLAG_C);
+  u32 TotalInstanceCount = 0;
+  while(NextChunk(&Iterator))
+  {
+    for(u32 Row = 0; Row < GetChunkEntityCount(&Iterator); Row++)
+    {
+      Assert(GetReadOnlyComponentInstances(&Iterator, TEST_COMPONENT_FLAG_C, Row, &InstanceCount));
+      TotalInstanceCount += InstanceCount;
+    }
+  }
+  // Entities 2 to 9, entity 3 is down to one instance and entity 5 has none
+  Assert(TotalInstanceCount == 2 + 1 + 4 + 1 + 2 + 3 + 4);
+}
+
+void RunUnitTestsN(memory_arena* Arena)
+{
+  // Testing bulk lookups by entity_id
+  ScopedMemory ScopedMem = ScopedMemory(Arena);
+  entity_manager* EntityManager = CreateEntityManager(16, 4, 4, 4, 4, 4);
+  const u32 EntityCount = 50;
+  entity_id EntityIDs[EntityCount] = {};
+  for(u32 i = 0; i < EntityCount; i++)
+  {
+    EntityIDs[i] = NewEntity(EntityManager, (i % 2) ? TEST_COMPONENT_FLAG_A | TEST_COMPONENT_FLAG_B : TEST_COMPONENT_FLAG_A);
+    ((test_component_a*) GetComponent(EntityManager, EntityIDs + i, TEST_COMPONENT_FLAG_A))->a = i;
+  }
+  for(u32 i = 0; i < EntityCount; i += 5)
+  {
+    DeleteEntity(EntityManager, EntityIDs + i);
+  }
+  // Reuses a deleted slot, the old id must still fail
+  entity_id Reused = NewEntity(EntityManager, TEST_COMPONENT_FLAG_B);
+  Assert(Reused.SlotIndex == EntityIDs[45].SlotIndex);
+
+  // Out of order with ids that were never handed out
+  entity_id LookupIDs[EntityCount + 2] = {};
+  for(u32 i = 0; i < EntityCount; i++)
+  {
+    LookupIDs[i] = EntityIDs[(i * 7) % EntityCount];
+  }
+  LookupIDs[EntityCount] = {};
+  LookupIDs[EntityCount + 1] = {1000, 1};
+
+  b32 Alive[EntityCount + 2] = {};
+  Assert(AreAlive(EntityManager, EntityCount + 2, LookupIDs, Alive) == EntityCount - 10);
+  bptr ComponentsA[EntityCount + 2] = {};
+  bptr ComponentsB[EntityCount + 2] = {};
+  Assert(TryGetReadOnlyComponents(EntityManager, EntityCount + 2, LookupIDs, TEST_COMPONENT_FLAG_A, ComponentsA) == EntityCount - 10);
+  Assert(TryGetComponents(EntityManager, EntityCount + 2, LookupIDs, TEST_COMPONENT_FLAG_B, ComponentsB) == EntityCount / 2 - 5);
+  for(u32 i = 0; i < EntityCount + 2; i++)
+  {
+    Assert(Alive[i] == IsAlive(EntityManager, LookupIDs + i));
+    if(!Alive[i])
+    {
+      Assert(!ComponentsA[i] && !ComponentsB[i]);
+      continue;
+    }
+    Assert(ComponentsA[i] == TryGetComponent(EntityManager, LookupIDs + i, TEST_COMPONENT_FLAG_A));
+    Assert(((test_component_a*) ComponentsA[i])->a == (i * 7) % EntityCount);
+    Assert((ComponentsB[i] != 0) == (LookupIDs[i].SlotIndex % 2 == 1));
+  }
+}
+
+void RunUnitTestsO(memory_arena* Arena)
+{
+  // Testing the memory stats
+  ScopedMemory ScopedMem = ScopedMemory(Arena);
+  entity_manager* EntityManager = CreateEntityManager(16, 4, 4, 4, 4, 4);
+  NewEntities(EntityManager, 10, TEST_COMPONENT_FLAG_A | TEST_COMPONENT_FLAG_B, 0);
+  NewEntities(EntityManager, 2, TEST_COMPONENT_FLAG_C, 0);
+  NewEntity(EntityManager);
+
+  component_memory_stats ComponentStats[5] = {};
+  memory_stats Stats = GetMemoryStats(EntityManager, ComponentStats);
+  Assert(Stats.EntityCount == 13 && Stats.EntitySlotCount == 13 && Stats.EntitySlotCapacity == 16);
+  Assert(Stats.ArchetypeCount == 2 && Stats.ChunkCount == 4);
+  Assert(Stats.ChunkBytes == 4 * ECS_ARCHETYPE_CHUNK_BYTE_SIZE);
+  Assert(Stats.ChunkBytes == Stats.ComponentBytesUsed + Stats.ComponentBytesWasted + Stats.EntityRowBytes + Stats.ChunkOverheadBytes);
+  Assert(Stats.EntityRowBytes == 16 * sizeof(entity_id));
+  Assert(Stats.AverageChunkFill == 12 / 16.f);
+
+  // A is held by both archetypes: 3 chunks of A|B and one of A|C
+  Assert(ComponentStats[0].EntityCount == 12 && ComponentStats[0].RowCapacity == 16);
+  Assert(ComponentStats[0].ChunkCount == 4 && ComponentStats[0].ArchetypeCount == 2);
+  Assert(ComponentStats[0].BytesUsed == 12 * sizeof(test_component_a));
+  Assert(ComponentStats[0].BytesWasted == 4 * sizeof(test_component_a));
+  Assert(ComponentStats[1].EntityCount == 10 && ComponentStats[1].RowCapacity == 12);
+  Assert(ComponentStats[1].BytesWasted == 2 * sizeof(test_component_b));
+  Assert(ComponentStats[2].EntityCount == 2 && ComponentStats[2].AverageChunkFill == 0.5f);
+  Assert(ComponentStats[3].ChunkCount == 0 && ComponentStats[3].AverageChunkFill == 0);
+  Assert(Stats.ComponentBytesUsed == ComponentStats[0].BytesUsed + ComponentStats[1].BytesUsed + ComponentStats[2].BytesUsed);
+
+  // Emptied chunks move to the free pool
+  entity_id EntityIDs[2] = {};
+  GetEntitiesHoldingTypes(EntityManager, TEST_COMPONENT_FLAG_C, EntityIDs);
+  DeleteEntities(EntityManager, 2, EntityIDs);
+  Stats = GetMemoryStats(EntityManager, 0);
+  Assert(Stats.ChunkCount == 3 && Stats.FreeChunkBytes == Stats.FreeChunkCount * ECS_ARCHETYPE_CHUNK_BYTE_SIZE);
+}
+
+void RunUnitTestsP(memory_arena* Arena)
+{
+  // Testing tag components, B and D have no storage
+  ScopedMemory ScopedMem = ScopedMemory(Arena);
+  entity_manager_definition Definitions[] =
+  {
+    {TEST_COMPONENT_FLAG_A, TEST_COMPONENT_FLAG_NONE, 0, sizeof(test_component_a)},
+    {TEST_COMPONENT_FLAG_B, TEST_COMPONENT_FLAG_NONE, 0, 0},
+    {TEST_COMPONENT_FLAG_C, TEST_COMPONENT_FLAG_B,    0, sizeof(test_component_c)},
+    {TEST_COMPONENT_FLAG_D, TEST_COMPONENT_FLAG_A,    0, 0},
+  };
+  entity_manager* EntityManager = CreateEntityManager(16, ArrayCount(Definitions), Definitions);
+  Assert(EntityManager->TagFlags == (TEST_COMPONENT_FLAG_B | TEST_COMPONENT_FLAG_D));
+
+  const u32 EntityCount = 10;
+  entity_id EntityIDs[EntityCount] = {};
+  NewEntities(EntityManager, EntityCount, TEST_COMPONENT_FLAG_A | TEST_COMPONENT_FLAG_B, EntityIDs);
+  for(u32 i = 0; i < EntityCount; i++)
+  {
+    ((test_component_a*) GetComponent(EntityManager, EntityIDs + i, TEST_COMPONENT_FLAG_A))->a = i;
+  }
+
+  // Tags take no space in the chunk
+  archetype* TaggedArchetype = GetEntityFromID(EntityManager, EntityIDs)->Chunk->Archetype;
+  Assert(TaggedArchetype->ComponentCount == 1 && TaggedArchetype->ColumnCount == 1);
+  Assert(TaggedArchetype->ChunkCapacity == GetArchetypeChunkCapacity(EntityManager, TEST_COMPONENT_FLAG_A));
+  Assert(HasComponents(EntityManager, EntityIDs, TEST_COMPONENT_FLAG_A | TEST_COMPONENT_FLAG_B));
+  Assert(GetEntityCountHoldingTypes(EntityManager, TEST_COMPONENT_FLAG_B) == EntityCount);
+
+  // Adding and removing tags moves the entity but keeps its data, requirements still apply
+  NewComponents(EntityManager, EntityIDs + 3, TEST_COMPONENT_FLAG_D);
+  DeleteComponents(EntityManager, EntityIDs + 4, TEST_COMPONENT_FLAG_B);
+  NewComponents(EntityManager, EntityIDs + 4, TEST_COMPONENT_FLAG_C);
+  Assert(HasComponents(EntityManager, EntityIDs + 4, TEST_COMPONENT_FLAG_B | TEST_COMPONENT_FLAG_C));
+  for(u32 i = 0; i < EntityCount; i++)
+  {
+    Assert(((test_component_a*) GetComponent(EntityManager, EntityIDs + i, TEST_COMPONENT_FLAG_A))->a == i);
+  }
+  DeleteComponents(EntityManager, EntityIDs + 3, TEST_COMPONENT_FLAG_A);
+  Assert(!HasOneOfComponents(EntityManager, EntityIDs + 3, TEST_COMPONENT_FLAG_A | TEST_COMPONENT_FLAG_D));
+  Assert(HasComponents(EntityManager, EntityIDs + 3, TEST_COMPONENT_FLAG_B));
+
+  // An entity holding only tags lives in an archetype without component arrays
+  archetype* TagOnlyArchetype = GetEntityFromID(EntityManager, EntityIDs + 3)->Chunk->Archetype;
+  Assert(TagOnlyArchetype->ComponentCount == 0 && TagOnlyArchetype->ColumnCount == 0);
+  Assert(GetEntityCountHoldingTypes(EntityManager, TEST_COMPONENT_FLAG_B) == EntityCount);
+
+  // Queries on tags filter archetypes, the data of the other components is still there
+  u32 VisitedCount = 0;
+  u32 SumA = 0;
+  filtered_entity_iterator Iterator = GetComponentsOfType(EntityManager, TEST_COMPONENT_FLAG_A | TEST_COMPONENT_FLAG_B);
+  while(Next(&Iterator))
+  {
+    SumA += ((test_component_a*) GetComponent(EntityManager, &Iterator, TEST_COMPONENT_FLAG_A))->a;
+    VisitedCount++;
+  }
+  Assert(VisitedCount == EntityCount - 1 && SumA == 45 - 3);
+
+  component_memory_stats ComponentStats[4] = {};
+  GetMemoryStats(EntityManager, ComponentStats);
+  Assert(ComponentStats[1].EntityCount == EntityCount && ComponentStats[1].BytesUsed == 0 && ComponentStats[1].BytesWasted == 0);
+
+  // Tags survive a snapshot
+  midx SnapshotByteSize = GetSnapshotByteSize(EntityManager);
+  u8* Snapshot = (u8*) PushSize(Arena, SnapshotByteSize);
+  Assert(WriteSnapshot(EntityManager, Snapshot, SnapshotByteSize) == SnapshotByteSize);
+  entity_manager* Restored = CreateEntityManager(16, ArrayCount(Definitions), Definitions);
+  Assert(RestoreSnapshot(Restored, Snapshot, SnapshotByteSize));
+  Assert(HasComponents(Restored, EntityIDs + 3, TEST_COMPONENT_FLAG_B));
+  Assert(HasComponents(Restored, EntityIDs + 4, TEST_COMPONENT_FLAG_A | TEST_COMPONENT_FLAG_B | TEST_COMPONENT_FLAG_C));
+  Assert(GetEntityCountHoldingTypes(Restored, TEST_COMPONENT_FLAG_B) == EntityCount);
+
+  DeleteEntities(EntityManager, EntityCount, EntityIDs);
+  Assert(EntityManager->EntityCount == 0);
+}
+
+void RunUnitTestsQ(memory_arena* Arena)
+{
+  // Testing shared components, B is shared and its value is stored once per chunk
+  ScopedMemory ScopedMem = ScopedMemory(Arena);
+  entity_manager_definition Definitions[] =
+  {
+    {TEST_COMPONENT_FLAG_A, TEST_COMPONENT_FLAG_NONE, 4, sizeof(test_component_a)},
+    {TEST_COMPONENT_FLAG_B, TEST_COMPONENT_FLAG_NONE, 0, sizeof(test_component_b), 0, 0, 0, 4},
+    {TEST_COMPONENT_FLAG_C, TEST_COMPONENT_FLAG_B,    0, sizeof(test_component_c)},
+  };
+  entity_manager* EntityManager = CreateEntityManager(16, ArrayCount(Definitions), Definitions);
+  Assert(EntityManager->SharedFlags == TEST_COMPONENT_FLAG_B);
+
+  test_component_b Zero = {};
+  test_component_b Value = {1, 2};
+  Assert(AddSharedComponentValue(EntityManager, TEST_COMPONENT_FLAG_B, &Zero) == 0);
+  u32 ValueIndex = AddSharedComponentValue(EntityManager, TEST_COMPONENT_FLAG_B, &Value);
+  Assert(ValueIndex == 1 && AddSharedComponentValue(EntityManager, TEST_COMPONENT_FLAG_B, &Value) == 1);
+  Assert(((test_component_b*) GetSharedComponentValue(EntityManager, TEST_COMPONENT_FLAG_B, ValueIndex))->b == 2);
+
+  const u32 EntityCount = 8;
+  entity_id EntityIDs[EntityCount] = {};
+  NewEntities(EntityManager, EntityCount, TEST_COMPONENT_FLAG_A | TEST_COMPONENT_FLAG_B, EntityIDs);
+  archetype* Archetype = GetEntityFromID(EntityManager, EntityIDs)->Chunk->Archetype;
+  Assert(Archetype->ComponentCount == 1 && Archetype->SharedCount == 1 && Archetype->ChunkCount == 2);
+  for(u32 i = 0; i < EntityCount; i++)
+  {
+    Assert(GetSharedComponentIndex(EntityManager, EntityIDs + i, TEST_COMPONENT_FLAG_B) == 0);
+    ((test_component_a*) GetComponent(EntityManager, EntityIDs + i, TEST_COMPONENT_FLAG_A))->a = i;
+  }
+
+  // Setting a value moves the entity to a chunk of its own value, the data stays with it
+  SetSharedComponent(EntityManager, EntityIDs + 1, TEST_COMPONENT_FLAG_B, ValueIndex);
+  SetSharedComponent(EntityManager, EntityIDs + 6, TEST_COMPONENT_FLAG_B, ValueIndex);
+  SetSharedComponent(EntityManager, EntityIDs + 6, TEST_COMPONENT_FLAG_B, ValueIndex);
+  Assert(Archetype->ChunkCount == 3);
+  Assert(GetSharedComponentIndex(EntityManager, EntityIDs + 6, TEST_COMPONENT_FLAG_B) == ValueIndex);
+  for(u32 i = 0; i < EntityCount; i++)
+  {
+    Assert(((test_component_a*) GetComponent(EntityManager, EntityIDs + i, TEST_COMPONENT_FLAG_A))->a == i);
+  }
+
+  // Chunks are grouped by value, all entities of a chunk use the value of the chunk
+  u32 CountWithValue = 0;
+  filtered_entity_iterator Iterator = GetComponentsOfType(EntityManager, TEST_COMPONENT_FLAG_B);
+  while(NextChunk(&Iterator))
+  {
+    u32 ChunkValueIndex = GetSharedComponentIndex(&Iterator, TEST_COMPONENT_FLAG_B);
+    test_component_b* ChunkValue = (test_component_b*) GetSharedComponent(&Iterator, TEST_COMPONENT_FLAG_B);
+    Assert(ChunkValue->b == (ChunkValueIndex == ValueIndex ? 2 : 0));
+    entity_id* EntityIDs = GetChunkEntityIDs(Iterator.CurrentChunk);
+    for(u32 Row = 0; Row < GetChunkEntityCount(&Iterator); ++Row)
+    {
+      Assert(GetSharedComponentIndex(EntityManager, &EntityIDs[Row], TEST_COMPONENT_FLAG_B) == ChunkValueIndex);
+    }
+    CountWithValue += ChunkValueIndex == ValueIndex ? GetChunkEntityCount(&Iterator) : 0;
+  }
+  Assert(CountWithValue == 2);
+
+  // Compaction only merges chunks of the same value
+  compaction_result Compaction = CompactChunks(EntityManager, Kilobytes(64));
+  Assert(Compaction.Done && Compaction.EntitiesMoved == 1 && Archetype->ChunkCount == 3);
+  Assert(GetSharedComponentIndex(EntityManager, EntityIDs + 1, TEST_COMPONENT_FLAG_B) == ValueIndex);
+
+  // Values are kept when the entity changes archetype, new shared components start at value 0
+  NewComponents(EntityManager, EntityIDs + 1, TEST_COMPONENT_FLAG_C);
+  Assert(GetSharedComponentIndex(EntityManager, EntityIDs + 1, TEST_COMPONENT_FLAG_B) == ValueIndex);
+  DeleteComponents(EntityManager, EntityIDs + 6, TEST_COMPONENT_FLAG_B);
+  Assert(GetSharedComponentIndex(EntityManager, EntityIDs + 6, TEST_COMPONENT_FLAG_B) == U32Max);
+  NewComponents(EntityManager, EntityIDs + 6, TEST_COMPONENT_FLAG_B);
+  Assert(GetSharedComponentIndex(EntityManager, EntityIDs + 6, TEST_COMPONENT_FLAG_B) == 0);
+  Assert(((test_component_a*) GetComponent(EntityManager, EntityIDs + 6, TEST_COMPONENT_FLAG_A))->a == 6);
+
+  component_memory_stats ComponentStats[3] = {};
+  memory_stats Stats = GetMemoryStats(EntityManager, ComponentStats);
+  Assert(ComponentStats[1].EntityCount == EntityCount && ComponentStats[1].BytesUsed == 0);
+  Assert(Stats.ChunkBytes == Stats.ComponentBytesUsed + Stats.ComponentBytesWasted + Stats.EntityRowBytes + Stats.ChunkOverheadBytes);
+
+  // Values and the value of each chunk survive a snapshot
+  midx SnapshotByteSize = GetSnapshotByteSize(EntityManager);
+  u8* Snapshot = (u8*) PushSize(Arena, SnapshotByteSize);
+  Assert(WriteSnapshot(EntityManager, Snapshot, SnapshotByteSize) == SnapshotByteSize);
+  entity_manager* Restored = CreateEntityManager(16, ArrayCount(Definitions), Definitions);
+  Assert(RestoreSnapshot(Restored, Snapshot, SnapshotByteSize));
+  Assert(GetSharedComponentIndex(Restored, EntityIDs + 1, TEST_COMPONENT_FLAG_B) == ValueIndex);
+  Assert(GetSharedComponentIndex(Restored, EntityIDs + 2, TEST_COMPONENT_FLAG_B) == 0);
+  Assert(((test_component_b*) GetSharedComponentValue(Restored, TEST_COMPONENT_FLAG_B, ValueIndex))->b == 2);
+  Assert(AddSharedComponentValue(Restored, TEST_COMPONENT_FLAG_B, &Value) == ValueIndex);
+
+  // New values past SharedValueCapacity are refused, known ones are still found
+  for(u32 i = 0; i < Definitions[1].SharedValueCapacity; i++)
+  {
+    test_component_b Extra = {};
+    Extra.b = 100 + i;
+    AddSharedComponentValue(Restored, TEST_COMPONENT_FLAG_B, &Extra);
+  }
+  test_component_b NoRoom = {};
+  NoRoom.b = 200;
+  Assert(AddSharedComponentValue(Restored, TEST_COMPONENT_FLAG_B, &NoRoom) == U32Max);
+  Assert(AddSharedComponentValue(Restored, TEST_COMPONENT_FLAG_B, &Value) == ValueIndex);
+}
+
+void RunUnitTestsR(memory_arena* Arena)
+{
+  // Testing that the entity ids kept in the chunk rows follow the entities through moves and deletes
+  ScopedMemory ScopedMem = ScopedMemory(Arena);
+  entity_manager* EntityManager = CreateEntityManager(16, 4, 4, 4, 4, 4);
+  const u32 EntityCount = 24;
+  entity_id EntityIDs[EntityCount] = {};
+  NewEntities(EntityManager, EntityCount, TEST_COMPONENT_FLAG_A | TEST_COMPONENT_FLAG_B, EntityIDs);
+  for(u32 i = 0; i < EntityCount; i += 3)
+  {
+    DeleteComponents(EntityManager, EntityIDs + i, TEST_COMPONENT_FLAG_B);
+  }
+  entity_id ToDelete[] = {EntityIDs[1], EntityIDs[4], EntityIDs[5], EntityIDs[23]};
+  DeleteEntities(EntityManager, ArrayCount(ToDelete), ToDelete);
+  CompactChunks(EntityManager, Kilobytes(64));
+
+  u32 VisitedCount = 0;
+  filtered_entity_iterator Iterator = GetComponentsOfType(EntityManager, TEST_COMPONENT_FLAG_A);
+  while(Next(&Iterator))
+  {
+    entity_id ID = GetEntityID(&Iterator);
+    bptr Component = GetComponent(EntityManager, &Iterator, TEST_COMPONENT_FLAG_A);
+    Assert(IsValid(&ID));
+    Assert(GetComponent(EntityManager, &ID, TEST_COMPONENT_FLAG_A) == Component);
+    entity_id FromComponent = GetEntityIDFromComponent(Component);
+    Assert(Compare(&FromComponent, &ID));
+    VisitedCount++;
+  }
+  Assert(VisitedCount == EntityCount - ArrayCount(ToDelete));
+
+  entity_id Holding[EntityCount] = {};
+  GetEntitiesHoldingTypes(EntityManager, TEST_COMPONENT_FLAG_A | TEST_COMPONENT_FLAG_B, Holding);
+  for(u32 i = 0; i < EntityCount; i++)
+  {
+    b32 HoldsB = IsAlive(EntityManager, EntityIDs + i) && HasComponents(EntityManager, EntityIDs + i, TEST_COMPONENT_FLAG_B);
+    b32 Listed = false;
+    for(u32 j = 0; j < EntityCount && IsValid(Holding + j); j++)
+    {
+      Listed |= Compare(Holding + j, EntityIDs + i);
+    }
+    Assert(HoldsB == Listed);
+  }
+}
+
+void RunUnitTestsS(memory_arena* Arena)
+{
+  // Testing moving entities between entity managers, B is shared and C is a tag
+  ScopedMemory ScopedMem = ScopedMemory(Arena);
+  entity_manager_definition Definitions[] =
+  {
+    {TEST_COMPONENT_FLAG_A, TEST_COMPONENT_FLAG_NONE, 0, sizeof(test_component_a)},
+    {TEST_COMPONENT_FLAG_B, TEST_COMPONENT_FLAG_NONE, 0, sizeof(test_component_b), 0, 0, 0, 4},
+    {TEST_COMPONENT_FLAG_C, TEST_COMPONENT_FLAG_NONE, 0, 0},
+    {TEST_COMPONENT_FLAG_D, TEST_COMPONENT_FLAG_A,    0, sizeof(test_component_d)},
+  };
+  entity_manager* Source = CreateEntityManager(16, ArrayCount(Definitions), Definitions);
+  entity_manager* Destination = CreateEntityManager(16, ArrayCount(Definitions), Definitions);
+
+  // Values get different indices in the two managers
+  test_component_b Value = {1, 2};
+  test_component_b OtherValue = {3, 4};
+  u32 SourceValueIndex = AddSharedComponentValue(Source, TEST_COMPONENT_FLAG_B, &Value);
+  AddSharedComponentValue(Destination, TEST_COMPONENT_FLAG_B, &OtherValue);
+
+  const u32 EntityCount = 12;
+  entity_id EntityIDs[EntityCount] = {};
+  NewEntities(Source, 4, TEST_COMPONENT_FLAG_D, EntityIDs);
+  NewEntities(Source, 4, TEST_COMPONENT_FLAG_A | TEST_COMPONENT_FLAG_B, EntityIDs + 4);
+  NewEntities(Source, 3, TEST_COMPONENT_FLAG_A | TEST_COMPONENT_FLAG_C, EntityIDs + 8);
+  EntityIDs[11] = NewEntity(Source);
+  for(u32 i = 0; i < 11; i++)
+  {
+    ((test_component_a*) GetComponent(Source, EntityIDs + i, TEST_COMPONENT_FLAG_A))->a = i;
+  }
+  for(u32 i = 0; i < 4; i++)
+  {
+    ((test_component_d*) GetComponent(Source, EntityIDs + i, TEST_COMPONENT_FLAG_D))->d = 10 + i;
+  }
+  SetSharedComponent(Source, EntityIDs + 5, TEST_COMPONENT_FLAG_B, SourceValueIndex);
+  SetSharedComponent(Source, EntityIDs + 6, TEST_COMPONENT_FLAG_B, SourceValueIndex);
+
+  // Every other D entity, the B chunk of Value as a whole and one of the other, the A|C chunk but one
+  // and the entity without components
+  const u32 MoveCount = 8;
+  u32 Moved[MoveCount] = {1, 3, 5, 6, 4, 8, 9, 11};
+  entity_id ToMove[MoveCount] = {};
+  for(u32 i = 0; i < MoveCount; i++)
+  {
+    ToMove[i] = EntityIDs[Moved[i]];
+  }
+  entity_id MovedIDs[MoveCount] = {};
+  archetype_chunk* WholeChunk = GetEntityFromID(Source, EntityIDs + 5)->Chunk;
+  u32 SourceFreeChunkCount = Source->FreeChunkCount;
+  Assert(MoveEntities(Source, Destination, MoveCount, ToMove, MovedIDs));
+  Assert(GetEntityFromID(Destination, MovedIDs + 2)->Chunk != WholeChunk);
+  Assert(Source->FirstFreeChunk == WholeChunk && Source->FreeChunkCount == SourceFreeChunkCount + 1);
+  Assert(Source->EntityCount == EntityCount - MoveCount && Destination->EntityCount == MoveCount);
+
+  for(u32 i = 0; i < MoveCount; i++)
+  {
+    entity_id* ID = MovedIDs + i;
+    Assert(!IsAlive(Source, ToMove + i) && IsAlive(Destination, ID));
+    u32 Original = Moved[i];
+    if(Original == 11)
+    {
+      Assert(!HasComponents(Destination, ID, TEST_COMPONENT_FLAG_A));
+      continue;
+    }
+    Assert(((test_component_a*) GetComponent(Destination, ID, TEST_COMPONENT_FLAG_A))->a == Original);
+    if(Original < 4)
+    {
+      Assert(((test_component_d*) GetComponent(Destination, ID, TEST_COMPONENT_FLAG_D))->d == 10 + Original);
+    }else if(Original < 8){
+      u32 ValueIndex = GetSharedComponentIndex(Destination, ID, TEST_COMPONENT_FLAG_B);
+      test_component_b* Shared = (test_component_b*) GetSharedComponentValue(Destination, TEST_COMPONENT_FLAG_B, ValueIndex);
+      Assert(Shared->b == ((Original == 5 || Original == 6) ? 2 : 0));
+      Assert(Original == 4 || ValueIndex == 2);
+    }else{
+      Assert(HasComponents(Destination, ID, TEST_COMPONENT_FLAG_C));
+    }
+  }
+
+  // The entities left behind keep their data
+  u32 Kept[] = {0, 2, 7, 10};
+  for(u32 i = 0; i < ArrayCount(Kept); i++)
+  {
+    Assert(((test_component_a*) GetComponent(Source, EntityIDs + Kept[i], TEST_COMPONENT_FLAG_A))->a == Kept[i]);
+  }
+  Assert(HasComponents(Source, EntityIDs + 10, TEST_COMPONENT_FLAG_C));
+  Assert(((test_component_d*) GetComponent(Source, EntityIDs + 2, TEST_COMPONENT_FLAG_D))->d == 12);
+
+  // The chunk of Value was copied as a whole, the chunk of value 0 stayed with entity 7
+  archetype* SourceB = GetArchetype(Source, TEST_COMPONENT_FLAG_A | TEST_COMPONENT_FLAG_B);
+  archetype* DestinationB = GetArchetype(Destination, TEST_COMPONENT_FLAG_A | TEST_COMPONENT_FLAG_B);
+  Assert(SourceB->ChunkCount == 1 && SourceB->EntityCount == 1);
+  Assert(DestinationB->ChunkCount == 2 && DestinationB->EntityCount == 3);
+
+  // A cleared manager takes new entities in its first slots
+  ClearEntityManager(Destination);
+  Assert(Destination->EntityCount == 0 && DestinationB->ChunkCount == 0);
+  for(u32 i = 0; i < MoveCount; i++)
+  {
+    Assert(!IsAlive(Destination, MovedIDs + i));
+  }
+  entity_id Reused = NewEntity(Destination, TEST_COMPONENT_FLAG_A);
+  Assert(Reused.SlotIndex == 0);
+  Assert(((test_component_a*) GetComponent(Destination, &Reused, TEST_COMPONENT_FLAG_A))->a == 0);
+
+  // Nothing moves when Destination has no room for a shared value
+  test_component_b Filler = {5, 6};
+  test_component_b Missing = {7, 8};
+  Assert(AddSharedComponentValue(Destination, TEST_COMPONENT_FLAG_B, &Filler) != U32Max);
+  SetSharedComponent(Source, EntityIDs + 7, TEST_COMPONENT_FLAG_B, AddSharedComponentValue(Source, TEST_COMPONENT_FLAG_B, &Missing));
+  Assert(!MoveEntities(Source, Destination, 1, EntityIDs + 7, 0));
+  Assert(IsAlive(Source, EntityIDs + 7) && Destination->EntityCount == 1);
+  Assert(((test_component_a*) GetComponent(Source, EntityIDs + 7, TEST_COMPONENT_FLAG_A))->a == 7);
+  Assert(GetEntityFromID(Source, EntityIDs + 7)->Chunk->DeletedCount == 0);
+}
+
+void RunUnitTestsT(memory_arena* Arena)
+{
+  // Testing typed queries
+  ScopedMemory ScopedMem = ScopedMemory(Arena);
+  entity_manager* EntityManager = CreateEntityManager(16, 4, 4, 4, 4, 4);
+  const u32 EntityCount = 8;
+  entity_id EntityIDs[EntityCount] = {};
+  NewEntities(EntityManager, 5, TEST_COMPONENT_FLAG_A | TEST_COMPONENT_FLAG_B, EntityIDs);
+  NewEntities(EntityManager, 3, TEST_COMPONENT_FLAG_A | TEST_COMPONENT_FLAG_D, EntityIDs + 5);
+  for(u32 i = 0; i < EntityCount; i++)
+  {
+    GetComponent<test_component_a>(EntityManager, EntityIDs + i)->a = i;
+  }
+  for(u32 i = 0; i < 5; i++)
+  {
+    GetComponent<test_component_b>(EntityManager, EntityIDs + i)->b = 10 * i;
+  }
+
+  // The typed query is the query of its flags
+  typed_query<test_component_a, const test_component_b> QueryAB = RegisterTypedQuery<test_component_a, const test_component_b>(EntityManager);
+  Assert(QueryAB.Query == RegisterQuery(EntityManager, TEST_COMPONENT_FLAG_A | TEST_COMPONENT_FLAG_B));
+  u32 VisitedCount = 0;
+  ForEach(EntityManager, QueryAB, [&VisitedCount](test_component_a& A, const test_component_b& B)
+  {
+    A.a += B.b;
+    VisitedCount++;
+  });
+  Assert(VisitedCount == 5);
+  for(u32 i = 0; i < 5; i++)
+  {
+    Assert(GetComponent<const test_component_a>(EntityManager, EntityIDs + i)->a == 11 * i);
+  }
+
+  // Ids come with the components of the same row
+  ForEachWithID(EntityManager, QueryAB, [EntityManager](entity_id const& ID, test_component_a& A, const test_component_b& B)
+  {
+    entity_id EntityID = ID;
+    Assert(GetComponent<test_component_a>(EntityManager, &EntityID) == &A);
+    Assert(GetComponent<const test_component_b>(EntityManager, &EntityID) == &B);
+  });
+
+  // Flags without arrays narrow the query, const components are not changes
+  typed_query<const test_component_a> QueryAWithD = RegisterTypedQuery<const test_component_a>(EntityManager, TEST_COMPONENT_FLAG_D);
+  u32 Since = AdvanceChangeVersion(EntityManager);
+  u32 Sum = 0;
+  ForEach(EntityManager, QueryAWithD, [&Sum](const test_component_a& A)
+  {
+    Sum += A.a;
+  });
+  Assert(Sum == 5 + 6 + 7);
+  filtered_entity_iterator Changed = GetChangedComponentsOfType(EntityManager, QueryAWithD.Query, {TEST_COMPONENT_FLAG_A, Since});
+  Assert(!NextChunk(&Changed));
+
+  worker_pool* Pool = CreateWorkerPool(2);
+  typed_query<test_component_a> QueryA = RegisterTypedQuery<test_component_a>(EntityManager);
+  u32 ParallelCount = ParallelForEach(Pool, EntityManager, QueryA, [](test_component_a& A)
+  {
+    A.a = 100;
+  });
+  DestroyWorkerPool(Pool);
+  Assert(ParallelCount == EntityCount);
+  for(u32 i = 0; i < EntityCount; i++)
+  {
+    Assert(GetComponent<const test_component_a>(EntityManager, EntityIDs + i)->a == 100);
+  }
+}
+
+struct scheduler_test_data
+{
+  typed_query<test_component_a> QueryA;
+  typed_query<const test_component_a, test_component_b> QueryAB;
+  typed_query<test_component_d> QueryD;
+  typed_query<const test_component_a, const test_component_d> QueryAD;
+  std::atomic<u32> NextRunOrder;
+  u32 RunOrders[5];
+  u32 ChangeVersions[5];
+  u32 ThreadIndices[5];
+  u32 SumAD;
+};
+
+internal void RecordSystemRun(system_context* Context, scheduler_test_data* Data, u32 SystemIndex)
+{
+  Data->RunOrders[SystemIndex] = Data->NextRunOrder.fetch_add(1);
+  Data->ChangeVersions[SystemIndex] = Context->ChangeVersion;
+  Data->ThreadIndices[SystemIndex] = Context->ThreadIndex;
+}
+
+internal ECS_SYSTEM_CALLBACK(IncrementASystem)
+{
+  scheduler_test_data* Data = (scheduler_test_data*) UserData;
+  RecordSystemRun(Context, Data, 0);
+  ParallelForEach(Context->Pool, Context->EM, Data->QueryA, [](test_component_a& A)
+  {
+    A.a += 1;
+  });
+}
+
+internal ECS_SYSTEM_CALLBACK(CopyAToBSystem)
+{
+  scheduler_test_data* Data = (scheduler_test_data*) UserData;
+  RecordSystemRun(Context, Data, 1);
+  ParallelForEach(Context->Pool, Context->EM, Data->QueryAB, [](const test_component_a& A, test_component_b& B)
+  {
+    B.b = A.a * 2;
+  });
+}
+
+internal ECS_SYSTEM_CALLBACK(WriteDSystem)
+{
+  scheduler_test_data* Data = (scheduler_test_data*) UserData;
+  RecordSystemRun(Context, Data, 2);
+  ParallelForEach(Context->Pool, Context->EM, Data->QueryD, [](test_component_d& D)
+  {
+    D.d = 7;
+  });
+}
+
+internal ECS_SYSTEM_CALLBACK(SumADSystem)
+{
+  scheduler_test_data* Data = (scheduler_test_data*) UserData;
+  RecordSystemRun(Context, Data, 3);
+  Data->SumAD = 0;
+  ForEach(Context->EM, Data->QueryAD, [Data](const test_component_a& A, const test_component_d& D)
+  {
+    Data->SumAD += A.a + D.d;
+  });
+}
+
+internal ECS_SYSTEM_CALLBACK(ScaleASystem)
+{
+  scheduler_test_data* Data = (scheduler_test_data*) UserData;
+  RecordSystemRun(Context, Data, 4);
+  ParallelForEach(Context->Pool, Context->EM, Data->QueryA, [](test_component_a& A)
+  {
+    A.a *= 10;
+  });
+}
+
+void RunUnitTestsU(memory_arena* Arena)
+{
+  // Testing the system scheduler
+  ScopedMemory ScopedMem = ScopedMemory(Arena);
+  entity_manager* EntityManager = CreateEntityManager(64, 4, 4, 4, 4, 4);
+  const u32 EntityCount = 40;
+  entity_id EntityIDs[EntityCount] = {};
+  NewEntities(EntityManager, 24, TEST_COMPONENT_FLAG_A | TEST_COMPONENT_FLAG_B, EntityIDs);
+  NewEntities(EntityManager, 16, TEST_COMPONENT_FLAG_A | TEST_COMPONENT_FLAG_D, EntityIDs + 24);
+  for(u32 i = 0; i < EntityCount; i++)
+  {
+    GetComponent<test_component_a>(EntityManager, EntityIDs + i)->a = i;
+  }
+
+  scheduler_test_data* Data = PushStruct(Arena, scheduler_test_data);
+  new (&Data->NextRunOrder) std::atomic<u32>(0);
+  Data->QueryA = RegisterTypedQuery<test_component_a>(EntityManager);
+  Data->QueryAB = RegisterTypedQuery<const test_component_a, test_component_b>(EntityManager);
+  Data->QueryD = RegisterTypedQuery<test_component_d>(EntityManager);
+  Data->QueryAD = RegisterTypedQuery<const test_component_a, const test_component_d>(EntityManager);
+
+  scheduler* Scheduler = CreateScheduler();
+  u32 IncrementA = AddSystem(Scheduler, "IncrementA", 0, TEST_COMPONENT_FLAG_A, IncrementASystem, Data);
+  u32 CopyAToB = AddSystem(Scheduler, "CopyAToB", TEST_COMPONENT_FLAG_A, TEST_COMPONENT_FLAG_B, CopyAToBSystem, Data);
+  u32 WriteD = AddSystem(Scheduler, "WriteD", 0, TEST_COMPONENT_FLAG_D, WriteDSystem, Data);
+  u32 SumAD = AddSystem(Scheduler, "SumAD", TEST_COMPONENT_FLAG_A | TEST_COMPONENT_FLAG_D, 0, SumADSystem, Data);
+  u32 ScaleA = AddSystem(Scheduler, "ScaleA", 0, TEST_COMPONENT_FLAG_A, ScaleASystem, Data);
+
+  worker_pool* Pool = CreateWorkerPool(3);
+  RunSystems(Scheduler, EntityManager, Pool);
+
+  // Conflicting systems run in the order they were added, the others share a level
+  system_stats SystemStats[5] = {};
+  scheduler_stats Stats = GetSchedulerStats(Scheduler, SystemStats);
+  Assert(Stats.SystemCount == 5);
+  Assert(Stats.LevelCount == 3);
+  Assert(SystemStats[IncrementA].Level == 0 && SystemStats[IncrementA].Dependencies == 0);
+  Assert(SystemStats[WriteD].Level == 0 && SystemStats[WriteD].Dependencies == 0);
+  Assert(SystemStats[CopyAToB].Level == 1 && SystemStats[CopyAToB].Dependencies == (1u << IncrementA));
+  Assert(SystemStats[SumAD].Level == 1 && SystemStats[SumAD].Dependencies == ((1u << IncrementA) | (1u << WriteD)));
+  Assert(SystemStats[ScaleA].Level == 2 && SystemStats[ScaleA].Dependencies == ((1u << IncrementA) | (1u << CopyAToB) | (1u << SumAD)));
+  Assert(Data->RunOrders[CopyAToB] > Data->RunOrders[IncrementA]);
+  Assert(Data->RunOrders[SumAD] > Data->RunOrders[IncrementA]);
+  Assert(Data->RunOrders[SumAD] > Data->RunOrders[WriteD]);
+  Assert(Data->RunOrders[ScaleA] > Data->RunOrders[CopyAToB]);
+  Assert(Data->RunOrders[ScaleA] > Data->RunOrders[SumAD]);
+  for(u32 SystemIndex = 0; SystemIndex < 5; ++SystemIndex)
+  {
+    Assert(SystemStats[SystemIndex].RunCount == 1);
+    Assert(SystemStats[SystemIndex].ThreadIndex == Data->ThreadIndices[SystemIndex]);
+    Assert(Data->ThreadIndices[SystemIndex] < GetThreadCount(Pool));
+    Assert(Data->ChangeVersions[SystemIndex] == Data->ChangeVersions[0]);
+  }
+  Assert(Stats.LastSystemSeconds >= SystemStats[ScaleA].LastSeconds);
+
+  u32 ExpectedSumAD = 0;
+  for(u32 i = 0; i < EntityCount; i++)
+  {
+    Assert(GetComponent<const test_component_a>(EntityManager, EntityIDs + i)->a == (i + 1) * 10);
+    if(i < 24)
+    {
+      Assert(GetComponent<const test_component_b>(EntityManager, EntityIDs + i)->b == (i + 1) * 2);
+    }else{
+      Assert(GetComponent<const test_component_d>(EntityManager, EntityIDs + i)->d == 7);
+      ExpectedSumAD += i + 1 + 7;
+    }
+  }
+  Assert(Data->SumAD == ExpectedSumAD);
+
+  // Writes of the systems are stamped after the version they got
+  filtered_entity_iterator Changed = GetChangedComponentsOfType(EntityManager, Data->QueryA.Query, {TEST_COMPONENT_FLAG_A, Data->ChangeVersions[0]});
+  Assert(NextChunk(&Changed));
+
+  // Disabled systems don't run and don't hold back others
+  SetSystemEnabled(Scheduler, IncrementA, false);
+  RunSystems(Scheduler, EntityManager, Pool);
+  Stats = GetSchedulerStats(Scheduler, SystemStats);
+  Assert(Stats.LevelCount == 3);
+  Assert(SystemStats[IncrementA].RunCount == 1 && !SystemStats[IncrementA].Enabled);
+  Assert(SystemStats[CopyAToB].Level == 0 && SystemStats[CopyAToB].Dependencies == 0);
+  Assert(SystemStats[SumAD].Level == 1);
+  Assert(SystemStats[ScaleA].Level == 2);
+  for(u32 i = 0; i < 24; i++)
+  {
+    Assert(GetComponent<const test_component_a>(EntityManager, EntityIDs + i)->a == (i + 1) * 100);
+    Assert(GetComponent<const test_component_b>(EntityManager, EntityIDs + i)->b == (i + 1) * 20);
+  }
+  DestroyWorkerPool(Pool);
+
+  // Without a pool the systems run one after another, level by level
+  SetSystemEnabled(Scheduler, IncrementA, true);
+  Data->NextRunOrder = 0;
+  RunSystems(Scheduler, EntityManager, 0);
+  u32 ExpectedRunOrders[5] = {0, 2, 1, 3, 4};
+  for(u32 SystemIndex = 0; SystemIndex < 5; ++SystemIndex)
+  {
+    Assert(Data->RunOrders[SystemIndex] == ExpectedRunOrders[SystemIndex]);
+    Assert(Data->ThreadIndices[SystemIndex] == 0);
+  }
+  for(u32 i = 0; i < 24; i++)
+  {
+    Assert(GetComponent<const test_component_a>(EntityManager, EntityIDs + i)->a == ((i + 1) * 100 + 1) * 10);
+  }
+
+  // Systems added again after RemoveAllSystems start from index 0, like after a reload of the dll
+  RemoveAllSystems(Scheduler);
+  RunSystems(Scheduler, EntityManager, 0);
+  Assert(GetSchedulerStats(Scheduler, 0).SystemCount == 0);
+  Assert(AddSystem(Scheduler, "IncrementA", 0, TEST_COMPONENT_FLAG_A, IncrementASystem, Data) == 0);
+  RunSystems(Scheduler, EntityManager, 0);
+  Stats = GetSchedulerStats(Scheduler, SystemStats);
+  Assert(Stats.SystemCount == 1 && Stats.LevelCount == 1);
+  Assert(SystemStats[0].RunCount == 1);
+  Assert(GetComponent<const test_component_a>(EntityManager, EntityIDs + 0)->a == 1010 + 1);
+  Data->NextRunOrder.~atomic();
+}
+
+void RunUnitTestsV(memory_arena* Arena)
+{
+  // Testing GetEntitiesHoldingTypes into a span on an arena
+  ScopedMemory ScopedMem = ScopedMemory(Arena);
+  entity_manager* EntityManager = CreateEntityManager(64, 4, 4, 4, 4, 4);
+  const u32 EntityCount = 22;
+  entity_id EntityIDs[EntityCount] = {};
+  NewEntities(EntityManager, 10, TEST_COMPONENT_FLAG_A | TEST_COMPONENT_FLAG_B, EntityIDs);
+  NewEntities(EntityManager, 5, TEST_COMPONENT_FLAG_A | TEST_COMPONENT_FLAG_B | TEST_COMPONENT_FLAG_D, EntityIDs + 10);
+  NewEntities(EntityManager, 7, TEST_COMPONENT_FLAG_A, EntityIDs + 15);
+  DeleteEntity(EntityManager, EntityIDs + 3);
+  DeleteEntity(EntityManager, EntityIDs + 12);
+
+  entity_id_span Span = GetEntitiesHoldingTypes(EntityManager, TEST_COMPONENT_FLAG_A | TEST_COMPONENT_FLAG_B, Arena);
+  Assert(Span.Count == 13);
+  Assert(Span.Count == GetEntityCountHoldingTypes(EntityManager, TEST_COMPONENT_FLAG_A | TEST_COMPONENT_FLAG_B));
+  entity_id Expected[EntityCount] = {};
+  GetEntitiesHoldingTypes(EntityManager, TEST_COMPONENT_FLAG_A | TEST_COMPONENT_FLAG_B, Expected);
+  for(u32 i = 0; i < Span.Count; i++)
+  {
+    Assert(Span.EntityIDs[i].SlotIndex == Expected[i].SlotIndex && Span.EntityIDs[i].Generation == Expected[i].Generation);
+    Assert(HasComponents(EntityManager, Span.EntityIDs + i, TEST_COMPONENT_FLAG_A | TEST_COMPONENT_FLAG_B));
+  }
+  for(u32 i = 0; i < 15; i++)
+  {
+    b32 Found = false;
+    for(u32 j = 0; j < Span.Count; j++)
+    {
+      Found |= Span.EntityIDs[j].SlotIndex == EntityIDs[i].SlotIndex && Span.EntityIDs[j].Generation == EntityIDs[i].Generation;
+    }
+    Assert(Found == (i != 3 && i != 12));
+  }
+
+  entity_id_span SpanABD = GetEntitiesHoldingTypes(EntityManager, TEST_COMPONENT_FLAG_A | TEST_COMPONENT_FLAG_B | TEST_COMPONENT_FLAG_D, Arena);
+  Assert(SpanABD.Count == 4);
+  entity_id_span SpanE = GetEntitiesHoldingTypes(EntityManager, TEST_COMPONENT_FLAG_E, Arena);
+  Assert(SpanE.Count == 0);
+}
+
+void RunUnitTestsW(memory_arena* Arena)
+{
+  // Testing prefabs, B is shared, C is a tag and E is stored as one array per field
+  ScopedMemory ScopedMem = ScopedMemory(Arena);
+  u32 FieldByteSizes[] = {sizeof(u32), sizeof(u32), sizeof(u32)};
+  entity_manager_definition Definitions[] =
+  {
+    {TEST_COMPONENT_FLAG_A, TEST_COMPONENT_FLAG_NONE, 0, sizeof(test_component_a)},
+    {TEST_COMPONENT_FLAG_B, TEST_COMPONENT_FLAG_NONE, 0, sizeof(test_component_b), 0, 0, 0, 4},
+    {TEST_COMPONENT_FLAG_C, TEST_COMPONENT_FLAG_NONE, 0, 0},
+    {TEST_COMPONENT_FLAG_D, TEST_COMPONENT_FLAG_A,    0, sizeof(test_component_d)},
+    {TEST_COMPONENT_FLAG_E, TEST_COMPONENT_FLAG_NONE, 0, sizeof(test_component_c), ArrayCount(FieldByteSizes), FieldByteSizes},
+  };
+  entity_manager* EntityManager = CreateEntityManager(64, ArrayCount(Definitions), Definitions);
+  test_component_b Value = {1, 2};
+  u32 ValueIndex = AddSharedComponentValue(EntityManager, TEST_COMPONENT_FLAG_B, &Value);
+
+  // Requirements are part of the prefab, its values start zeroed
+  component_signature PrefabFlags = TEST_COMPONENT_FLAG_B | TEST_COMPONENT_FLAG_C | TEST_COMPONENT_FLAG_D | TEST_COMPONENT_FLAG_E;
+  prefab* Prefab = CreatePrefab(EntityManager, PrefabFlags);
+  Assert(GetPrefabComponentFlags(Prefab) == (PrefabFlags | TEST_COMPONENT_FLAG_A));
+  test_component_a* PrefabA = (test_component_a*) GetPrefabComponent(Prefab, TEST_COMPONENT_FLAG_A);
+  test_component_d* PrefabD = (test_component_d*) GetPrefabComponent(Prefab, TEST_COMPONENT_FLAG_D);
+  Assert(PrefabA->a == 0 && PrefabD->a == 0 && PrefabD->d == 0);
+  PrefabA->a = 5;
+  *PrefabD = {1, 2, 3, 4};
+  for(u32 FieldIndex = 0; FieldIndex < 3; FieldIndex++)
+  {
+    *(u32*) GetPrefabComponentField(Prefab, TEST_COMPONENT_FLAG_E, FieldIndex) = 7 + FieldIndex;
+  }
+  SetPrefabSharedComponent(EntityManager, Prefab, TEST_COMPONENT_FLAG_B, ValueIndex);
+
+  // Entities of the same archetype with other shared values don't share chunks with the instances
+  entity_id Plain = NewEntity(EntityManager, PrefabFlags);
+
+  const u32 EntityCount = 1000;
+  entity_id* EntityIDs = PushArray(Arena, EntityCount + 3, entity_id);
+  InstantiatePrefab(EntityManager, Prefab, EntityCount, EntityIDs);
+  Assert(GetEntityCountHoldingTypes(EntityManager, PrefabFlags) == EntityCount + 1);
+  for(u32 i = 0; i < EntityCount; i++)
+  {
+    Assert(IsAlive(EntityManager, EntityIDs + i));
+    Assert(HasComponents(EntityManager, EntityIDs + i, PrefabFlags | TEST_COMPONENT_FLAG_A));
+    Assert(((test_component_a*) GetReadOnlyComponent(EntityManager, EntityIDs + i, TEST_COMPONENT_FLAG_A))->a == 5);
+    test_component_d* D = (test_component_d*) GetReadOnlyComponent(EntityManager, EntityIDs + i, TEST_COMPONENT_FLAG_D);
+    Assert(D->a == 1 && D->b == 2 && D->c == 3 && D->d == 4);
+    for(u32 FieldIndex = 0; FieldIndex < 3; FieldIndex++)
+    {
+      Assert(*(u32*) GetReadOnlyComponentField(EntityManager, EntityIDs + i, TEST_COMPONENT_FLAG_E, FieldIndex) == 7 + FieldIndex);
+    }
+    Assert(GetSharedComponentIndex(EntityManager, EntityIDs + i, TEST_COMPONENT_FLAG_B) == ValueIndex);
+  }
+  Assert(GetSharedComponentIndex(EntityManager, &Plain, TEST_COMPONENT_FLAG_B) == 0);
+  Assert(((test_component_a*) GetReadOnlyComponent(EntityManager, &Plain, TEST_COMPONENT_FLAG_A))->a == 0);
+
+  // The instances fill their chunks one after another
+  archetype* Archetype = GetEntityFromID(EntityManager, EntityIDs)->Chunk->Archetype;
+  u32 InstanceChunkCount = (EntityCount + Archetype->ChunkCapacity - 1) / Archetype->ChunkCapacity;
+  Assert(Archetype->ChunkCount == InstanceChunkCount + 1);
+
+  // Changing the prefab only changes later instances
+  PrefabA->a = 6;
+  InstantiatePrefab(EntityManager, Prefab, 3, EntityIDs + EntityCount);
+  Assert(((test_component_a*) GetReadOnlyComponent(EntityManager, EntityIDs, TEST_COMPONENT_FLAG_A))->a == 5);
+  for(u32 i = EntityCount; i < EntityCount + 3; i++)
+  {
+    Assert(((test_component_a*) GetReadOnlyComponent(EntityManager, EntityIDs + i, TEST_COMPONENT_FLAG_A))->a == 6);
+  }
+  InstantiatePrefab(EntityManager, Prefab, 2, 0);
+  Assert(GetEntityCountHoldingTypes(EntityManager, PrefabFlags) == EntityCount + 6);
+}
 
 void RunUnitTests(memory_arena* Arena)
 {
   RunUnitTestsA(Arena);
+  RunUnitTestsB(Arena);
+  RunUnitTestsC(Arena);
+  RunUnitTestsD(Arena);
+  RunUnitTestsE(Arena);
+  RunUnitTestsF(Arena);
+  RunUnitTestsG(Arena);
+  RunUnitTestsH(Arena);
+  RunUnitTestsI(Arena);
+  RunUnitTestsJ(Arena);
+  RunUnitTestsK(Arena);
+  RunUnitTestsL(Arena);
+  RunUnitTestsM(Arena);
+  RunUnitTestsN(Arena);
+  RunUnitTestsO(Arena);
+  RunUnitTestsP(Arena);
+  RunUnitTestsQ(Arena);
+  RunUnitTestsR(Arena);
+  RunUnitTestsS(Arena);
+  RunUnitTestsT(Arena);
+  RunUnitTestsU(Arena);
+  RunUnitTestsV(Arena);
+  RunUnitTestsW(Arena);
 }
 
-}}
\ No newline at end of file
+}
\ No newline at end of file
@@ -0,0 +1,66 @@
+// Standalone benchmark of the entity_manager backend, built by build_ecs_benchmark.sh.
+// Runs RunBenchmarkSuite and writes the JSON results to a file, the console output of
+// RunBenchmarks goes to stdout.
+//   build/ecs_benchmark [MaxEntityCount=10000000] [OutputPath=ecs_benchmark.json] [--micro]
+#include "platform/jwin_platform.h"
+#include "platform/jwin_platform_memory.cpp"
+#include "containers/chunk_list.cpp"
+#include "ecs/entity_components_backend.cpp"
+#include "ecs/entity_components_parallel.cpp"
+#include "ecs/entity_components_scheduler.cpp"
+#include "ecs/entity_components_commands.cpp"
+#include "ecs/entity_components_snapshot.cpp"
+#include "ecs/entity_components_backend_benchmarks.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+
+internal void StdoutDEBUGPrint(const char* Format, ...)
+{
+  va_list Arguments;
+  va_start(Arguments, Format);
+  vprintf(Format, Arguments);
+  va_end(Arguments);
+}
+
+int main(int ArgumentCount, char** Arguments)
+{
+  u32 MaxEntityCount = 10000000;
+  const char* OutputPath = "ecs_benchmark.json";
+  b32 RunMicroBenchmarks = false;
+  u32 PositionalIndex = 0;
+  for(int ArgumentIndex = 1; ArgumentIndex < ArgumentCount; ++ArgumentIndex)
+  {
+    const char* Argument = Arguments[ArgumentIndex];
+    if(strcmp(Argument, "--micro") == 0)
+    {
+      RunMicroBenchmarks = true;
+    }else if(PositionalIndex == 0){
+      MaxEntityCount = (u32) strtoul(Argument, 0, 10);
+      PositionalIndex++;
+    }else{
+      OutputPath = Argument;
+      PositionalIndex++;
+    }
+  }
+
+  Platform.DEBUGPrint = StdoutDEBUGPrint;
+
+  FILE* Output = fopen(OutputPath, "w");
+  if(!Output)
+  {
+    fprintf(stderr, "Could not open %s\n", OutputPath);
+    return 1;
+  }
+
+  memory_arena Arena = {};
+  if(RunMicroBenchmarks)
+  {
+    entity_components_backend_benchmarks::RunBenchmarks(&Arena);
+  }
+  entity_components_backend_benchmarks::RunBenchmarkSuite(&Arena, MaxEntityCount, Output);
+  fclose(Output);
+  printf("Wrote %s\n", OutputPath);
+  return 0;
+}
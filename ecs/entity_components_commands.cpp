@@ -0,0 +1,332 @@
+#include "entity_components_commands.h"
+#include <mutex>
+#include <new>
+#include <algorithm>
+
+namespace ecs{
+
+enum class command_type
+{
+  NEW_COMPONENTS,
+  DELETE_COMPONENTS,
+  DELETE_ENTITY,
+};
+
+struct entity_command
+{
+  command_type Type;
+  u32 Sequence; // Record order, keeps the commands of one entity in order after sorting
+  entity_id EntityID;
+  component_signature ComponentFlags;
+};
+
+struct command_buffer
+{
+  memory_arena Arena;
+  std::mutex Mutex;
+
+  u32 CommandCount;
+  u32 CommandCapacity;
+  entity_command* Commands;
+
+  u32 PendingEntityCount;
+  // Entities created for the pending entity_ids by the last ApplyCommandBuffer
+  u32 AppliedEntityCount;
+  u32 AppliedEntityCapacity;
+  entity_id* AppliedEntities;
+};
+
+// The net effect of all commands on one entity
+struct entity_change
+{
+  entity_id EntityID;
+  entity* Entity; // 0 for pending entities until they get a slot
+  b32 Deleted;
+  component_signature ComponentFlags; // Components the entity has once the change is applied
+};
+
+internal inline b32 IsPending(entity_id* EntityID)
+{
+  b32 Result = EntityID->Generation == ECS_PENDING_ENTITY_GENERATION;
+  return Result;
+}
+
+// Unique per entity. Includes the generation so commands on a deleted entity and on the entity
+// reusing its slot are not mixed up. Pending entities have their own generation.
+internal inline u64 GetSortKey(const entity_id* EntityID)
+{
+  u64 Result = (((u64) EntityID->SlotIndex) << 32) | EntityID->Generation;
+  return Result;
+}
+
+internal inline b32 IsLess(const component_signature& A, const component_signature& B)
+{
+  if(A.Words[1] != B.Words[1])
+  {
+    return A.Words[1] < B.Words[1];
+  }
+  return A.Words[0] < B.Words[0];
+}
+
+internal void PushCommand(command_buffer* Buffer, command_type Type, entity_id* EntityID, component_signature ComponentFlags)
+{
+  Assert(IsValid(EntityID));
+
+  std::lock_guard<std::mutex> Lock(Buffer->Mutex);
+  // PendingEntityCount grows under the lock while other threads record entities
+  Assert(!IsPending(EntityID) || EntityID->SlotIndex < Buffer->PendingEntityCount);
+  if(Buffer->CommandCount == Buffer->CommandCapacity)
+  {
+    // The old array is left in the arena, the capacity is kept between applies
+    u32 NewCapacity = Buffer->CommandCapacity ? 2 * Buffer->CommandCapacity : 256;
+    entity_command* NewCommands = PushArray(&Buffer->Arena, NewCapacity, entity_command);
+    if(Buffer->CommandCount)
+    {
+      utils::Copy(Buffer->CommandCount * sizeof(entity_command), Buffer->Commands, NewCommands);
+    }
+    Buffer->Commands = NewCommands;
+    Buffer->CommandCapacity = NewCapacity;
+  }
+
+  entity_command* Command = Buffer->Commands + Buffer->CommandCount;
+  Command->Type = Type;
+  Command->Sequence = Buffer->CommandCount;
+  Command->EntityID = *EntityID;
+  Command->ComponentFlags = ComponentFlags;
+  Buffer->CommandCount++;
+}
+
+command_buffer* CreateCommandBuffer()
+{
+  command_buffer* Result = BootstrapPushStruct(command_buffer, Arena);
+  new (&Result->Mutex) std::mutex();
+  return Result;
+}
+
+void DestroyCommandBuffer(command_buffer* Buffer)
+{
+  Buffer->Mutex.~mutex();
+  // The buffer lives in the first block of its own arena, the arena is copied out before it is cleared
+  memory_arena Arena = Buffer->Arena;
+  Clear(&Arena);
+}
+
+entity_id DeferNewEntity(command_buffer* Buffer, component_signature ComponentFlags)
+{
+  entity_id Result = {};
+  {
+    std::lock_guard<std::mutex> Lock(Buffer->Mutex);
+    Result.SlotIndex = Buffer->PendingEntityCount++;
+    Result.Generation = ECS_PENDING_ENTITY_GENERATION;
+  }
+  if(!IsEmpty(ComponentFlags))
+  {
+    PushCommand(Buffer, command_type::NEW_COMPONENTS, &Result, ComponentFlags);
+  }
+  return Result;
+}
+
+void DeferNewComponents(command_buffer* Buffer, entity_id* EntityID, component_signature ComponentFlags)
+{
+  PushCommand(Buffer, command_type::NEW_COMPONENTS, EntityID, ComponentFlags);
+}
+
+void DeferDeleteComponents(command_buffer* Buffer, entity_id* EntityID, component_signature ComponentFlags)
+{
+  PushCommand(Buffer, command_type::DELETE_COMPONENTS, EntityID, ComponentFlags);
+}
+
+void DeferDeleteEntity(command_buffer* Buffer, entity_id* EntityID)
+{
+  PushCommand(Buffer, command_type::DELETE_ENTITY, EntityID, {});
+}
+
+u32 GetCommandCount(command_buffer* Buffer)
+{
+  std::lock_guard<std::mutex> Lock(Buffer->Mutex);
+  u32 Result = Buffer->CommandCount;
+  return Result;
+}
+
+// Folds the commands of one entity, in record order, into the components it ends up with.
+// Same rules as NewComponents and DeleteComponents.
+internal void ApplyCommand(entity_manager* EM, entity_change* Change, entity_command* Command)
+{
+  if(Change->Deleted)
+  {
+    return;
+  }
+  switch(Command->Type)
+  {
+    case command_type::NEW_COMPONENTS:
+    {
+      Change->ComponentFlags = Change->ComponentFlags | GetTotalRequirements(EM, Command->ComponentFlags);
+    }break;
+    case command_type::DELETE_COMPONENTS:
+    {
+      // Components the entity doesn't hold are ignored
+      component_signature ComponentFlags = Command->ComponentFlags & Change->ComponentFlags;
+      if(!IsEmpty(ComponentFlags))
+      {
+        component_signature Cascaded = GetCascadedRequirements(EM, Change->ComponentFlags, ComponentFlags);
+        Change->ComponentFlags = AndNot(Change->ComponentFlags, Cascaded);
+      }
+    }break;
+    case command_type::DELETE_ENTITY:
+    {
+      Change->Deleted = true;
+    }break;
+  }
+}
+
+void ApplyCommandBuffer(entity_manager* EM, command_buffer* Buffer)
+{
+  std::lock_guard<std::mutex> Lock(Buffer->Mutex);
+
+  u32 PendingEntityCount = Buffer->PendingEntityCount;
+  if(PendingEntityCount > Buffer->AppliedEntityCapacity)
+  {
+    Buffer->AppliedEntities = PushArray(&Buffer->Arena, PendingEntityCount, entity_id);
+    Buffer->AppliedEntityCapacity = PendingEntityCount;
+  }
+  Buffer->AppliedEntityCount = PendingEntityCount;
+  for(u32 PendingIndex = 0; PendingIndex < PendingEntityCount; ++PendingIndex)
+  {
+    Buffer->AppliedEntities[PendingIndex] = {};
+  }
+
+  temporary_memory TempMem = BeginTemporaryMemory(GlobalTransientArena);
+
+  // Group the commands by entity, keeping the record order within each entity
+  entity_command* Commands = Buffer->Commands;
+  u32 CommandCount = Buffer->CommandCount;
+  std::sort(Commands, Commands + CommandCount, [](const entity_command& A, const entity_command& B) -> bool
+  {
+    u64 KeyA = GetSortKey(&A.EntityID);
+    u64 KeyB = GetSortKey(&B.EntityID);
+    return KeyA != KeyB ? KeyA < KeyB : A.Sequence < B.Sequence;
+  });
+
+  // One change per entity. Commands on deleted entities are dropped.
+  // Pending entities created without components still get a change so they are allocated.
+  entity_change* Changes = PushArray(GlobalTransientArena, CommandCount + PendingEntityCount, entity_change);
+  b32* PendingHasChange = PushArray(GlobalTransientArena, PendingEntityCount, b32);
+  u32 ChangeCount = 0;
+  u32 CommandIndex = 0;
+  while(CommandIndex < CommandCount)
+  {
+    entity_id EntityID = Commands[CommandIndex].EntityID;
+    entity_change* Change = Changes + ChangeCount;
+    *Change = {};
+    Change->EntityID = EntityID;
+    b32 Skip = false;
+    if(IsPending(&EntityID))
+    {
+      PendingHasChange[EntityID.SlotIndex] = true;
+    }else{
+      Change->Entity = TryGetEntityFromID(EM, &EntityID);
+      if(Change->Entity)
+      {
+        Change->ComponentFlags = GetEntityComponentFlags(Change->Entity);
+      }else{
+        Skip = true;
+      }
+    }
+
+    component_signature InitialFlags = Change->ComponentFlags;
+    while(CommandIndex < CommandCount && GetSortKey(&Commands[CommandIndex].EntityID) == GetSortKey(&EntityID))
+    {
+      if(!Skip)
+      {
+        ApplyCommand(EM, Change, Commands + CommandIndex);
+      }
+      CommandIndex++;
+    }
+
+    // Existing entities whose components are unchanged need no work
+    b32 Unchanged = Change->Entity && !Change->Deleted && Change->ComponentFlags == InitialFlags;
+    if(!Skip && !Unchanged)
+    {
+      ChangeCount++;
+    }
+  }
+
+  for(u32 PendingIndex = 0; PendingIndex < PendingEntityCount; ++PendingIndex)
+  {
+    if(!PendingHasChange[PendingIndex])
+    {
+      entity_change* Change = Changes + ChangeCount++;
+      *Change = {};
+      Change->EntityID.SlotIndex = PendingIndex;
+      Change->EntityID.Generation = ECS_PENDING_ENTITY_GENERATION;
+    }
+  }
+
+  // Deletes go first so their rows and slots are reused by the entities created after them.
+  // The rest is sorted by destination archetype so each archetype is looked up once and
+  // its chunks are filled one after the other.
+  std::sort(Changes, Changes + ChangeCount, [](const entity_change& A, const entity_change& B) -> bool
+  {
+    if(A.Deleted != B.Deleted)
+    {
+      return A.Deleted > B.Deleted;
+    }
+    if(A.ComponentFlags != B.ComponentFlags)
+    {
+      return IsLess(A.ComponentFlags, B.ComponentFlags);
+    }
+    return GetSortKey(&A.EntityID) < GetSortKey(&B.EntityID);
+  });
+
+  // The deletes are applied together so the rows of each chunk are removed in one pass.
+  // A pending entity deleted in the same buffer is never created.
+  entity_id* DeletedIDs = PushArray(GlobalTransientArena, ChangeCount, entity_id);
+  u32 DeletedCount = 0;
+  u32 ChangeIndex = 0;
+  for(; ChangeIndex < ChangeCount && Changes[ChangeIndex].Deleted; ++ChangeIndex)
+  {
+    if(Changes[ChangeIndex].Entity)
+    {
+      DeletedIDs[DeletedCount++] = Changes[ChangeIndex].EntityID;
+    }
+  }
+  if(DeletedCount)
+  {
+    DeleteEntities(EM, DeletedCount, DeletedIDs);
+  }
+
+  archetype* Archetype = 0;
+  for(; ChangeIndex < ChangeCount; ++ChangeIndex)
+  {
+    entity_change* Change = Changes + ChangeIndex;
+    Assert(!Change->Deleted);
+    entity* Entity = Change->Entity;
+    if(!Entity)
+    {
+      Entity = AllocateEntitySlot(EM);
+      Buffer->AppliedEntities[Change->EntityID.SlotIndex] = Entity->ID;
+    }
+
+    if(IsEmpty(Change->ComponentFlags))
+    {
+      Archetype = 0;
+    }else if(!Archetype || Archetype->ComponentFlags != Change->ComponentFlags){
+      Archetype = GetOrCreateArchetype(EM, Change->ComponentFlags);
+    }
+    MoveEntityToArchetype(EM, Entity, Archetype);
+  }
+
+  EndTemporaryMemory(TempMem);
+  Buffer->CommandCount = 0;
+  Buffer->PendingEntityCount = 0;
+}
+
+entity_id GetAppliedEntityID(command_buffer* Buffer, entity_id* PendingEntityID)
+{
+  Assert(IsPending(PendingEntityID));
+  Assert(PendingEntityID->SlotIndex < Buffer->AppliedEntityCount);
+  entity_id Result = Buffer->AppliedEntities[PendingEntityID->SlotIndex];
+  return Result;
+}
+
+}
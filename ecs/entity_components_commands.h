@@ -0,0 +1,32 @@
+#pragma once
+#include "entity_components_backend.h"
+
+namespace ecs{
+
+// Records structural changes (new/deleted entities and components) to be applied later at a sync point,
+// for example while a filtered_entity_iterator is live or from the callbacks of ParallelForEachChunk.
+// Recording is thread safe. ApplyCommandBuffer folds all commands of an entity into its final set of
+// components and applies them sorted by archetype, so each entity moves at most once and entities
+// going to the same archetype fill its chunks together.
+//
+// Entities created with DeferNewEntity get a pending entity_id which can be used with the other Defer
+// functions of the same buffer. After ApplyCommandBuffer the real id is found with GetAppliedEntityID.
+struct command_buffer;
+
+command_buffer* CreateCommandBuffer();
+// Releases all memory of the buffer, it must not be recording or being applied
+void DestroyCommandBuffer(command_buffer* Buffer);
+entity_id DeferNewEntity(command_buffer* Buffer, component_signature ComponentFlags);
+void DeferNewComponents(command_buffer* Buffer, entity_id* EntityID, component_signature ComponentFlags);
+void DeferDeleteComponents(command_buffer* Buffer, entity_id* EntityID, component_signature ComponentFlags);
+void DeferDeleteEntity(command_buffer* Buffer, entity_id* EntityID);
+u32 GetCommandCount(command_buffer* Buffer);
+
+// Must not be called while recording or iterating. Commands on entities deleted before the
+// sync point are ignored. Deferred deletes are applied together, see DeleteEntities. Clears the buffer.
+void ApplyCommandBuffer(entity_manager* EM, command_buffer* Buffer);
+// The entity created for a pending entity_id by the last ApplyCommandBuffer.
+// Returns an invalid entity_id if the entity was deleted in the same buffer.
+entity_id GetAppliedEntityID(command_buffer* Buffer, entity_id* PendingEntityID);
+
+}
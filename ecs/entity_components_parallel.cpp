@@ -0,0 +1,296 @@
+#include "entity_components_parallel.h"
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <new>
+
+namespace ecs{
+
+struct worker_context
+{
+  memory_arena Arena; // Scratch memory of the thread
+  u32 ThreadIndex;
+};
+
+// The chunks of one ParallelForEachChunk call or the tasks of one ParallelForEachTask call
+struct parallel_job
+{
+  entity_manager* EM;
+  query* Query;
+  change_filter ChangeFilter;
+  archetype_chunk** Chunks;
+  u32* FirstEntityIndices;
+  parallel_chunk_callback* ChunkCallback;
+  parallel_task_callback* TaskCallback; // Set for task jobs, they have no chunks
+  u32 ItemCount;                        // Chunks or tasks
+  std::atomic<u32> NextItemIndex;
+  void* UserData;
+};
+
+struct worker_pool
+{
+  memory_arena Arena;
+  u32 WorkerCount;
+  std::thread* Workers;
+  worker_context** Contexts; // [WorkerCount + 1], the last one belongs to the calling thread
+
+  std::mutex Mutex;
+  std::condition_variable WorkAvailable;
+  std::condition_variable WorkDone;
+  u64 JobGeneration;  // Increased for every new job, workers wait for it to change
+  u32 BusyWorkerCount;
+  b32 Quit;
+  parallel_job* Job;
+};
+
+// Set while the thread works on a job shared with other threads. Jobs started from there can't be
+// handed to the other threads, they are run by this thread alone, see RunJob.
+internal thread_local worker_context* GlobalSharedJobContext;
+
+internal void RunParallelJob(parallel_job* Job, memory_arena* ScratchArena, u32 ThreadIndex)
+{
+  for(;;)
+  {
+    u32 ItemIndex = Job->NextItemIndex.fetch_add(1, std::memory_order_relaxed);
+    if(ItemIndex >= Job->ItemCount)
+    {
+      break;
+    }
+
+    temporary_memory TempMem = BeginTemporaryMemory(ScratchArena);
+    if(Job->TaskCallback)
+    {
+      parallel_task Task = {};
+      Task.TaskIndex = ItemIndex;
+      Task.ThreadIndex = ThreadIndex;
+      Task.ScratchArena = ScratchArena;
+      Job->TaskCallback(&Task, Job->UserData);
+    }else{
+      parallel_chunk Chunk = {};
+      Chunk.Iterator.EM = Job->EM;
+      Chunk.Iterator.Query = Job->Query;
+      Chunk.Iterator.ArchetypeIndex = Job->Query->ArchetypeCount;
+      Chunk.Iterator.CurrentChunk = Job->Chunks[ItemIndex];
+      Chunk.Iterator.ChangeFilter = Job->ChangeFilter;
+      Chunk.ChunkIndex = ItemIndex;
+      Chunk.FirstEntityIndex = Job->FirstEntityIndices[ItemIndex];
+      Chunk.ThreadIndex = ThreadIndex;
+      Chunk.ScratchArena = ScratchArena;
+      Job->ChunkCallback(&Chunk, Job->UserData);
+    }
+    EndTemporaryMemory(TempMem);
+  }
+}
+
+internal void WorkerThreadMain(worker_pool* Pool, worker_context* Context)
+{
+  // Workers only ever run shared jobs
+  GlobalSharedJobContext = Context;
+  u64 SeenGeneration = 0;
+  for(;;)
+  {
+    parallel_job* Job = 0;
+    {
+      std::unique_lock<std::mutex> Lock(Pool->Mutex);
+      Pool->WorkAvailable.wait(Lock, [Pool, SeenGeneration]{ return Pool->Quit || Pool->JobGeneration != SeenGeneration; });
+      if(Pool->Quit)
+      {
+        return;
+      }
+      SeenGeneration = Pool->JobGeneration;
+      Job = Pool->Job;
+    }
+
+    RunParallelJob(Job, &Context->Arena, Context->ThreadIndex);
+
+    {
+      std::lock_guard<std::mutex> Lock(Pool->Mutex);
+      Assert(Pool->BusyWorkerCount > 0);
+      if(--Pool->BusyWorkerCount == 0)
+      {
+        Pool->WorkDone.notify_one();
+      }
+    }
+  }
+}
+
+worker_pool* CreateWorkerPool(u32 WorkerCount)
+{
+  worker_pool* Result = BootstrapPushStruct(worker_pool, Arena);
+  // The pool memory comes zeroed from the arena, the synchronization objects still need their constructors
+  new (&Result->Mutex) std::mutex();
+  new (&Result->WorkAvailable) std::condition_variable();
+  new (&Result->WorkDone) std::condition_variable();
+
+  Result->WorkerCount = WorkerCount;
+  Result->Contexts = PushArray(&Result->Arena, WorkerCount + 1, worker_context*);
+  for(u32 ThreadIndex = 0; ThreadIndex < WorkerCount + 1; ++ThreadIndex)
+  {
+    worker_context* Context = BootstrapPushStruct(worker_context, Arena);
+    Context->ThreadIndex = ThreadIndex;
+    Result->Contexts[ThreadIndex] = Context;
+  }
+
+  Result->Workers = PushArray(&Result->Arena, WorkerCount, std::thread);
+  for(u32 WorkerIndex = 0; WorkerIndex < WorkerCount; ++WorkerIndex)
+  {
+    new (Result->Workers + WorkerIndex) std::thread(WorkerThreadMain, Result, Result->Contexts[WorkerIndex]);
+  }
+  return Result;
+}
+
+worker_pool* CreateWorkerPool()
+{
+  u32 CoreCount = std::thread::hardware_concurrency();
+  worker_pool* Result = CreateWorkerPool(CoreCount > 1 ? CoreCount - 1 : 0);
+  return Result;
+}
+
+void DestroyWorkerPool(worker_pool* Pool)
+{
+  {
+    std::lock_guard<std::mutex> Lock(Pool->Mutex);
+    Pool->Quit = true;
+  }
+  Pool->WorkAvailable.notify_all();
+  for(u32 WorkerIndex = 0; WorkerIndex < Pool->WorkerCount; ++WorkerIndex)
+  {
+    Pool->Workers[WorkerIndex].join();
+    Pool->Workers[WorkerIndex].~thread();
+  }
+  Pool->WorkDone.~condition_variable();
+  Pool->WorkAvailable.~condition_variable();
+  Pool->Mutex.~mutex();
+
+  // Every context and the pool live in the first block of their own arena, the arenas are copied out before
+  // they are cleared. The contexts go first, the array pointing to them is in the pool arena.
+  for(u32 ThreadIndex = 0; ThreadIndex < Pool->WorkerCount + 1; ++ThreadIndex)
+  {
+    memory_arena ContextArena = Pool->Contexts[ThreadIndex]->Arena;
+    Clear(&ContextArena);
+  }
+  memory_arena PoolArena = Pool->Arena;
+  Clear(&PoolArena);
+}
+
+u32 GetThreadCount(worker_pool* Pool)
+{
+  u32 Result = Pool ? Pool->WorkerCount + 1 : 1;
+  return Result;
+}
+
+// Memory for the bookkeeping of a job started on this thread
+internal memory_arena* GetJobArena(worker_pool* Pool)
+{
+  memory_arena* Result = GlobalSharedJobContext ? &GlobalSharedJobContext->Arena :
+                         Pool                   ? &Pool->Arena : GlobalTransientArena;
+  return Result;
+}
+
+// Runs Job on all threads of Pool and returns when it is done. Small jobs and jobs started from within
+// a shared job are run by the calling thread alone.
+internal void RunJob(worker_pool* Pool, parallel_job* Job)
+{
+  if(GlobalSharedJobContext)
+  {
+    // The other threads are busy with the outer job or wait for it to finish
+    RunParallelJob(Job, &GlobalSharedJobContext->Arena, GlobalSharedJobContext->ThreadIndex);
+  }else if(!Pool){
+    RunParallelJob(Job, GlobalTransientArena, 0);
+  }else if(Pool->WorkerCount == 0 || Job->ItemCount < 2){
+    worker_context* Context = Pool->Contexts[Pool->WorkerCount];
+    RunParallelJob(Job, &Context->Arena, Context->ThreadIndex);
+  }else{
+    {
+      std::lock_guard<std::mutex> Lock(Pool->Mutex);
+      Assert(!Pool->BusyWorkerCount); // Only one thread at a time may start jobs on a pool
+      Pool->Job = Job;
+      Pool->BusyWorkerCount = Pool->WorkerCount;
+      Pool->JobGeneration++;
+    }
+    Pool->WorkAvailable.notify_all();
+
+    worker_context* Context = Pool->Contexts[Pool->WorkerCount];
+    GlobalSharedJobContext = Context;
+    RunParallelJob(Job, &Context->Arena, Context->ThreadIndex);
+    GlobalSharedJobContext = 0;
+
+    std::unique_lock<std::mutex> Lock(Pool->Mutex);
+    Pool->WorkDone.wait(Lock, [Pool]{ return Pool->BusyWorkerCount == 0; });
+    Pool->Job = 0;
+  }
+}
+
+u32 ParallelForEachChunk(worker_pool* Pool, entity_manager* EM, query* Query, change_filter Filter, parallel_chunk_callback* Callback, void* UserData)
+{
+  Assert(HasAll(Query->ComponentFlags, Filter.ComponentFlags));
+  b32 UseChangeFilter = !IsEmpty(Filter.ComponentFlags);
+  memory_arena* Arena = GetJobArena(Pool);
+  temporary_memory TempMem = BeginTemporaryMemory(Arena);
+
+  // Split the query into chunk sized ranges up front so the workers only have to bump a counter
+  u32 MaxChunkCount = 0;
+  for(u32 ArchetypeIndex = 0; ArchetypeIndex < Query->ArchetypeCount; ++ArchetypeIndex)
+  {
+    MaxChunkCount += Query->Archetypes[ArchetypeIndex]->ChunkCount;
+  }
+
+  parallel_job* Job = PushStruct(Arena, parallel_job);
+  new (&Job->NextItemIndex) std::atomic<u32>(0);
+  Job->EM = EM;
+  Job->Query = Query;
+  Job->ChangeFilter = Filter;
+  Job->ChunkCallback = Callback;
+  Job->UserData = UserData;
+  Job->Chunks = PushArray(Arena, MaxChunkCount, archetype_chunk*);
+  Job->FirstEntityIndices = PushArray(Arena, MaxChunkCount, u32);
+
+  u32 ChunkIndex = 0;
+  u32 EntityCount = 0;
+  for(u32 ArchetypeIndex = 0; ArchetypeIndex < Query->ArchetypeCount; ++ArchetypeIndex)
+  {
+    for(archetype_chunk* Chunk = Query->Archetypes[ArchetypeIndex]->FirstChunk; Chunk; Chunk = Chunk->Next)
+    {
+      if(UseChangeFilter && !HasChunkChanged(Chunk, &Filter))
+      {
+        continue;
+      }
+      Job->Chunks[ChunkIndex] = Chunk;
+      Job->FirstEntityIndices[ChunkIndex] = EntityCount;
+      EntityCount += Chunk->EntityCount;
+      ChunkIndex++;
+    }
+  }
+  Job->ItemCount = ChunkIndex;
+
+  RunJob(Pool, Job);
+
+  Job->NextItemIndex.~atomic();
+  EndTemporaryMemory(TempMem);
+  return EntityCount;
+}
+
+u32 ParallelForEachChunk(worker_pool* Pool, entity_manager* EM, query* Query, parallel_chunk_callback* Callback, void* UserData)
+{
+  u32 Result = ParallelForEachChunk(Pool, EM, Query, change_filter{}, Callback, UserData);
+  return Result;
+}
+
+void ParallelForEachTask(worker_pool* Pool, u32 TaskCount, parallel_task_callback* Callback, void* UserData)
+{
+  memory_arena* Arena = GetJobArena(Pool);
+  temporary_memory TempMem = BeginTemporaryMemory(Arena);
+  parallel_job* Job = PushStruct(Arena, parallel_job);
+  new (&Job->NextItemIndex) std::atomic<u32>(0);
+  Job->TaskCallback = Callback;
+  Job->UserData = UserData;
+  Job->ItemCount = TaskCount;
+
+  RunJob(Pool, Job);
+
+  Job->NextItemIndex.~atomic();
+  EndTemporaryMemory(TempMem);
+}
+
+}
@@ -0,0 +1,62 @@
+#pragma once
+#include "entity_components_backend.h"
+
+namespace ecs{
+
+// Pool of worker threads running jobs over the chunks of a query or over a number of tasks.
+// The calling thread works on every job too, a pool with N-1 workers runs jobs on N threads.
+// Every thread owns a scratch arena which is reset after each chunk or task.
+// Jobs started from the callbacks of another job are run by the thread starting them, see ParallelForEachTask.
+// NOTE: The workers run code of the application dll, the pool has to be destroyed before the dll is unloaded.
+// DestroyWorkerPool joins the workers and releases all memory of the pool, see ApplicationUpdateAndRender.
+struct worker_pool;
+
+worker_pool* CreateWorkerPool(u32 WorkerCount);
+// One worker per logical core, minus the calling thread
+worker_pool* CreateWorkerPool();
+void DestroyWorkerPool(worker_pool* Pool);
+// Number of threads working on a job, including the calling thread
+u32 GetThreadCount(worker_pool* Pool);
+
+// What a parallel_chunk_callback gets for each chunk.
+// Iterator is positioned on the chunk, use GetComponentArray and GetChunkEntityCount on it.
+// Don't step it with Next or NextChunk, the next chunk belongs to another thread.
+struct parallel_chunk
+{
+  filtered_entity_iterator Iterator;
+  u32 ChunkIndex;             // Index of the chunk among all chunks visited by the job
+  u32 FirstEntityIndex;       // Number of entities in the chunks before this one. Use to write results without locking.
+  u32 ThreadIndex;            // [0, GetThreadCount(Pool))
+  memory_arena* ScratchArena; // Owned by the thread, reset after the callback returns
+};
+
+// Callbacks ignoring Chunk or UserData write the signature out with that parameter unnamed
+#define ECS_PARALLEL_CHUNK_CALLBACK(name) void name(parallel_chunk* Chunk, void* UserData)
+typedef ECS_PARALLEL_CHUNK_CALLBACK(parallel_chunk_callback);
+
+// Runs Callback once for every chunk in Query, spread over the threads of Pool. Returns when all chunks are done.
+// Callbacks may read and write the components of their chunk but must not add or remove entities or components.
+// Pool may be 0, the chunks are then visited on the calling thread.
+// Returns the number of entities visited.
+u32 ParallelForEachChunk(worker_pool* Pool, entity_manager* EM, query* Query, parallel_chunk_callback* Callback, void* UserData);
+// Only visits the chunks passing Filter, see change_filter. Returns the number of entities visited.
+u32 ParallelForEachChunk(worker_pool* Pool, entity_manager* EM, query* Query, change_filter Filter, parallel_chunk_callback* Callback, void* UserData);
+
+// What a parallel_task_callback gets for each task
+struct parallel_task
+{
+  u32 TaskIndex;              // [0, TaskCount)
+  u32 ThreadIndex;            // [0, GetThreadCount(Pool))
+  memory_arena* ScratchArena; // Owned by the thread, reset after the callback returns
+};
+
+#define ECS_PARALLEL_TASK_CALLBACK(name) void name(parallel_task* Task, void* UserData)
+typedef ECS_PARALLEL_TASK_CALLBACK(parallel_task_callback);
+
+// Runs Callback once for each of TaskCount tasks, spread over the threads of Pool. Returns when all tasks are done.
+// A task may start jobs of its own with ParallelForEachChunk or ParallelForEachTask. While the task shares
+// the pool with other tasks those jobs are run by the thread of the task alone, a single task gets the whole pool.
+// Pool may be 0, the tasks are then run on the calling thread.
+void ParallelForEachTask(worker_pool* Pool, u32 TaskCount, parallel_task_callback* Callback, void* UserData);
+
+}
@@ -0,0 +1,229 @@
+#include "entity_components_scheduler.h"
+#include <chrono>
+
+namespace ecs{
+
+struct scheduled_system
+{
+  const char* Name;
+  component_signature ReadFlags;
+  component_signature WriteFlags;
+  system_callback* Callback;
+  void* UserData;
+  b32 Enabled;
+
+  // Rebuilt by every RunSystems
+  u64 Dependencies;
+  u32 Level;
+
+  // Written by the thread running the system
+  u32 ThreadIndex;
+  u32 RunCount;
+  r64 LastSeconds;
+  r64 TotalSeconds;
+};
+
+struct scheduler
+{
+  memory_arena Arena;
+  u32 SystemCount;
+  scheduled_system Systems[ECS_MAX_SCHEDULED_SYSTEMS];
+  u32 LevelCount;
+  r64 LastSeconds;
+};
+
+// The systems of one level of a RunSystems call
+struct system_level_job
+{
+  scheduler* Scheduler;
+  entity_manager* EM;
+  worker_pool* Pool;
+  u32 ChangeVersion;
+  u32 SystemCount;
+  u32 SystemIndices[ECS_MAX_SCHEDULED_SYSTEMS];
+};
+
+internal r64 GetSchedulerClockSeconds()
+{
+  r64 Result = std::chrono::duration<r64>(std::chrono::steady_clock::now().time_since_epoch()).count();
+  return Result;
+}
+
+scheduler* CreateScheduler()
+{
+  scheduler* Result = BootstrapPushStruct(scheduler, Arena);
+  return Result;
+}
+
+u32 AddSystem(scheduler* Scheduler, const char* Name, component_signature ReadFlags, component_signature WriteFlags,
+              system_callback* Callback, void* UserData)
+{
+  Assert(Scheduler->SystemCount < ECS_MAX_SCHEDULED_SYSTEMS);
+  u32 Result = Scheduler->SystemCount++;
+  scheduled_system* System = Scheduler->Systems + Result;
+  *System = {};
+  System->Name = Name;
+  System->ReadFlags = ReadFlags;
+  System->WriteFlags = WriteFlags;
+  System->Callback = Callback;
+  System->UserData = UserData;
+  System->Enabled = true;
+  return Result;
+}
+
+void SetSystemEnabled(scheduler* Scheduler, u32 SystemIndex, b32 Enabled)
+{
+  Assert(SystemIndex < Scheduler->SystemCount);
+  Scheduler->Systems[SystemIndex].Enabled = Enabled;
+}
+
+void RemoveAllSystems(scheduler* Scheduler)
+{
+  Scheduler->SystemCount = 0;
+  Scheduler->LevelCount = 0;
+}
+
+internal b32 SystemsConflict(scheduled_system* A, scheduled_system* B)
+{
+  component_signature Conflicts = (A->WriteFlags & (B->ReadFlags | B->WriteFlags)) | (B->WriteFlags & A->ReadFlags);
+  b32 Result = !IsEmpty(Conflicts);
+  return Result;
+}
+
+// Links every enabled system to the enabled systems added before it that it conflicts with and puts it
+// one level above the highest of them
+internal void BuildSystemLevels(scheduler* Scheduler)
+{
+  Scheduler->LevelCount = 0;
+  for(u32 SystemIndex = 0; SystemIndex < Scheduler->SystemCount; ++SystemIndex)
+  {
+    scheduled_system* System = Scheduler->Systems + SystemIndex;
+    System->Dependencies = 0;
+    System->Level = 0;
+    if(!System->Enabled)
+    {
+      continue;
+    }
+
+    for(u32 EarlierIndex = 0; EarlierIndex < SystemIndex; ++EarlierIndex)
+    {
+      scheduled_system* Earlier = Scheduler->Systems + EarlierIndex;
+      if(Earlier->Enabled && SystemsConflict(Earlier, System))
+      {
+        System->Dependencies |= (u64) 1 << EarlierIndex;
+        System->Level = Maximum(System->Level, Earlier->Level + 1);
+      }
+    }
+    Scheduler->LevelCount = Maximum(Scheduler->LevelCount, System->Level + 1);
+  }
+}
+
+internal ECS_PARALLEL_TASK_CALLBACK(RunSystemTask)
+{
+  system_level_job* Job = (system_level_job*) UserData;
+  scheduled_system* System = Job->Scheduler->Systems + Job->SystemIndices[Task->TaskIndex];
+
+  system_context Context = {};
+  Context.EM = Job->EM;
+  Context.Pool = Job->Pool;
+  Context.ChangeVersion = Job->ChangeVersion;
+  Context.ThreadIndex = Task->ThreadIndex;
+  Context.ScratchArena = Task->ScratchArena;
+
+  r64 Begin = GetSchedulerClockSeconds();
+  System->Callback(&Context, System->UserData);
+  System->LastSeconds = GetSchedulerClockSeconds() - Begin;
+  System->TotalSeconds += System->LastSeconds;
+  System->RunCount++;
+  System->ThreadIndex = Task->ThreadIndex;
+}
+
+void RunSystems(scheduler* Scheduler, entity_manager* EM, worker_pool* Pool)
+{
+  r64 Begin = GetSchedulerClockSeconds();
+  BuildSystemLevels(Scheduler);
+
+  system_level_job Job = {};
+  Job.Scheduler = Scheduler;
+  Job.EM = EM;
+  Job.Pool = Pool;
+  Job.ChangeVersion = AdvanceChangeVersion(EM);
+  for(u32 Level = 0; Level < Scheduler->LevelCount; ++Level)
+  {
+    Job.SystemCount = 0;
+    for(u32 SystemIndex = 0; SystemIndex < Scheduler->SystemCount; ++SystemIndex)
+    {
+      scheduled_system* System = Scheduler->Systems + SystemIndex;
+      if(System->Enabled && System->Level == Level)
+      {
+        Job.SystemIndices[Job.SystemCount++] = SystemIndex;
+      }
+    }
+    ParallelForEachTask(Pool, Job.SystemCount, RunSystemTask, &Job);
+  }
+  Scheduler->LastSeconds = GetSchedulerClockSeconds() - Begin;
+}
+
+scheduler_stats GetSchedulerStats(scheduler* Scheduler, system_stats* SystemStats)
+{
+  scheduler_stats Result = {};
+  Result.SystemCount = Scheduler->SystemCount;
+  Result.LevelCount = Scheduler->LevelCount;
+  Result.LastSeconds = Scheduler->LastSeconds;
+  for(u32 SystemIndex = 0; SystemIndex < Scheduler->SystemCount; ++SystemIndex)
+  {
+    scheduled_system* System = Scheduler->Systems + SystemIndex;
+    if(System->Enabled)
+    {
+      Result.LastSystemSeconds += System->LastSeconds;
+    }
+    if(SystemStats)
+    {
+      system_stats* Stats = SystemStats + SystemIndex;
+      Stats->Name = System->Name;
+      Stats->Enabled = System->Enabled;
+      Stats->Dependencies = System->Dependencies;
+      Stats->Level = System->Level;
+      Stats->ThreadIndex = System->ThreadIndex;
+      Stats->RunCount = System->RunCount;
+      Stats->LastSeconds = System->LastSeconds;
+      Stats->AverageSeconds = System->RunCount ? System->TotalSeconds / System->RunCount : 0;
+    }
+  }
+  return Result;
+}
+
+void PrintSchedulerReport(scheduler* Scheduler)
+{
+  temporary_memory TempMem = BeginTemporaryMemory(GlobalTransientArena);
+  system_stats* SystemStats = PushArray(GlobalTransientArena, Scheduler->SystemCount, system_stats);
+  scheduler_stats Stats = GetSchedulerStats(Scheduler, SystemStats);
+
+  r64 MS = 1000.0;
+  Platform.DEBUGPrint("Systems\n");
+  Platform.DEBUGPrint("  %u systems in %u levels: %.3f ms, %.3f ms of system time\n",
+    Stats.SystemCount, Stats.LevelCount, Stats.LastSeconds * MS, Stats.LastSystemSeconds * MS);
+  Platform.DEBUGPrint("  %-24s %6s %7s %10s %10s  %s\n", "Name", "Level", "Thread", "Last ms", "Average ms", "Runs after");
+  for(u32 SystemIndex = 0; SystemIndex < Stats.SystemCount; ++SystemIndex)
+  {
+    system_stats* System = SystemStats + SystemIndex;
+    if(!System->Enabled)
+    {
+      Platform.DEBUGPrint("  %-24s %6s\n", System->Name, "off");
+      continue;
+    }
+    Platform.DEBUGPrint("  %-24s %6u %7u %10.3f %10.3f ", System->Name, System->Level, System->ThreadIndex,
+      System->LastSeconds * MS, System->AverageSeconds * MS);
+    for(u32 DependencyIndex = 0; DependencyIndex < SystemIndex; ++DependencyIndex)
+    {
+      if(System->Dependencies & ((u64) 1 << DependencyIndex))
+      {
+        Platform.DEBUGPrint(" %s", SystemStats[DependencyIndex].Name);
+      }
+    }
+    Platform.DEBUGPrint("\n");
+  }
+  EndTemporaryMemory(TempMem);
+}
+
+}
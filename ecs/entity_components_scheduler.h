@@ -0,0 +1,72 @@
+#pragma once
+#include "entity_components_backend.h"
+#include "entity_components_parallel.h"
+
+namespace ecs{
+
+// Runs the systems of a frame. Every system declares the component types it reads and writes, two systems
+// conflict if one of them writes a type the other reads or writes. Each RunSystems orders the enabled systems
+// into levels: a system goes one level above the last system registered before it that it conflicts with.
+// The systems of a level don't conflict and run at the same time on a worker pool, levels run one after another.
+// A system alone in its level can spread its chunks over the whole pool. Systems sharing a level run one per
+// thread and their own ParallelForEachChunk calls stay on that thread, see ParallelForEachTask.
+//
+// Systems may only touch the component types they declared. They must not add or remove entities or components
+// or register queries, record structural changes in a command_buffer and apply it after RunSystems.
+//   AddSystem(Scheduler, "Positions", 0, flag::POSITION, position::RunPositionSystem, PositionSystem);
+//   RunSystems(Scheduler, EM, Pool);
+struct scheduler;
+
+#define ECS_MAX_SCHEDULED_SYSTEMS 64
+
+// What a system_callback gets when it runs
+struct system_context
+{
+  entity_manager* EM;
+  worker_pool* Pool;          // Hand to ParallelForEachChunk
+  u32 ChangeVersion;          // Result of the AdvanceChangeVersion done by RunSystems, systems don't advance it themselves
+  u32 ThreadIndex;            // [0, GetThreadCount(Pool))
+  memory_arena* ScratchArena; // Owned by the thread, reset after the callback returns
+};
+
+#define ECS_SYSTEM_CALLBACK(name) void name(system_context* Context, void* UserData)
+typedef ECS_SYSTEM_CALLBACK(system_callback);
+
+scheduler* CreateScheduler();
+// Returns the index of the system. Systems conflicting with each other run in the order they were added.
+u32 AddSystem(scheduler* Scheduler, const char* Name, component_signature ReadFlags, component_signature WriteFlags,
+              system_callback* Callback, void* UserData);
+// Disabled systems are skipped and don't hold back the systems conflicting with them
+void SetSystemEnabled(scheduler* Scheduler, u32 SystemIndex, b32 Enabled);
+// Forgets all systems. Name and Callback are kept as pointers, when they point into a dll that gets reloaded
+// the systems have to be removed and added again after the reload.
+void RemoveAllSystems(scheduler* Scheduler);
+// Runs all enabled systems once. Pool may be 0, the systems then run one after another on the calling thread.
+void RunSystems(scheduler* Scheduler, entity_manager* EM, worker_pool* Pool);
+
+struct system_stats
+{
+  const char* Name;
+  b32 Enabled;
+  u64 Dependencies;  // Bit N is set if the system waits for system N
+  u32 Level;
+  u32 ThreadIndex;   // Thread it last ran on
+  u32 RunCount;
+  r64 LastSeconds;
+  r64 AverageSeconds;
+};
+
+struct scheduler_stats
+{
+  u32 SystemCount;
+  u32 LevelCount;
+  r64 LastSeconds;       // Wall time of the last RunSystems
+  r64 LastSystemSeconds; // Time of all systems of the last RunSystems added up
+};
+
+// Of the last RunSystems. SystemStats [SystemCount] may be 0.
+scheduler_stats GetSchedulerStats(scheduler* Scheduler, system_stats* SystemStats);
+// Prints the levels and timings of the systems with Platform.DEBUGPrint
+void PrintSchedulerReport(scheduler* Scheduler);
+
+}
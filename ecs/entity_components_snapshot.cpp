@@ -0,0 +1,447 @@
+#include "entity_components_snapshot.h"
+#include <string.h>
+
+namespace ecs{
+
+#define ECS_SNAPSHOT_MAGIC 0x53434345 // "ECCS"
+#define ECS_SNAPSHOT_VERSION 3
+
+// Snapshot layout, all offsets are from the start of the snapshot:
+//   | snapshot_header | snapshot_component_type [ComponentTypeCount] | shared values | snapshot_archetype [ArchetypeCount] |
+//   | snapshot_slot [EntitySlotCount] | padding | chunk blobs [ChunkCount] |
+// The shared values are the SharedValueCount values of each shared component, in component order.
+// The chunks of each archetype follow each other in the order of the archetypes.
+struct snapshot_header
+{
+  u32 Magic;
+  u32 Version;
+  u32 ChunkByteSize;
+  u32 PointerByteSize;
+  u32 ComponentTypeCount;
+  u32 ArchetypeCount;
+  u32 ChunkCount;
+  u32 EntitySlotCount;
+  u32 EntityCount;
+  u32 FirstFreeEntitySlot;
+  u64 ComponentTypesOffset;
+  u64 SharedValuesOffset;
+  u64 ArchetypesOffset;
+  u64 SlotsOffset;
+  u64 ChunksOffset;
+  u64 ByteSize;
+};
+
+// Enough of the component definitions to tell if the chunk layouts match
+struct snapshot_component_type
+{
+  component_signature Type;
+  u32 ComponentByteSize;
+  u32 ComponentChunkCount;
+  u32 FieldCount;
+  u32 InstanceCapacity;
+  u32 SharedValueCapacity;
+  u32 SharedValueCount;
+};
+
+struct snapshot_archetype
+{
+  component_signature ComponentFlags;
+  u32 ChunkCapacity;
+  u32 ChunkCount;
+};
+
+struct snapshot_slot
+{
+  u32 Generation;
+  u32 NextFreeSlot; // Only meaningful for free slots
+};
+
+struct snapshot_layout
+{
+  u32 ArchetypeCount;
+  u32 ChunkCount;
+  midx ComponentTypesOffset;
+  midx SharedValuesOffset;
+  midx ArchetypesOffset;
+  midx SlotsOffset;
+  midx ChunksOffset;
+  midx ByteSize;
+};
+
+internal snapshot_layout GetSnapshotLayout(entity_manager* EM)
+{
+  snapshot_layout Result = {};
+  chunk_list_iterator Iterator = BeginIterator(&EM->Archetypes);
+  while(archetype* Archetype = (archetype*) Next(&Iterator))
+  {
+    if(Archetype->ChunkCount)
+    {
+      Result.ArchetypeCount++;
+      Result.ChunkCount += Archetype->ChunkCount;
+    }
+  }
+
+  midx SharedValuesByteSize = 0;
+  for(u32 ComponentIndex = 0; ComponentIndex < EM->ComponentTypeCount; ++ComponentIndex)
+  {
+    component_list* ComponentList = EM->ComponentTypeVector + ComponentIndex;
+    SharedValuesByteSize += ComponentList->SharedValueCount * (midx) ComponentList->ComponentByteSize;
+  }
+
+  Result.ComponentTypesOffset = sizeof(snapshot_header);
+  Result.SharedValuesOffset = Result.ComponentTypesOffset + EM->ComponentTypeCount * sizeof(snapshot_component_type);
+  Result.ArchetypesOffset = GetAlignedOffset(Result.SharedValuesOffset + SharedValuesByteSize, ECS_COMPONENT_ALIGNMENT);
+  Result.SlotsOffset = Result.ArchetypesOffset + Result.ArchetypeCount * sizeof(snapshot_archetype);
+  Result.ChunksOffset = GetAlignedOffset(Result.SlotsOffset + EM->EntitySlotCount * sizeof(snapshot_slot), ECS_ARCHETYPE_CHUNK_BYTE_SIZE);
+  Result.ByteSize = Result.ChunksOffset + Result.ChunkCount * (midx) ECS_ARCHETYPE_CHUNK_BYTE_SIZE;
+  return Result;
+}
+
+midx GetSnapshotByteSize(entity_manager* EM)
+{
+  midx Result = GetSnapshotLayout(EM).ByteSize;
+  return Result;
+}
+
+midx WriteSnapshot(entity_manager* EM, void* Memory, midx MemoryByteSize)
+{
+  snapshot_layout Layout = GetSnapshotLayout(EM);
+  if(Layout.ByteSize > MemoryByteSize)
+  {
+    return 0;
+  }
+
+  bptr Base = (bptr) Memory;
+  snapshot_header* Header = (snapshot_header*) Base;
+  *Header = {};
+  Header->Magic = ECS_SNAPSHOT_MAGIC;
+  Header->Version = ECS_SNAPSHOT_VERSION;
+  Header->ChunkByteSize = ECS_ARCHETYPE_CHUNK_BYTE_SIZE;
+  Header->PointerByteSize = sizeof(entity*);
+  Header->ComponentTypeCount = EM->ComponentTypeCount;
+  Header->ArchetypeCount = Layout.ArchetypeCount;
+  Header->ChunkCount = Layout.ChunkCount;
+  Header->EntitySlotCount = EM->EntitySlotCount;
+  Header->EntityCount = EM->EntityCount;
+  Header->FirstFreeEntitySlot = EM->FirstFreeEntitySlot;
+  Header->ComponentTypesOffset = Layout.ComponentTypesOffset;
+  Header->SharedValuesOffset = Layout.SharedValuesOffset;
+  Header->ArchetypesOffset = Layout.ArchetypesOffset;
+  Header->SlotsOffset = Layout.SlotsOffset;
+  Header->ChunksOffset = Layout.ChunksOffset;
+  Header->ByteSize = Layout.ByteSize;
+
+  snapshot_component_type* ComponentTypes = (snapshot_component_type*) (Base + Layout.ComponentTypesOffset);
+  bptr SharedValues = Base + Layout.SharedValuesOffset;
+  for(u32 ComponentIndex = 0; ComponentIndex < EM->ComponentTypeCount; ++ComponentIndex)
+  {
+    component_list* ComponentList = EM->ComponentTypeVector + ComponentIndex;
+    snapshot_component_type* ComponentType = ComponentTypes + ComponentIndex;
+    *ComponentType = {};
+    ComponentType->Type = ComponentList->Type;
+    ComponentType->ComponentByteSize = ComponentList->ComponentByteSize;
+    ComponentType->ComponentChunkCount = ComponentList->ComponentChunkCount;
+    ComponentType->FieldCount = ComponentList->FieldCount;
+    ComponentType->InstanceCapacity = ComponentList->InstanceCapacity;
+    ComponentType->SharedValueCapacity = ComponentList->SharedValueCapacity;
+    ComponentType->SharedValueCount = ComponentList->SharedValueCount;
+    midx SharedValuesByteSize = ComponentList->SharedValueCount * (midx) ComponentList->ComponentByteSize;
+    if(SharedValuesByteSize)
+    {
+      utils::Copy(SharedValuesByteSize, ComponentList->SharedValues, SharedValues);
+      SharedValues += SharedValuesByteSize;
+    }
+  }
+  memset(SharedValues, 0, (Base + Layout.ArchetypesOffset) - SharedValues);
+
+  snapshot_slot* Slots = (snapshot_slot*) (Base + Layout.SlotsOffset);
+  for(u32 SlotIndex = 0; SlotIndex < EM->EntitySlotCount; ++SlotIndex)
+  {
+    entity* Entity = GetEntitySlot(EM, SlotIndex);
+    Slots[SlotIndex].Generation = Entity->ID.Generation;
+    Slots[SlotIndex].NextFreeSlot = Entity->NextFreeSlot;
+  }
+  memset(Base + Layout.SlotsOffset + EM->EntitySlotCount * sizeof(snapshot_slot), 0,
+         Layout.ChunksOffset - Layout.SlotsOffset - EM->EntitySlotCount * sizeof(snapshot_slot));
+
+  snapshot_archetype* Archetypes = (snapshot_archetype*) (Base + Layout.ArchetypesOffset);
+  u32 ArchetypeIndex = 0;
+  bptr ChunkBlob = Base + Layout.ChunksOffset;
+  chunk_list_iterator Iterator = BeginIterator(&EM->Archetypes);
+  while(archetype* Archetype = (archetype*) Next(&Iterator))
+  {
+    if(!Archetype->ChunkCount)
+    {
+      continue;
+    }
+    snapshot_archetype* SnapshotArchetype = Archetypes + ArchetypeIndex++;
+    SnapshotArchetype->ComponentFlags = Archetype->ComponentFlags;
+    SnapshotArchetype->ChunkCapacity = Archetype->ChunkCapacity;
+    SnapshotArchetype->ChunkCount = Archetype->ChunkCount;
+
+    for(archetype_chunk* Chunk = Archetype->FirstChunk; Chunk; Chunk = Chunk->Next)
+    {
+      utils::Copy(ECS_ARCHETYPE_CHUNK_BYTE_SIZE, Chunk, ChunkBlob);
+
+      // The chunk links are rebuilt on restore, the rows hold entity ids which are kept as they are
+      archetype_chunk* BlobHeader = (archetype_chunk*) ChunkBlob;
+      *BlobHeader = {};
+      BlobHeader->EntityCount = Chunk->EntityCount;
+      ChunkBlob += ECS_ARCHETYPE_CHUNK_BYTE_SIZE;
+    }
+  }
+  Assert(ArchetypeIndex == Layout.ArchetypeCount);
+  Assert(ChunkBlob == Base + Layout.ByteSize);
+  return Layout.ByteSize;
+}
+
+// True if ByteSize bytes at Offset lie within the snapshot, written so that no sum can overflow
+internal b32 IsInSnapshot(snapshot_header const* Header, u64 Offset, u64 ByteSize)
+{
+  b32 Result = Offset <= Header->ByteSize && ByteSize <= Header->ByteSize - Offset;
+  return Result;
+}
+
+// What a slot turned out to be while checking the entities of a snapshot
+#define ECS_SNAPSHOT_SLOT_LIVE 0
+#define ECS_SNAPSHOT_SLOT_FREE 1
+#define ECS_SNAPSHOT_SLOT_IN_ROW 2
+
+// The part of IsSnapshotCompatible that goes through the slots and rows, SlotStates starts out all live.
+// The free list must end within EntitySlotCount steps, every other slot is a live entity, and each live
+// entity sits in at most one row. Entities without components have no row.
+internal b32 AreSnapshotEntitiesValid(entity_manager* EM, snapshot_header const* Header, u8* SlotStates)
+{
+  bptr Base = (bptr) Header;
+  snapshot_component_type const* ComponentTypes = (snapshot_component_type const*) (Base + Header->ComponentTypesOffset);
+  snapshot_slot const* Slots = (snapshot_slot const*) (Base + Header->SlotsOffset);
+  u32 FreeSlotCount = 0;
+  for(u32 SlotIndex = Header->FirstFreeEntitySlot; SlotIndex != U32Max; SlotIndex = Slots[SlotIndex].NextFreeSlot)
+  {
+    // Out of the slots, or a slot seen before which closes a cycle
+    if(SlotIndex >= Header->EntitySlotCount || SlotStates[SlotIndex] == ECS_SNAPSHOT_SLOT_FREE)
+    {
+      return false;
+    }
+    SlotStates[SlotIndex] = ECS_SNAPSHOT_SLOT_FREE;
+    FreeSlotCount++;
+  }
+  if(Header->EntityCount != Header->EntitySlotCount - FreeSlotCount)
+  {
+    return false;
+  }
+
+  u32 ChunkCount = 0;
+  snapshot_archetype const* Archetypes = (snapshot_archetype const*) (Base + Header->ArchetypesOffset);
+  bptr ChunkBlob = Base + Header->ChunksOffset;
+  for(u32 ArchetypeIndex = 0; ArchetypeIndex < Header->ArchetypeCount; ++ArchetypeIndex)
+  {
+    snapshot_archetype const* SnapshotArchetype = Archetypes + ArchetypeIndex;
+    if(IsEmpty(SnapshotArchetype->ComponentFlags))
+    {
+      return false;
+    }
+    component_signature ComponentFlags = SnapshotArchetype->ComponentFlags;
+    u32 ComponentIndex = 0;
+    while(IndexOfLeastSignificantSetBit(ComponentFlags, &ComponentIndex))
+    {
+      if(ComponentIndex >= EM->ComponentTypeCount)
+      {
+        return false;
+      }
+      ComponentFlags = AndNot(ComponentFlags, ComponentFlagFromIndex(ComponentIndex));
+    }
+    if(SnapshotArchetype->ChunkCapacity != GetArchetypeChunkCapacity(EM, SnapshotArchetype->ComponentFlags) ||
+       SnapshotArchetype->ChunkCount > Header->ChunkCount - ChunkCount)
+    {
+      return false;
+    }
+    ChunkCount += SnapshotArchetype->ChunkCount;
+
+    // The chunk layout of the archetype, without creating it, see CreateArchetype
+    component_signature SharedFlags = SnapshotArchetype->ComponentFlags & EM->SharedFlags;
+    u32 ComponentCount = GetSetBitCount(AndNot(SnapshotArchetype->ComponentFlags, EM->TagFlags | EM->SharedFlags));
+    u32 SharedCount = GetSetBitCount(SharedFlags);
+    midx EntitiesByteOffset = GetArchetypeChunkHeaderSize(ComponentCount, SharedCount);
+    for(u32 ChunkIndex = 0; ChunkIndex < SnapshotArchetype->ChunkCount; ++ChunkIndex)
+    {
+      u32 EntityCount = ((archetype_chunk const*) ChunkBlob)->EntityCount;
+      if(EntityCount == 0 || EntityCount > SnapshotArchetype->ChunkCapacity)
+      {
+        return false;
+      }
+
+      u32 const* SharedValueIndices = (u32 const*) (ChunkBlob + sizeof(archetype_chunk)) + ComponentCount;
+      component_signature SharedToCheck = SharedFlags;
+      u32 SharedIndex = 0;
+      while(IndexOfLeastSignificantSetBit(SharedToCheck, &ComponentIndex))
+      {
+        if(SharedValueIndices[SharedIndex++] >= ComponentTypes[ComponentIndex].SharedValueCount)
+        {
+          return false;
+        }
+        SharedToCheck = AndNot(SharedToCheck, ComponentFlagFromIndex(ComponentIndex));
+      }
+
+      entity_id const* EntityIDs = (entity_id const*) (ChunkBlob + EntitiesByteOffset);
+      for(u32 Row = 0; Row < EntityCount; ++Row)
+      {
+        u32 SlotIndex = EntityIDs[Row].SlotIndex;
+        if(SlotIndex >= Header->EntitySlotCount ||
+           Slots[SlotIndex].Generation != EntityIDs[Row].Generation ||
+           SlotStates[SlotIndex] != ECS_SNAPSHOT_SLOT_LIVE)
+        {
+          return false;
+        }
+        SlotStates[SlotIndex] = ECS_SNAPSHOT_SLOT_IN_ROW;
+      }
+      ChunkBlob += ECS_ARCHETYPE_CHUNK_BYTE_SIZE;
+    }
+  }
+  return ChunkCount == Header->ChunkCount;
+}
+
+// Checks everything RestoreSnapshot relies on so that a snapshot is either restored as a whole or not at all
+internal b32 IsSnapshotCompatible(entity_manager* EM, snapshot_header const* Header, midx SnapshotByteSize)
+{
+  if(SnapshotByteSize < sizeof(snapshot_header) ||
+     Header->Magic != ECS_SNAPSHOT_MAGIC ||
+     Header->Version != ECS_SNAPSHOT_VERSION ||
+     Header->ChunkByteSize != ECS_ARCHETYPE_CHUNK_BYTE_SIZE ||
+     Header->PointerByteSize != sizeof(entity*) ||
+     Header->ComponentTypeCount != EM->ComponentTypeCount ||
+     Header->ByteSize > SnapshotByteSize)
+  {
+    return false;
+  }
+
+  if(!IsInSnapshot(Header, Header->ComponentTypesOffset, (u64) Header->ComponentTypeCount * sizeof(snapshot_component_type)) ||
+     !IsInSnapshot(Header, Header->ArchetypesOffset, (u64) Header->ArchetypeCount * sizeof(snapshot_archetype)) ||
+     !IsInSnapshot(Header, Header->SlotsOffset, (u64) Header->EntitySlotCount * sizeof(snapshot_slot)) ||
+     !IsInSnapshot(Header, Header->ChunksOffset, (u64) Header->ChunkCount * ECS_ARCHETYPE_CHUNK_BYTE_SIZE) ||
+     Header->ComponentTypesOffset % alignof(snapshot_component_type) ||
+     Header->SlotsOffset % alignof(snapshot_slot) ||
+     Header->ChunksOffset % ECS_ARCHETYPE_CHUNK_BYTE_SIZE ||
+     Header->EntityCount > Header->EntitySlotCount)
+  {
+    return false;
+  }
+
+  bptr Base = (bptr) Header;
+  snapshot_component_type const* ComponentTypes = (snapshot_component_type const*) (Base + Header->ComponentTypesOffset);
+  u64 SharedValuesByteSize = 0;
+  for(u32 ComponentIndex = 0; ComponentIndex < EM->ComponentTypeCount; ++ComponentIndex)
+  {
+    component_list* ComponentList = EM->ComponentTypeVector + ComponentIndex;
+    snapshot_component_type const* ComponentType = ComponentTypes + ComponentIndex;
+    if(ComponentType->Type != ComponentList->Type ||
+       ComponentType->ComponentByteSize != ComponentList->ComponentByteSize ||
+       ComponentType->ComponentChunkCount != ComponentList->ComponentChunkCount ||
+       ComponentType->FieldCount != ComponentList->FieldCount ||
+       ComponentType->InstanceCapacity != ComponentList->InstanceCapacity ||
+       ComponentType->SharedValueCapacity != ComponentList->SharedValueCapacity ||
+       ComponentType->SharedValueCount > ComponentList->SharedValueCapacity)
+    {
+      return false;
+    }
+    SharedValuesByteSize += ComponentType->SharedValueCount * (u64) ComponentType->ComponentByteSize;
+  }
+  if(!IsInSnapshot(Header, Header->SharedValuesOffset, SharedValuesByteSize) ||
+     GetAlignedOffset(Header->SharedValuesOffset + SharedValuesByteSize, ECS_COMPONENT_ALIGNMENT) != Header->ArchetypesOffset)
+  {
+    return false;
+  }
+
+  temporary_memory TempMem = BeginTemporaryMemory(GlobalTransientArena);
+  u8* SlotStates = PushArray(GlobalTransientArena, Header->EntitySlotCount, u8);
+  memset(SlotStates, ECS_SNAPSHOT_SLOT_LIVE, Header->EntitySlotCount);
+  b32 Result = AreSnapshotEntitiesValid(EM, Header, SlotStates);
+  EndTemporaryMemory(TempMem);
+  return Result;
+}
+
+b32 RestoreSnapshot(entity_manager* EM, void const* Snapshot, midx SnapshotByteSize)
+{
+  snapshot_header const* Header = (snapshot_header const*) Snapshot;
+  if(!IsSnapshotCompatible(EM, Header, SnapshotByteSize))
+  {
+    return false;
+  }
+
+  ClearEntityManager(EM);
+
+  // Shared values are replaced, the chunks hold indices into them
+  bptr Base = (bptr) Snapshot;
+  snapshot_component_type const* ComponentTypes = (snapshot_component_type const*) (Base + Header->ComponentTypesOffset);
+  bptr SharedValues = Base + Header->SharedValuesOffset;
+  for(u32 ComponentIndex = 0; ComponentIndex < EM->ComponentTypeCount; ++ComponentIndex)
+  {
+    component_list* ComponentList = EM->ComponentTypeVector + ComponentIndex;
+    midx SharedValuesByteSize = ComponentTypes[ComponentIndex].SharedValueCount * (midx) ComponentList->ComponentByteSize;
+    if(ComponentList->SharedValueCapacity)
+    {
+      ComponentList->SharedValueCount = ComponentTypes[ComponentIndex].SharedValueCount;
+      utils::Copy(SharedValuesByteSize, SharedValues, ComponentList->SharedValues);
+    }
+    SharedValues += SharedValuesByteSize;
+  }
+
+  // Slots first, the chunk pass below sets Chunk and Row of the live ones
+  snapshot_slot const* Slots = (snapshot_slot const*) (Base + Header->SlotsOffset);
+  u32 SlotsPerPage = 1 << EM->EntitySlotPageSizeLog2;
+  while(EM->EntitySlotPageCount * SlotsPerPage < Header->EntitySlotCount)
+  {
+    AddEntitySlotPage(EM);
+  }
+  EM->EntitySlotCount = Header->EntitySlotCount;
+  EM->EntityCount = Header->EntityCount;
+  EM->FirstFreeEntitySlot = Header->FirstFreeEntitySlot;
+  for(u32 PageStart = 0; PageStart < Header->EntitySlotCount; PageStart += SlotsPerPage)
+  {
+    entity* Page = EM->EntitySlotPages[PageStart >> EM->EntitySlotPageSizeLog2];
+    u32 PageSlotCount = Minimum(SlotsPerPage, Header->EntitySlotCount - PageStart);
+    for(u32 PageSlot = 0; PageSlot < PageSlotCount; ++PageSlot)
+    {
+      entity* Entity = Page + PageSlot;
+      snapshot_slot const* Slot = Slots + PageStart + PageSlot;
+      Entity->ID.SlotIndex = PageStart + PageSlot;
+      Entity->ID.Generation = Slot->Generation;
+      Entity->Chunk = 0;
+      Entity->Row = 0;
+      Entity->NextFreeSlot = Slot->NextFreeSlot;
+    }
+  }
+
+  snapshot_archetype const* Archetypes = (snapshot_archetype const*) (Base + Header->ArchetypesOffset);
+  bptr ChunkBlob = Base + Header->ChunksOffset;
+  for(u32 ArchetypeIndex = 0; ArchetypeIndex < Header->ArchetypeCount; ++ArchetypeIndex)
+  {
+    snapshot_archetype const* SnapshotArchetype = Archetypes + ArchetypeIndex;
+    archetype* Archetype = GetOrCreateArchetype(EM, SnapshotArchetype->ComponentFlags);
+    for(u32 ChunkIndex = 0; ChunkIndex < SnapshotArchetype->ChunkCount; ++ChunkIndex)
+    {
+      archetype_chunk* Chunk = AllocateChunk(EM, Archetype, 0);
+      // The header of the new chunk holds its links, only the data after it comes from the blob
+      utils::Copy(ECS_ARCHETYPE_CHUNK_BYTE_SIZE - sizeof(archetype_chunk), ChunkBlob + sizeof(archetype_chunk), ((bptr) Chunk) + sizeof(archetype_chunk));
+      Chunk->EntityCount = ((archetype_chunk*) ChunkBlob)->EntityCount;
+
+      entity_id* EntityIDs = GetChunkEntityIDs(Chunk);
+      for(u32 Row = 0; Row < Chunk->EntityCount; ++Row)
+      {
+        entity* Entity = GetEntitySlot(EM, EntityIDs[Row].SlotIndex);
+        Entity->Chunk = Chunk;
+        Entity->Row = Row;
+      }
+      Archetype->EntityCount += Chunk->EntityCount;
+      if(Chunk->EntityCount == Archetype->ChunkCapacity)
+      {
+        UnlinkChunkWithSpace(Archetype, Chunk);
+      }
+      MarkChunkChanged(EM, Chunk);
+      ChunkBlob += ECS_ARCHETYPE_CHUNK_BYTE_SIZE;
+    }
+  }
+  return true;
+}
+
+}
@@ -0,0 +1,29 @@
+#pragma once
+#include "entity_components_backend.h"
+
+namespace ecs{
+
+// Snapshot of all entities and components of an entity_manager as one block of memory without pointers.
+// Chunks are written as whole ECS_ARCHETYPE_CHUNK_BYTE_SIZE blobs with their header links cleared, the rows
+// already hold entity ids. Restoring checks the whole snapshot, then copies each blob into a newly allocated
+// chunk of its archetype, so the snapshot memory is not used after RestoreSnapshot returns. Nothing needs
+// to be parsed, the chunk blobs start at a multiple of ECS_ARCHETYPE_CHUNK_BYTE_SIZE from the beginning of
+// the snapshot and are copied as they are.
+//
+// Component data is copied as is. Pointers stored in components (like position::component::FirstChild)
+// are only valid after a restore if the memory they point to is at the same address, which holds
+// within one run of the application but not for a snapshot saved to disk.
+//
+// The entity_manager restored into must have been created with the same definitions as the one written.
+// Entity ids are kept. Every restored component counts as changed, see change_filter.
+
+// Number of bytes WriteSnapshot needs for the current state of EM
+midx GetSnapshotByteSize(entity_manager* EM);
+// Returns the number of bytes written, 0 if MemoryByteSize is too small
+midx WriteSnapshot(entity_manager* EM, void* Memory, midx MemoryByteSize);
+// Replaces all entities of EM with the ones in Snapshot. Returns false, leaving EM untouched,
+// if the snapshot is invalid or was written by an entity_manager with different component types.
+// Must not be called while iterating.
+b32 RestoreSnapshot(entity_manager* EM, void const* Snapshot, midx SnapshotByteSize);
+
+}
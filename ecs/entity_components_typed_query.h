@@ -0,0 +1,122 @@
+#pragma once
+#include "entity_components_backend.h"
+#include "entity_components_parallel.h"
+#include <type_traits>
+
+// Typed layer over queries. The component structs of a query are template arguments, their flags are
+// fixed at compile time and the component arrays of a chunk are looked up once per chunk. The callbacks
+// get references into the arrays, the loop over a chunk is the same loop as one written by hand
+// against GetComponentArray.
+//
+// Every component struct used here is declared once with ECS_TYPED_COMPONENT. A const struct in the
+// argument list is read with GetReadOnlyComponentArray and doesn't count as a change, see change_filter.
+//   ECS_TYPED_COMPONENT(ecs::position::component, ecs::flag::POSITION);
+//   typed_query<position::component, const render::component> Query = RegisterTypedQuery<position::component, const render::component>(EM);
+//   ForEach(EM, Query, [](position::component& Position, const render::component& Render) { ... });
+namespace ecs{
+
+// Flag of a component struct, specialized with ECS_TYPED_COMPONENT
+template<typename component> struct component_type;
+
+// Use at global scope after the struct. A struct stands for one component type, tags and shared
+// components have no arrays and are put in a typed query through OtherComponentFlags instead.
+#define ECS_TYPED_COMPONENT(Type, ComponentFlag) \
+  template<> struct ecs::component_type<Type> { static ecs::component_signature Flag() { return ComponentFlag; } }
+
+template<typename component>
+inline component_signature GetTypedFlag()
+{
+  component_signature Result = component_type<std::remove_const_t<component>>::Flag();
+  return Result;
+}
+
+template<typename... components>
+struct typed_query
+{
+  query* Query;
+};
+
+// OtherComponentFlags are part of the query without being handed to the callbacks, for example tags
+template<typename... components>
+typed_query<components...> RegisterTypedQuery(entity_manager* EM, component_signature OtherComponentFlags = 0)
+{
+  static_assert(sizeof...(components) > 0, "A typed query needs at least one component struct");
+  component_signature ComponentFlags = (OtherComponentFlags | ... | GetTypedFlag<components>());
+  typed_query<components...> Result = {RegisterQuery(EM, ComponentFlags)};
+  return Result;
+}
+
+// Component array of the chunk the iterator is on
+template<typename component>
+inline component* GetTypedArray(filtered_entity_iterator* Iterator)
+{
+  bptr Result = std::is_const_v<component> ? GetReadOnlyComponentArray(Iterator, GetTypedFlag<component>()) :
+                                             GetComponentArray(Iterator, GetTypedFlag<component>());
+  return (component*) Result;
+}
+
+// Typed GetComponent by id
+template<typename component>
+inline component* GetComponent(entity_manager* EM, entity_id* EntityID)
+{
+  bptr Result = std::is_const_v<component> ? GetReadOnlyComponent(EM, EntityID, GetTypedFlag<component>()) :
+                                             GetComponent(EM, EntityID, GetTypedFlag<component>());
+  return (component*) Result;
+}
+
+// Typed GetPrefabComponent
+template<typename component>
+inline component* GetPrefabComponent(prefab* Prefab)
+{
+  component* Result = (component*) GetPrefabComponent(Prefab, GetTypedFlag<component>());
+  return Result;
+}
+
+template<typename function, typename... components>
+inline void ForEachRow(u32 EntityCount, function& Function, components*... Arrays)
+{
+  for(u32 Row = 0; Row < EntityCount; ++Row)
+  {
+    Function(Arrays[Row]...);
+  }
+}
+
+// Calls Function(components&...) for every entity in Query
+template<typename... components, typename function>
+void ForEach(entity_manager* EM, typed_query<components...> Query, function Function)
+{
+  filtered_entity_iterator Iterator = GetComponentsOfType(EM, Query.Query);
+  while(NextChunk(&Iterator))
+  {
+    ForEachRow(GetChunkEntityCount(&Iterator), Function, GetTypedArray<components>(&Iterator)...);
+  }
+}
+
+// Same as ForEach but also hands over the id of each entity, Function(entity_id, components&...)
+template<typename... components, typename function>
+void ForEachWithID(entity_manager* EM, typed_query<components...> Query, function Function)
+{
+  filtered_entity_iterator Iterator = GetComponentsOfType(EM, Query.Query);
+  while(NextChunk(&Iterator))
+  {
+    ForEachRow(GetChunkEntityCount(&Iterator), Function, GetChunkEntityIDs(&Iterator), GetTypedArray<components>(&Iterator)...);
+  }
+}
+
+template<typename function, typename... components>
+internal ECS_PARALLEL_CHUNK_CALLBACK(TypedParallelForEachCallback)
+{
+  function* Function = (function*) UserData;
+  ForEachRow(GetChunkEntityCount(&Chunk->Iterator), *Function, GetTypedArray<components>(&Chunk->Iterator)...);
+}
+
+// ForEach spread over the threads of Pool, see ParallelForEachChunk. Function is called from several
+// threads at once. Returns the number of entities visited.
+template<typename... components, typename function>
+u32 ParallelForEach(worker_pool* Pool, entity_manager* EM, typed_query<components...> Query, function Function)
+{
+  u32 Result = ParallelForEachChunk(Pool, EM, Query.Query, TypedParallelForEachCallback<function, components...>, &Function);
+  return Result;
+}
+
+}
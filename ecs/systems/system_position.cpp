@@ -1,4 +1,5 @@
 #include "ecs/systems/system_position.h"
+#include "ecs/entity_components_parallel.h"
 #include "platform/jwin_platform.h"
 
 namespace ecs::position{
@@ -72,18 +73,50 @@ void UpdateAbsolutePosition(memory_arena* Arena, position_node* PositionNode)
   UpdateAbsolutePosition(Arena, PositionComponent);
 }
 
-void UpdatePositions(entity_manager* EntityManager)
+system* CreatePositionSystem(entity_manager* EntityManager)
 {
-  filtered_entity_iterator EntityIterator = GetComponentsOfType(EntityManager, flag::POSITION);
+  system* Result = BootstrapPushStruct(system, Arena);
+  Result->PositionQuery = RegisterQuery(EntityManager, flag::POSITION);
+  return Result;
+}
 
-  while(Next(&EntityIterator))
+// The node tree of a position component only holds nodes of that component so chunks can be updated in parallel.
+// Clearing Dirty is bookkeeping of this system, the array is accessed read-only so it doesn't count as a change.
+// Everything it needs is in the chunk, so the UserData of the parallel_chunk_callback is left unnamed.
+internal void UpdatePositionChunk(parallel_chunk* Chunk, void*)
+{
+  component* Positions = (component*) GetReadOnlyComponentArray(&Chunk->Iterator, flag::POSITION);
+  u32 EntityCount = GetChunkEntityCount(&Chunk->Iterator);
+  for(u32 Index = 0; Index < EntityCount; ++Index)
   {
-    component* Position = GetPositionComponent(&EntityIterator);
+    component* Position = Positions + Index;
     if(Position->Dirty)
     {
-      UpdateAbsolutePosition(GlobalTransientArena, Position);  
+      UpdateAbsolutePosition(Chunk->ScratchArena, Position);
     }
   }
 }
 
-}
\ No newline at end of file
+// ChangeVersion is the current version of EntityManager, see AdvanceChangeVersion
+internal void UpdatePositions(entity_manager* EntityManager, system* PositionSystem, worker_pool* WorkerPool, u32 ChangeVersion)
+{
+  // Positions are marked dirty through GetComponent which also marks their chunk as changed,
+  // chunks nothing has written to since the last update can't hold a dirty position.
+  u32 SinceVersion = PositionSystem->LastChangeVersion;
+  PositionSystem->LastChangeVersion = ChangeVersion;
+  change_filter Filter = {flag::POSITION, SinceVersion};
+  ParallelForEachChunk(WorkerPool, EntityManager, PositionSystem->PositionQuery, Filter, UpdatePositionChunk, 0);
+}
+
+void UpdatePositions(entity_manager* EntityManager, system* PositionSystem, worker_pool* WorkerPool)
+{
+  UpdatePositions(EntityManager, PositionSystem, WorkerPool, AdvanceChangeVersion(EntityManager));
+}
+
+ECS_SYSTEM_CALLBACK(RunPositionSystem)
+{
+  system* PositionSystem = (system*) UserData;
+  UpdatePositions(Context->EM, PositionSystem, Context->Pool, Context->ChangeVersion);
+}
+
+}
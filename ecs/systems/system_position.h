@@ -1,7 +1,17 @@
 #pragma once
+#include "ecs/entity_components_scheduler.h"
 
 namespace ecs::position{
 
-void UpdatePositions(entity_manager* EntityManager);
+struct system {
+  memory_arena Arena;
+  query* PositionQuery;
+  u32 LastChangeVersion; // Change version at the start of the last update
+};
+
+system* CreatePositionSystem(entity_manager* EntityManager);
+void UpdatePositions(entity_manager* EntityManager, system* PositionSystem, worker_pool* WorkerPool);
+// UpdatePositions as a scheduler system writing flag::POSITION, UserData is the system. See AddSystem.
+ECS_SYSTEM_CALLBACK(RunPositionSystem);
 
 }
@@ -1,4 +1,6 @@
 #include "ecs/systems/system_render.h"
+#include "ecs/entity_components_parallel.h"
+#include <algorithm>
 //#include "math/vector_math.h"
 namespace ecs::render {
 
@@ -112,12 +114,59 @@ u32 GetGaussianKernel(u32 BinomialDepth, u32 CutOff, r32* OutOffset, r32* OutWei
 }
 
 
-void PushRenderObject(render_group* RenderGroup, component* Render, u32 Program, u32 FrameBuffer, m4& ProjectionMatrix, m4& ViewMatrix,
-  v3 LightDirection, v3 LightColor)
+// Everything PushRenderObject needs that can be calculated without touching the render_group
+struct render_entry
 {
-  entity_id EntityId = GetEntityIDFromComponent( (bptr) Render );
-  ecs::position::component* Position =  GetPositionComponent(&EntityId);
+  component const* Render;
+  data::material* Material;
+  u32 MaterialIndex; // Index of the shared flag::MATERIAL value, equal indices mean equal materials
+  m4 ModelView;
+  m4 NormalView;
+  b32 Transparent;
+};
 
+struct render_entry_job
+{
+  m4 ViewMatrix;
+  render_entry* Entries;
+};
+
+internal ECS_PARALLEL_CHUNK_CALLBACK(BuildRenderEntries)
+{
+  render_entry_job* Job = (render_entry_job*) UserData;
+  component const* Renders = GetTypedArray<const component>(&Chunk->Iterator);
+  position::component const* Positions = GetTypedArray<const position::component>(&Chunk->Iterator);
+  // Every entity of a chunk has the same material
+  data::material* Material = (data::material*) GetSharedComponent(&Chunk->Iterator, flag::MATERIAL);
+  u32 MaterialIndex = GetSharedComponentIndex(&Chunk->Iterator, flag::MATERIAL);
+  b32 Transparent = Material->Ambient.W < 1;
+  u32 EntityCount = GetChunkEntityCount(&Chunk->Iterator);
+  for(u32 Index = 0; Index < EntityCount; ++Index)
+  {
+    component const* Render = Renders + Index;
+    position::component const* Position = Positions + Index;
+
+    m4 Scale = GetScaleMatrix(V4(Render->Scale,1));
+    m4 Rotation = GetRotationMatrix(GetAbsoluteRotation(Position), -V4(0,1,0,0));
+    m4 Translation = GetTranslationMatrix(V4(GetAbsolutePosition(Position),1));
+    m4 ModelMat =  Translation*Rotation*Scale;
+    //Rotate( GetAbsoluteRotation(Position), -V4(0,1,0,0), ModelMat );
+
+    render_entry* Entry = Job->Entries + Chunk->FirstEntityIndex + Index;
+    Entry->Render = Render;
+    Entry->Material = Material;
+    Entry->MaterialIndex = MaterialIndex;
+    Entry->ModelView = Job->ViewMatrix*ModelMat;
+    Entry->NormalView = Transpose(RigidInverse(Entry->ModelView));
+    Entry->Transparent = Transparent;
+  }
+}
+
+void PushRenderObject(render_group* RenderGroup, render_entry* Entry, u32 Program, u32 FrameBuffer, m4& ProjectionMatrix,
+  v3 LightDirection, v3 LightColor)
+{
+  component const* Render = Entry->Render;
+  data::material* Material = Entry->Material;
   render_object* Object = PushNewRenderObject(RenderGroup);
   Object->ProgramHandle = Program;
   Object->FrameBufferHandle = FrameBuffer;
@@ -125,27 +174,19 @@ void PushRenderObject(render_group* RenderGroup, component* Render, u32 Program,
   Object->TextureCount = 1;
   Object->TextureHandles[0] = Render->TextureHandle;
 
-  m4 Scale = GetScaleMatrix(V4(Render->Scale,1));
-  m4 Rotation = GetRotationMatrix(GetAbsoluteRotation(Position), -V4(0,1,0,0));
-  m4 Translation = GetTranslationMatrix(V4(GetAbsolutePosition(Position),1));
-  m4 ModelMat =  Translation*Rotation*Scale;
-  //Rotate( GetAbsoluteRotation(Position), -V4(0,1,0,0), ModelMat );
-
-  m4 ModelView = ViewMatrix*ModelMat;
-  m4 NormalView = Transpose(RigidInverse(ModelView));
   PushUniform(Object, GetUniformHandle(RenderGroup, GlobalState->PhongProgram, "ProjectionMat"), ProjectionMatrix);
-  PushUniform(Object, GetUniformHandle(RenderGroup, GlobalState->PhongProgram, "ModelView"), ModelView);
-  PushUniform(Object, GetUniformHandle(RenderGroup, GlobalState->PhongProgram, "NormalView"), NormalView);
+  PushUniform(Object, GetUniformHandle(RenderGroup, GlobalState->PhongProgram, "ModelView"), Entry->ModelView);
+  PushUniform(Object, GetUniformHandle(RenderGroup, GlobalState->PhongProgram, "NormalView"), Entry->NormalView);
   PushUniform(Object, GetUniformHandle(RenderGroup, GlobalState->PhongProgram, "LightDirection"), LightDirection);
   PushUniform(Object, GetUniformHandle(RenderGroup, GlobalState->PhongProgram, "LightColor"), LightColor);
-  PushUniform(Object, GetUniformHandle(RenderGroup, GlobalState->PhongProgram, "MaterialAmbient"), Render->Material.Ambient);
-  PushUniform(Object, GetUniformHandle(RenderGroup, GlobalState->PhongProgram, "MaterialDiffuse"), Render->Material.Diffuse);
-  PushUniform(Object, GetUniformHandle(RenderGroup, GlobalState->PhongProgram, "MaterialSpecular"), Render->Material.Specular);
-  PushUniform(Object, GetUniformHandle(RenderGroup, GlobalState->PhongProgram, "Shininess"), Render->Material.Shininess);
+  PushUniform(Object, GetUniformHandle(RenderGroup, GlobalState->PhongProgram, "MaterialAmbient"), Material->Ambient);
+  PushUniform(Object, GetUniformHandle(RenderGroup, GlobalState->PhongProgram, "MaterialDiffuse"), Material->Diffuse);
+  PushUniform(Object, GetUniformHandle(RenderGroup, GlobalState->PhongProgram, "MaterialSpecular"), Material->Specular);
+  PushUniform(Object, GetUniformHandle(RenderGroup, GlobalState->PhongProgram, "Shininess"), Material->Shininess);
 
 }
 void DrawOverlayText(system* RenderSystem, utf8_byte* Text, u32 X0, u32 Y0, r32 RelativeScale);
-void Draw(entity_manager* EntityManager, system* RenderSystem, m4 ProjectionMatrix, m4 ViewMatrix)
+void Draw(entity_manager* EntityManager, system* RenderSystem, worker_pool* WorkerPool, m4 ProjectionMatrix, m4 ViewMatrix)
 {
   render_group* RenderGroup = RenderSystem->RenderGroup;
 
@@ -153,21 +194,17 @@ void Draw(entity_manager* EntityManager, system* RenderSystem, m4 ProjectionMatr
   v3 LightPosition = V3(1,1,1);
   v3 LightDirection = V3(Transpose(RigidInverse(ViewMatrix)) * V4(LightPosition,0));
 
-  filtered_entity_iterator EntityIterator = GetComponentsOfType(EntityManager, flag::RENDER);
-
-  chunk_list SolidObjects = NewChunkList(GlobalTransientArena, sizeof(component**), 32);
-  chunk_list TransparentObjects = NewChunkList(GlobalTransientArena, sizeof(component**), 32);
-
-  while(Next(&EntityIterator))
+  // The matrices of all entities are calculated in parallel, the render objects are then pushed in entity order
+  render_entry_job EntryJob = {};
+  EntryJob.ViewMatrix = ViewMatrix;
+  typed_query<const component, const position::component> RenderQuery = RegisterTypedQuery<const component, const position::component>(EntityManager);
+  EntryJob.Entries = PushArray(GlobalTransientArena, GetEntityCount(RenderQuery.Query), render_entry);
+  u32 EntryCount = ParallelForEachChunk(WorkerPool, EntityManager, RenderQuery.Query, BuildRenderEntries, &EntryJob);
+  // Objects with the same material are pushed one after the other
+  std::sort(EntryJob.Entries, EntryJob.Entries + EntryCount, [](const render_entry& A, const render_entry& B) -> bool
   {
-    component* Component = GetRenderComponent(&EntityIterator);
-    if(Component->Material.Ambient.W < 1)
-    {
-      Push(GlobalTransientArena, &TransparentObjects, (bptr) &Component);
-    }else{
-      Push(GlobalTransientArena, &SolidObjects, (bptr) &Component);
-    }
-  }
+    return A.MaterialIndex < B.MaterialIndex;
+  });
 
   // Some Gaussian Blur just cause I can
   r32* KernelOffset = PushArray(GlobalTransientArena, 64, r32);
@@ -216,10 +253,13 @@ void Draw(entity_manager* EntityManager, system* RenderSystem, m4 ProjectionMatr
   TransparenClearOp1->Color = V4(1,0,0,0);
 
   // First draw solid objects
-  chunk_list_iterator SolidIt = BeginIterator(&SolidObjects);
-  while(Valid(&SolidIt)) {
-    component** RenderPtr = (component**) Next(&SolidIt);
-    PushRenderObject(RenderGroup, *RenderPtr, GlobalState->PhongProgram, GlobalState->MsaaFrameBuffer, ProjectionMatrix, ViewMatrix, LightDirection, LightColor);
+  for(u32 EntryIndex = 0; EntryIndex < EntryCount; ++EntryIndex)
+  {
+    render_entry* Entry = EntryJob.Entries + EntryIndex;
+    if(!Entry->Transparent)
+    {
+      PushRenderObject(RenderGroup, Entry, GlobalState->PhongProgram, GlobalState->MsaaFrameBuffer, ProjectionMatrix, LightDirection, LightColor);
+    }
   }
 
 
@@ -243,10 +283,13 @@ void Draw(entity_manager* EntityManager, system* RenderSystem, m4 ProjectionMatr
 
   // Then draw Transparent objects
     // First draw solid objects
-  chunk_list_iterator TransparentIt = BeginIterator(&TransparentObjects);
-  while(Valid(&TransparentIt)) {
-    component** RenderPtr = (component**) Next(&TransparentIt);
-    PushRenderObject(RenderGroup, *RenderPtr, GlobalState->PhongProgramTransparent, GlobalState->TransparentFrameBuffer, ProjectionMatrix, ViewMatrix, LightDirection, LightColor);
+  for(u32 EntryIndex = 0; EntryIndex < EntryCount; ++EntryIndex)
+  {
+    render_entry* Entry = EntryJob.Entries + EntryIndex;
+    if(Entry->Transparent)
+    {
+      PushRenderObject(RenderGroup, Entry, GlobalState->PhongProgramTransparent, GlobalState->TransparentFrameBuffer, ProjectionMatrix, LightDirection, LightColor);
+    }
   }
 
   render_state* CompositState = PushNewState(RenderGroup);
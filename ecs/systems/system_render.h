@@ -39,8 +39,9 @@ namespace render {
     u32 FontTextureHandle;
   };
 
+  // One render system draws any of the worlds, the entities to draw come from the entity_manager passed to Draw
   system* CreateRenderSystem(render_group* RenderGroup);
-  void Draw(entity_manager* EntityManager, system* RenderSystem, m4 ProjectionMatrix, m4 ViewMatrix);
+  void Draw(entity_manager* EntityManager, system* RenderSystem, worker_pool* WorkerPool, m4 ProjectionMatrix, m4 ViewMatrix);
   void DrawOverlayText(system* RenderSystem, utf8_byte* Text, u32 X0, u32 Y0, r32 RelativeScale);
 }
 }
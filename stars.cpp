@@ -13,6 +13,10 @@
 #include "skybox_drawing.h"
 #include "containers/chunk_list.cpp"
 #include "ecs/entity_components_backend.cpp"
+#include "ecs/entity_components_parallel.cpp"
+#include "ecs/entity_components_scheduler.cpp"
+#include "ecs/entity_components_commands.cpp"
+#include "ecs/entity_components_snapshot.cpp"
 #include "ecs/entity_components.cpp"
 #include "ecs/components/component_position.cpp"
 #include "ecs/systems/system_position.cpp"
@@ -1151,15 +1155,116 @@ u32 PushPlitPlaneMesh(render_group* RenderGroup)
   return Result;
 }
 
-world InitiateWorld(render_group* RenderGroup)
+// The systems hold function pointers and names in the dll, they are added again after every reload
+void AddWorldSystems(world* World)
 {
-  world Result = {};
-  Result.EntityManager = ecs::CreateEntityManager();
-  Result.PositionNodes = NewChunkList(GlobalPersistentArena, sizeof(ecs::position::position_node), 128);
-  Result.RenderSystem = ecs::render::CreateRenderSystem(RenderGroup);
+  ecs::RemoveAllSystems(World->Scheduler);
+  ecs::AddSystem(World->Scheduler, "Positions", 0, ecs::flag::POSITION, ecs::position::RunPositionSystem, World->PositionSystem);
+}
+
+// Worlds are never freed, a destroyed world keeps its entity_manager and hands it to the next world created
+world* CreateWorld()
+{
+  world* Result = 0;
+  for(u32 WorldIndex = 0; WorldIndex < GlobalState->WorldCount; ++WorldIndex)
+  {
+    if(!GlobalState->Worlds[WorldIndex].InUse)
+    {
+      Result = GlobalState->Worlds + WorldIndex;
+      break;
+    }
+  }
+  if(!Result)
+  {
+    Assert(GlobalState->WorldCount < MAX_WORLD_COUNT);
+    Result = GlobalState->Worlds + GlobalState->WorldCount++;
+    Result->EntityManager = ecs::CreateEntityManager();
+    Result->PositionSystem = ecs::position::CreatePositionSystem(Result->EntityManager);
+    Result->Scheduler = ecs::CreateScheduler();
+    AddWorldSystems(Result);
+  }
+  Result->InUse = true;
+  Result->Active = true;
   return Result;
 }
 
+void DestroyWorld(world* World)
+{
+  Assert(World->InUse);
+  ecs::filtered_entity_iterator Iterator = ecs::GetComponentsOfType(World->EntityManager, ecs::flag::POSITION);
+  while(ecs::NextChunk(&Iterator))
+  {
+    ecs::position::component* Positions = (ecs::position::component*) ecs::GetReadOnlyComponentArray(&Iterator, ecs::flag::POSITION);
+    for(u32 Index = 0; Index < ecs::GetChunkEntityCount(&Iterator); ++Index)
+    {
+      ecs::position::ClearPositionComponent(Positions + Index);
+    }
+  }
+  ecs::ClearEntityManager(World->EntityManager);
+  World->InUse = false;
+  World->Active = false;
+}
+
+// Moves entities with all their components to another world, their new ids are written to OutIDs, which may be 0.
+// Position hierarchies should be moved as a whole, nodes are not unlinked from parents left behind.
+// Returns false and moves nothing if To has no room for their shared component values, see ecs::MoveEntities.
+b32 MoveEntitiesToWorld(world* From, world* To, u32 Count, ecs::entity_id* EntityIDs, ecs::entity_id* OutIDs)
+{
+  temporary_memory TempMem = BeginTemporaryMemory(GlobalTransientArena);
+  ecs::entity_id* NewIDs = PushArray(GlobalTransientArena, Count, ecs::entity_id);
+  if(!ecs::MoveEntities(From->EntityManager, To->EntityManager, Count, EntityIDs, NewIDs))
+  {
+    EndTemporaryMemory(TempMem);
+    return false;
+  }
+
+  // The nodes refer to their entity by id
+  bptr* Positions = PushArray(GlobalTransientArena, Count, bptr);
+  ecs::TryGetReadOnlyComponents(To->EntityManager, Count, NewIDs, ecs::flag::POSITION, Positions);
+  for(u32 Index = 0; Index < Count; ++Index)
+  {
+    ecs::position::component* Position = (ecs::position::component*) Positions[Index];
+    if(Position && Position->FirstChild)
+    {
+      ecs::position::SetPositionNodeEntity(Position, NewIDs[Index]);
+    }
+  }
+  if(OutIDs)
+  {
+    utils::Copy(Count * sizeof(ecs::entity_id), NewIDs, OutIDs);
+  }
+  EndTemporaryMemory(TempMem);
+  return true;
+}
+
+// Prefab of a rendered prop in the current world
+ecs::prefab* CreatePropPrefab(u32 MeshHandle, u32 TextureHandle, u32 MaterialIndex, v3 Scale)
+{
+  ecs::entity_manager* EntityManager = GlobalState->World->EntityManager;
+  ecs::prefab* Result = ecs::CreatePrefab(EntityManager, ecs::flag::RENDER);
+  ecs::render::component* Render = ecs::GetPrefabComponent<ecs::render::component>(Result);
+  Render->MeshHandle = MeshHandle;
+  Render->TextureHandle = TextureHandle;
+  Render->Scale = Scale;
+  ecs::render::SetMaterial(EntityManager, Result, MaterialIndex);
+  return Result;
+}
+
+// Count copies of a prefab holding a position in the current world, in a row from Position with Step between them.
+// The copies are instantiated together, only their position nodes are made one by one.
+void SpawnProps(ecs::prefab* Prefab, u32 Count, world_coordinate Position, v3 Step)
+{
+  ecs::entity_manager* EntityManager = GlobalState->World->EntityManager;
+  temporary_memory TempMem = BeginTemporaryMemory(GlobalTransientArena);
+  ecs::entity_id* EntityIDs = PushArray(GlobalTransientArena, Count, ecs::entity_id);
+  ecs::InstantiatePrefab(EntityManager, Prefab, Count, EntityIDs);
+  for(u32 Index = 0; Index < Count; ++Index)
+  {
+    ecs::position::InitiatePositionComponents(EntityManager, 1, EntityIDs + Index, Position + (r32) Index * Step, 0);
+  }
+  EndTemporaryMemory(TempMem);
+}
+
 // void ApplicationUpdateAndRender(application_memory* Memory, application_render_commands* RenderCommands, jwin::device_input* Input)
 extern "C" JWIN_UPDATE_AND_RENDER(ApplicationUpdateAndRender)
 {
@@ -1259,62 +1364,24 @@ extern "C" JWIN_UPDATE_AND_RENDER(ApplicationUpdateAndRender)
     GlobalState->DebugRenderCommands->DefaultFrameBuffer = GlobalState->DefaultFrameBuffer;
 
 
-    GlobalState->World = InitiateWorld(RenderGroup);
+    GlobalState->PositionNodes = NewChunkList(GlobalPersistentArena, sizeof(ecs::position::position_node), 128);
+    GlobalState->RenderSystem = ecs::render::CreateRenderSystem(RenderGroup);
+    GlobalState->World = CreateWorld();
 
-    { // Checker Floor
-      ecs::entity_id Entity = NewEntity(GlobalState->World.EntityManager, ecs::flag::RENDER);
-      ecs::position::component* Position = GetPositionComponent(&Entity);
-      InitiatePositionComponent(Position, V3(0,-1.1,0), 0);
-      ecs::render::component* Render = GetRenderComponent(&Entity);
-      Render->MeshHandle = GlobalState->Plane;
-      Render->TextureHandle = GlobalState->CheckerBoardTexture;
-      Render->Material = ecs::render::GetMaterial(ecs::render::data::MATERIAL_PEARL);
-      Render->Scale = V3(10,1,10);
-    }
+    ecs::prefab* CheckerFloor = CreatePropPrefab(GlobalState->Plane, GlobalState->CheckerBoardTexture, ecs::render::data::MATERIAL_PEARL, V3(10,1,10));
+    SpawnProps(CheckerFloor, 1, V3(0,-1.1,0), V3(0,0,0));
 
-    { // Transparent Cube
-      ecs::entity_id Entity = NewEntity(GlobalState->World.EntityManager, ecs::flag::RENDER);
-      ecs::position::component* Position = GetPositionComponent(&Entity);
-      InitiatePositionComponent(Position, V3(2,0,0), 0);
-      ecs::render::component* Render = GetRenderComponent(&Entity);
-      Render->MeshHandle = GlobalState->Cube;
-      Render->TextureHandle = GlobalState->WhitePixelTexture;
-      Render->Material = ecs::render::GetMaterial(ecs::render::data::MATERIAL_RUBY);
-      Render->Scale = V3(1,1,1);
-    }
-    
-    { // Transparent Cone
-      ecs::entity_id Entity = NewEntity(GlobalState->World.EntityManager, ecs::flag::RENDER);
-      ecs::position::component* Position = GetPositionComponent(&Entity);
-      InitiatePositionComponent(Position, V3(0,0,2), 0);
-      ecs::render::component* Render = GetRenderComponent(&Entity);
-      Render->MeshHandle = GlobalState->Cone;
-      Render->TextureHandle = GlobalState->WhitePixelTexture;
-      Render->Material = ecs::render::GetMaterial(ecs::render::data::MATERIAL_EMERALD);
-      Render->Scale = V3(1,1,1);
-    }
-    
-    { // Transparent Sphere
-      ecs::entity_id Entity = NewEntity(GlobalState->World.EntityManager, ecs::flag::RENDER);
-      ecs::position::component* Position = GetPositionComponent(&Entity);
-      InitiatePositionComponent(Position, V3(2,0,2), 0);
-      ecs::render::component* Render = GetRenderComponent(&Entity);
-      Render->MeshHandle = GlobalState->Sphere;
-      Render->TextureHandle = GlobalState->WhitePixelTexture;
-      Render->Material = ecs::render::GetMaterial(ecs::render::data::MATERIAL_JADE);
-      Render->Scale = V3(1,1,1);
-    }
+    ecs::prefab* TransparentCube = CreatePropPrefab(GlobalState->Cube, GlobalState->WhitePixelTexture, ecs::render::data::MATERIAL_RUBY, V3(1,1,1));
+    SpawnProps(TransparentCube, 4, V3(2,0,0), V3(0,0,-2));
 
-    { // Solid Cone
-      ecs::entity_id Entity = NewEntity(GlobalState->World.EntityManager, ecs::flag::RENDER);
-      ecs::position::component* Position = GetPositionComponent(&Entity);
-      InitiatePositionComponent(Position, V3(0,0,0), 0);
-      ecs::render::component* Render = GetRenderComponent(&Entity);
-      Render->MeshHandle = GlobalState->Cone;
-      Render->TextureHandle = GlobalState->WhitePixelTexture;
-      Render->Material = ecs::render::GetMaterial(ecs::render::data::MATERIAL_SILVER);
-      Render->Scale = V3(1,1,1);
-    }
+    ecs::prefab* TransparentCone = CreatePropPrefab(GlobalState->Cone, GlobalState->WhitePixelTexture, ecs::render::data::MATERIAL_EMERALD, V3(1,1,1));
+    SpawnProps(TransparentCone, 4, V3(0,0,2), V3(-2,0,0));
+
+    ecs::prefab* TransparentSphere = CreatePropPrefab(GlobalState->Sphere, GlobalState->WhitePixelTexture, ecs::render::data::MATERIAL_JADE, V3(1,1,1));
+    SpawnProps(TransparentSphere, 3, V3(2,0,2), V3(2,0,2));
+
+    ecs::prefab* SolidCone = CreatePropPrefab(GlobalState->Cone, GlobalState->WhitePixelTexture, ecs::render::data::MATERIAL_SILVER, V3(1,1,1));
+    SpawnProps(SolidCone, 4, V3(0,0,0), V3(-2,0,-2));
 
     int a  = 10;
 
@@ -1322,6 +1389,12 @@ extern "C" JWIN_UPDATE_AND_RENDER(ApplicationUpdateAndRender)
 
   GlobalDebugRenderCommands = GlobalState->DebugRenderCommands;
 
+  // Created on the first frame and again after the pool was destroyed at the end of a frame, see below
+  if(!GlobalState->WorkerPool)
+  {
+    GlobalState->WorkerPool = ecs::CreateWorkerPool();
+  }
+
 
 
   camera* Camera = &GlobalState->Camera;
@@ -1564,6 +1637,30 @@ extern "C" JWIN_UPDATE_AND_RENDER(ApplicationUpdateAndRender)
   }
 
   render_group* RenderGroup = RenderCommands->RenderGroup;
+  if(Input->ExecutableReloaded)
+  {
+    for(u32 WorldIndex = 0; WorldIndex < GlobalState->WorldCount; ++WorldIndex)
+    {
+      AddWorldSystems(GlobalState->Worlds + WorldIndex);
+    }
+  }
+  // Moves the positioned entities of the drawn world to a new world and destroys the old one
+  if(jwin::Pushed(Input->Keyboard.Key_T))
+  {
+    world* From = GlobalState->World;
+    world* To = CreateWorld();
+    temporary_memory TempMem = BeginTemporaryMemory(GlobalTransientArena);
+    ecs::entity_id_span Span = ecs::GetEntitiesHoldingTypes(From->EntityManager, ecs::flag::POSITION, GlobalTransientArena);
+    if(MoveEntitiesToWorld(From, To, Span.Count, Span.EntityIDs, 0))
+    {
+      DestroyWorld(From);
+      GlobalState->World = To;
+    }else{
+      DestroyWorld(To);
+    }
+    EndTemporaryMemory(TempMem);
+    Platform.DEBUGPrint("Moved %d entities to world %d\n", Span.Count, (u32)(GlobalState->World - GlobalState->Worlds));
+  }
   if(jwin::Pushed(Input->Keyboard.Key_ENTER) || Input->ExecutableReloaded)
   {
     Platform.DEBUGPrint("We should reload debug code\n");
@@ -1592,13 +1689,42 @@ extern "C" JWIN_UPDATE_AND_RENDER(ApplicationUpdateAndRender)
   }
 
 
-  ecs::position::UpdatePositions(GlobalState->World.EntityManager);
+  // Only active worlds are updated, the component macros work on the world being updated
+  world* DrawnWorld = GlobalState->World;
+  for(u32 WorldIndex = 0; WorldIndex < GlobalState->WorldCount; ++WorldIndex)
+  {
+    world* World = GlobalState->Worlds + WorldIndex;
+    if(!World->Active)
+    {
+      continue;
+    }
+    GlobalState->World = World;
+    // Keep chunks packed after entity churn, a little every frame
+    ecs::CompactChunks(World->EntityManager, Kilobytes(64));
+    ecs::RunSystems(World->Scheduler, World->EntityManager, GlobalState->WorkerPool);
+  }
+  GlobalState->World = DrawnWorld;
+
+  // Periodic report of the entity manager memory and the system timings, see ecs::GetMemoryStats and ecs::GetSchedulerStats
+  local_persist r64 NextMemoryReportTime = 0;
+  if(Input->Time >= NextMemoryReportTime)
+  {
+    ecs::PrintMemoryReport(GlobalState->World->EntityManager);
+    ecs::PrintSchedulerReport(GlobalState->World->Scheduler);
+    NextMemoryReportTime = Input->Time + 10;
+  }
 
   
   UpdateViewMatrix(Camera);
   utf8_byte K[] = "Hello my name is jonas.";
-  DrawOverlayText(GlobalState->World.RenderSystem, K, 30, 30, 0.5);
+  DrawOverlayText(GlobalState->RenderSystem, K, 30, 30, 0.5);
 
-  ecs::render::Draw(GlobalState->World.EntityManager, GlobalState->World.RenderSystem, Camera->P, Camera->V);
-  
+  ecs::render::Draw(GlobalState->World->EntityManager, GlobalState->RenderSystem, GlobalState->WorkerPool, Camera->P, Camera->V);
+
+#if JWIN_INTERNAL
+  // The platform may swap the dll before the next frame and the workers run its code, so they don't outlive
+  // the frame in builds that hot reload. The next frame starts a new pool.
+  ecs::DestroyWorkerPool(GlobalState->WorkerPool);
+  GlobalState->WorkerPool = 0;
+#endif
 }
\ No newline at end of file
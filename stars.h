@@ -6,12 +6,20 @@
 #include "debug_draw.h"
 #include "containers/chunk_list.h"
 #include "ecs/entity_components.h"
+#include "ecs/entity_components_scheduler.h"
 #include "ecs/systems/system_render.h"
+#include "ecs/systems/system_position.h"
 
+#define MAX_WORLD_COUNT 16
+
+// A region of the game with entities of its own, such as a star system. Worlds are updated independently,
+// inactive ones are kept as they are until they are activated again. See CreateWorld, MoveEntitiesToWorld.
 struct world {
+  b32 InUse;
+  b32 Active;
   ecs::entity_manager* EntityManager;
-  ecs::render::system* RenderSystem;
-  chunk_list PositionNodes;
+  ecs::position::system* PositionSystem;
+  ecs::scheduler* Scheduler; // Runs the systems of the world every frame
 };
 
 struct application_state
@@ -69,7 +77,12 @@ struct application_state
 
   debug_application_render_commands* DebugRenderCommands;
 
-  world World;
+  ecs::render::system* RenderSystem;
+  ecs::worker_pool* WorkerPool; // Lives for one frame in builds that hot reload the dll, see ApplicationUpdateAndRender
+  chunk_list PositionNodes; // Shared by all worlds so entities keep their nodes when they move between worlds
+  u32 WorldCount;
+  world Worlds[MAX_WORLD_COUNT];
+  world* World; // The world that is drawn and that GetPositionComponent and friends work on
 };
 
 debug_application_render_commands* GlobalDebugRenderCommands = 0;